@@ -65,7 +65,8 @@ ActionTableEntry actions[] = {
     {ACTION_NEXT_TABLE_COLUMN,     TRACKER_EDIT_TABLE,      SDL_SCANCODE_RIGHT,        KMOD_NONE},
     {ACTION_PREV_TABLE_COLUMN,     TRACKER_EDIT_TABLE,      SDL_SCANCODE_LEFT,         KMOD_NONE},
 
-    {ACTION_SHOW_KEYS,             TRACKER_EDIT_ANY,        SDL_SCANCODE_SLASH,        KMOD_SHIFT}
+    {ACTION_SHOW_KEYS,             TRACKER_EDIT_ANY,        SDL_SCANCODE_SLASH,        KMOD_SHIFT},
+    {ACTION_SHOW_TIMING,           TRACKER_EDIT_ANY,        SDL_SCANCODE_T,            KMOD_SHIFT}
 };
 size_t actionsCount = sizeof(actions) / sizeof(ActionTableEntry);
 
@@ -105,5 +106,6 @@ char *actionNames[] = {
     "Prev Table",
     "Next Table Column",
     "Prev Table Column",
-    "Show Keys"
+    "Show Keys",
+    "Show Timing"
 };
@@ -54,6 +54,7 @@ typedef enum {
   ACTION_NEXT_TABLE_COLUMN,
   ACTION_PREV_TABLE_COLUMN,
   ACTION_SHOW_KEYS,
+  ACTION_SHOW_TIMING,
 } Action;
 
 extern char *actionNames[];
@@ -144,6 +144,9 @@ blip_t *blip_new(int size) {
     m->size = size;
     blip_clear(m);
     check_assumptions();
+    if (blip_get_impl() == blip_impl_auto) {
+      blip_set_impl(blip_impl_auto);
+    }
   }
   return m;
 }
@@ -295,27 +298,24 @@ static short const bl_step[phase_count + 1][half_width] = {
     {0,  43,   -115, 350,  -488, 1136, -914,  5861}
 };
 
-/* Shifting by pre_shift allows calculation using unsigned int rather than
-possibly-wider fixed_t. On 32-bit platforms, this is likely more efficient.
-And by having pre_shift 32, a 32-bit platform can easily do the shift by
-simply ignoring the low half. */
+/* Kernels that add one delta step at a given phase. The SIMD versions pair the
+two coefficient rows with delta and delta2 and give exactly the same sums as
+the scalar one. The x86 versions multiply 16 bit values, so they hand delta
+pairs that don't fit in shorts to the scalar kernel. Reading stays scalar:
+each sample's high-pass depends on the clamped sample before it, so one side
+has nothing to run in parallel, and the stereo buffer already overlaps both. */
 
-void blip_add_delta(blip_t *m, unsigned time, int delta) {
-  unsigned fixed = (unsigned) ((time * m->factor + m->offset) >> pre_shift);
-  buf_t *out = SAMPLES(m) + m->avail + (fixed >> frac_bits);
+typedef void (*add_kernel_t)(buf_t *out, int phase, int delta, int delta2);
+typedef void (*add_kernel_stereo_t)(buf_t *out, int phase, int left, int left2, int right, int right2);
 
-  int const phase_shift = frac_bits - phase_bits;
-  int phase = fixed >> phase_shift & (phase_count - 1);
+static add_kernel_t add_kernel;
+static add_kernel_stereo_t add_kernel_stereo;
+static blip_impl_t current_impl;
+
+static void add_kernel_scalar(buf_t *out, int phase, int delta, int delta2) {
   short const *in = bl_step[phase];
   short const *rev = bl_step[phase_count - phase];
 
-  int interp = fixed >> (phase_shift - delta_bits) & (delta_unit - 1);
-  int delta2 = (delta * interp) >> delta_bits;
-  delta -= delta2;
-
-  /* Fails if buffer size was exceeded */
-  assert(out <= &SAMPLES(m)[m->size + end_frame_extra]);
-
   out[0] += in[0] * delta + in[half_width + 0] * delta2;
   out[1] += in[1] * delta + in[half_width + 1] * delta2;
   out[2] += in[2] * delta + in[half_width + 2] * delta2;
@@ -336,6 +336,295 @@ void blip_add_delta(blip_t *m, unsigned time, int delta) {
   out[15] += in[0] * delta + in[0 - half_width] * delta2;
 }
 
+static void add_kernel_stereo_scalar(buf_t *out, int phase, int left, int left2, int right, int right2) {
+  short const *in = bl_step[phase];
+  short const *rev = bl_step[phase_count - phase];
+  int i;
+
+  for (i = 0; i < half_width; i++) {
+    out[i * 2] += in[i] * left + in[half_width + i] * left2;
+    out[i * 2 + 1] += in[i] * right + in[half_width + i] * right2;
+  }
+  out += half_width * 2;
+  for (i = 0; i < half_width; i++) {
+    out[i * 2] += rev[half_width - 1 - i] * left + rev[-1 - i] * left2;
+    out[i * 2 + 1] += rev[half_width - 1 - i] * right + rev[-1 - i] * right2;
+  }
+}
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define BLIP_HAS_SSE2 1
+
+/* Reverses the 8 coefficients loaded from p */
+static __m128i load_reversed_sse2(short const *p) {
+  __m128i x = _mm_loadu_si128((__m128i const *) p);
+  x = _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+  x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+  return _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+}
+
+static int fits_short(int n) {
+  return (short) n == n;
+}
+
+/* Two shorts packed into one lane, first in the low half */
+static int pack_pair(int first, int second) {
+  return (int) (((unsigned) first & 0xFFFF) | ((unsigned) second << 16));
+}
+
+static void add_kernel_sse2(buf_t *out, int phase, int delta, int delta2) {
+  short const *in = bl_step[phase];
+  short const *rev = bl_step[phase_count - phase];
+  __m128i d, a, b, c, e;
+  __m128i *o = (__m128i *) out;
+
+  if (!fits_short(delta) || !fits_short(delta2)) {
+    add_kernel_scalar(out, phase, delta, delta2);
+    return;
+  }
+  d = _mm_set1_epi32(pack_pair(delta, delta2));
+  a = _mm_loadu_si128((__m128i const *) in);
+  b = _mm_loadu_si128((__m128i const *) (in + half_width));
+  c = load_reversed_sse2(rev);
+  e = load_reversed_sse2(rev - half_width);
+
+  _mm_storeu_si128(o + 0, _mm_add_epi32(_mm_loadu_si128(o + 0), _mm_madd_epi16(_mm_unpacklo_epi16(a, b), d)));
+  _mm_storeu_si128(o + 1, _mm_add_epi32(_mm_loadu_si128(o + 1), _mm_madd_epi16(_mm_unpackhi_epi16(a, b), d)));
+  _mm_storeu_si128(o + 2, _mm_add_epi32(_mm_loadu_si128(o + 2), _mm_madd_epi16(_mm_unpacklo_epi16(c, e), d)));
+  _mm_storeu_si128(o + 3, _mm_add_epi32(_mm_loadu_si128(o + 3), _mm_madd_epi16(_mm_unpackhi_epi16(c, e), d)));
+}
+
+static void add_kernel_stereo_sse2(buf_t *out, int phase, int left, int left2, int right, int right2) {
+  short const *in = bl_step[phase];
+  short const *rev = bl_step[phase_count - phase];
+  __m128i d, pairs[4];
+  __m128i *o = (__m128i *) out;
+  int i;
+
+  if (!fits_short(left) || !fits_short(left2) || !fits_short(right) || !fits_short(right2)) {
+    add_kernel_stereo_scalar(out, phase, left, left2, right, right2);
+    return;
+  }
+  d = _mm_set_epi32(pack_pair(right, right2), pack_pair(left, left2), pack_pair(right, right2),
+                    pack_pair(left, left2));
+  {
+    __m128i a = _mm_loadu_si128((__m128i const *) in);
+    __m128i b = _mm_loadu_si128((__m128i const *) (in + half_width));
+    __m128i c = load_reversed_sse2(rev);
+    __m128i e = load_reversed_sse2(rev - half_width);
+    pairs[0] = _mm_unpacklo_epi16(a, b);
+    pairs[1] = _mm_unpackhi_epi16(a, b);
+    pairs[2] = _mm_unpacklo_epi16(c, e);
+    pairs[3] = _mm_unpackhi_epi16(c, e);
+  }
+  /* Each tap's coefficient pair is used twice in a row, once per side */
+  for (i = 0; i < 4; i++) {
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi32(pairs[i], pairs[i]), d);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi32(pairs[i], pairs[i]), d);
+    _mm_storeu_si128(o + i * 2, _mm_add_epi32(_mm_loadu_si128(o + i * 2), lo));
+    _mm_storeu_si128(o + i * 2 + 1, _mm_add_epi32(_mm_loadu_si128(o + i * 2 + 1), hi));
+  }
+}
+#endif /* __SSE2__ */
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define BLIP_HAS_AVX2 1
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static __m256i load_pairs_avx2(short const *first, short const *second) {
+  __m128i a = _mm_loadu_si128((__m128i const *) first);
+  __m128i b = _mm_loadu_si128((__m128i const *) second);
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(a, b)), _mm_unpackhi_epi16(a, b), 1);
+}
+
+AVX2 static __m256i load_reversed_pairs_avx2(short const *first, short const *second) {
+  __m128i a = load_reversed_sse2(first);
+  __m128i b = load_reversed_sse2(second);
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(a, b)), _mm_unpackhi_epi16(a, b), 1);
+}
+
+AVX2 static void add_kernel_avx2(buf_t *out, int phase, int delta, int delta2) {
+  short const *in = bl_step[phase];
+  short const *rev = bl_step[phase_count - phase];
+  __m256i d;
+  __m256i *o = (__m256i *) out;
+
+  if (!fits_short(delta) || !fits_short(delta2)) {
+    add_kernel_scalar(out, phase, delta, delta2);
+    return;
+  }
+  d = _mm256_set1_epi32(pack_pair(delta, delta2));
+  _mm256_storeu_si256(o, _mm256_add_epi32(_mm256_loadu_si256(o),
+                                          _mm256_madd_epi16(load_pairs_avx2(in, in + half_width), d)));
+  _mm256_storeu_si256(o + 1, _mm256_add_epi32(_mm256_loadu_si256(o + 1),
+                                              _mm256_madd_epi16(load_reversed_pairs_avx2(rev, rev - half_width), d)));
+}
+
+AVX2 static void add_kernel_stereo_avx2(buf_t *out, int phase, int left, int left2, int right, int right2) {
+  short const *in = bl_step[phase];
+  short const *rev = bl_step[phase_count - phase];
+  __m256i d, pairs[2];
+  __m256i *o = (__m256i *) out;
+  int i;
+
+  if (!fits_short(left) || !fits_short(left2) || !fits_short(right) || !fits_short(right2)) {
+    add_kernel_stereo_scalar(out, phase, left, left2, right, right2);
+    return;
+  }
+  d = _mm256_set_epi32(pack_pair(right, right2), pack_pair(left, left2), pack_pair(right, right2),
+                       pack_pair(left, left2), pack_pair(right, right2), pack_pair(left, left2),
+                       pack_pair(right, right2), pack_pair(left, left2));
+  pairs[0] = load_pairs_avx2(in, in + half_width);
+  pairs[1] = load_reversed_pairs_avx2(rev, rev - half_width);
+  /* Taps 0-7 of a half, duplicated per side: unpacking within lanes gives taps
+  0,1 | 4,5 and 2,3 | 6,7, so the halves are swapped back into order below */
+  for (i = 0; i < 2; i++) {
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi32(pairs[i], pairs[i]), d);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi32(pairs[i], pairs[i]), d);
+    __m256i first = _mm256_permute2x128_si256(lo, hi, 0x20);
+    __m256i second = _mm256_permute2x128_si256(lo, hi, 0x31);
+    _mm256_storeu_si256(o + i * 2, _mm256_add_epi32(_mm256_loadu_si256(o + i * 2), first));
+    _mm256_storeu_si256(o + i * 2 + 1, _mm256_add_epi32(_mm256_loadu_si256(o + i * 2 + 1), second));
+  }
+}
+#endif /* __GNUC__ && __x86_64__ */
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BLIP_HAS_NEON 1
+
+static int16x8_t load_reversed_neon(short const *p) {
+  int16x8_t x = vrev64q_s16(vld1q_s16(p));
+  return vcombine_s16(vget_high_s16(x), vget_low_s16(x));
+}
+
+/* out += first * delta + second * delta2, 4 taps. Full 32 bit products, so any delta works */
+static int32x4_t mla_pair_neon(int32x4_t out, int16x4_t first, int16x4_t second, int delta, int delta2) {
+  out = vmlaq_n_s32(out, vmovl_s16(first), delta);
+  return vmlaq_n_s32(out, vmovl_s16(second), delta2);
+}
+
+static void add_kernel_neon(buf_t *out, int phase, int delta, int delta2) {
+  short const *in = bl_step[phase];
+  short const *rev = bl_step[phase_count - phase];
+  int16x8_t a = vld1q_s16(in);
+  int16x8_t b = vld1q_s16(in + half_width);
+  int16x8_t c = load_reversed_neon(rev);
+  int16x8_t e = load_reversed_neon(rev - half_width);
+
+  vst1q_s32(out, mla_pair_neon(vld1q_s32(out), vget_low_s16(a), vget_low_s16(b), delta, delta2));
+  vst1q_s32(out + 4, mla_pair_neon(vld1q_s32(out + 4), vget_high_s16(a), vget_high_s16(b), delta, delta2));
+  vst1q_s32(out + 8, mla_pair_neon(vld1q_s32(out + 8), vget_low_s16(c), vget_low_s16(e), delta, delta2));
+  vst1q_s32(out + 12, mla_pair_neon(vld1q_s32(out + 12), vget_high_s16(c), vget_high_s16(e), delta, delta2));
+}
+
+static void add_kernel_stereo_neon(buf_t *out, int phase, int left, int left2, int right, int right2) {
+  short const *in = bl_step[phase];
+  short const *rev = bl_step[phase_count - phase];
+  int16x4_t first[4], second[4];
+  int i;
+  {
+    int16x8_t a = vld1q_s16(in);
+    int16x8_t b = vld1q_s16(in + half_width);
+    int16x8_t c = load_reversed_neon(rev);
+    int16x8_t e = load_reversed_neon(rev - half_width);
+    first[0] = vget_low_s16(a);
+    first[1] = vget_high_s16(a);
+    first[2] = vget_low_s16(c);
+    first[3] = vget_high_s16(c);
+    second[0] = vget_low_s16(b);
+    second[1] = vget_high_s16(b);
+    second[2] = vget_low_s16(e);
+    second[3] = vget_high_s16(e);
+  }
+  /* vld2/vst2 split the interleaved samples into a left and a right vector */
+  for (i = 0; i < 4; i++) {
+    int32x4x2_t o = vld2q_s32(out + i * 8);
+    o.val[0] = mla_pair_neon(o.val[0], first[i], second[i], left, left2);
+    o.val[1] = mla_pair_neon(o.val[1], first[i], second[i], right, right2);
+    vst2q_s32(out + i * 8, o);
+  }
+}
+#endif /* __ARM_NEON */
+
+int blip_set_impl(blip_impl_t impl) {
+  if (impl == blip_impl_auto) {
+#if BLIP_HAS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return blip_set_impl(blip_impl_avx2);
+    }
+#endif
+#if BLIP_HAS_SSE2
+    return blip_set_impl(blip_impl_sse2);
+#elif BLIP_HAS_NEON
+    return blip_set_impl(blip_impl_neon);
+#else
+    return blip_set_impl(blip_impl_scalar);
+#endif
+  }
+  switch (impl) {
+    case blip_impl_scalar:
+      add_kernel = add_kernel_scalar;
+      add_kernel_stereo = add_kernel_stereo_scalar;
+      break;
+#if BLIP_HAS_SSE2
+    case blip_impl_sse2:
+      add_kernel = add_kernel_sse2;
+      add_kernel_stereo = add_kernel_stereo_sse2;
+      break;
+#endif
+#if BLIP_HAS_AVX2
+    case blip_impl_avx2:
+      __builtin_cpu_init();
+      if (!__builtin_cpu_supports("avx2")) {
+        return 0;
+      }
+      add_kernel = add_kernel_avx2;
+      add_kernel_stereo = add_kernel_stereo_avx2;
+      break;
+#endif
+#if BLIP_HAS_NEON
+    case blip_impl_neon:
+      add_kernel = add_kernel_neon;
+      add_kernel_stereo = add_kernel_stereo_neon;
+      break;
+#endif
+    default:
+      return 0;
+  }
+  current_impl = impl;
+  return 1;
+}
+
+blip_impl_t blip_get_impl(void) {
+  return current_impl;
+}
+
+/* Shifting by pre_shift allows calculation using unsigned int rather than
+possibly-wider fixed_t. On 32-bit platforms, this is likely more efficient.
+And by having pre_shift 32, a 32-bit platform can easily do the shift by
+simply ignoring the low half. */
+
+void blip_add_delta(blip_t *m, unsigned time, int delta) {
+  unsigned fixed = (unsigned) ((time * m->factor + m->offset) >> pre_shift);
+  buf_t *out = SAMPLES(m) + m->avail + (fixed >> frac_bits);
+
+  int const phase_shift = frac_bits - phase_bits;
+  int phase = fixed >> phase_shift & (phase_count - 1);
+
+  int interp = fixed >> (phase_shift - delta_bits) & (delta_unit - 1);
+  int delta2 = (delta * interp) >> delta_bits;
+  delta -= delta2;
+
+  /* Fails if buffer size was exceeded */
+  assert(out <= &SAMPLES(m)[m->size + end_frame_extra]);
+
+  add_kernel(out, phase, delta, delta2);
+}
+
 void blip_add_delta_fast(blip_t *m, unsigned time, int delta) {
   unsigned fixed = (unsigned) ((time * m->factor + m->offset) >> pre_shift);
   buf_t *out = SAMPLES(m) + m->avail + (fixed >> frac_bits);
@@ -350,3 +639,134 @@ void blip_add_delta_fast(blip_t *m, unsigned time, int delta) {
   out[8] += delta2;
 }
 
+
+/* Stereo buffer. Same layout as blip_t, but with one integrator per side and
+the samples for both sides interleaved, left first. */
+struct blip_stereo_t {
+  fixed_t factor;
+  fixed_t offset;
+  int avail;
+  int size;
+  int integrator[2];
+};
+
+blip_stereo_t *blip_stereo_new(int size) {
+  blip_stereo_t *m;
+  assert(size >= 0);
+
+  m = (blip_stereo_t *) malloc(sizeof *m + (size + buf_extra) * 2 * sizeof(buf_t));
+  if (m) {
+    m->factor = time_unit / blip_max_ratio;
+    m->size = size;
+    blip_stereo_clear(m);
+    check_assumptions();
+    if (blip_get_impl() == blip_impl_auto) {
+      blip_set_impl(blip_impl_auto);
+    }
+  }
+  return m;
+}
+
+void blip_stereo_delete(blip_stereo_t *m) {
+  if (m != NULL) {
+    memset(m, 0, sizeof *m);
+    free(m);
+  }
+}
+
+void blip_stereo_set_rates(blip_stereo_t *m, double clock_rate, double sample_rate) {
+  double factor = time_unit * sample_rate / clock_rate;
+  m->factor = (fixed_t) factor;
+
+  assert(0 <= factor - m->factor && factor - m->factor < 1);
+
+  if (m->factor < factor) {
+    m->factor++;
+  }
+}
+
+void blip_stereo_clear(blip_stereo_t *m) {
+  m->offset = m->factor / 2;
+  m->avail = 0;
+  m->integrator[0] = 0;
+  m->integrator[1] = 0;
+  memset(SAMPLES(m), 0, (m->size + buf_extra) * 2 * sizeof(buf_t));
+}
+
+void blip_stereo_end_frame(blip_stereo_t *m, unsigned t) {
+  fixed_t off = t * m->factor + m->offset;
+  m->avail += off >> time_bits;
+  m->offset = off & (time_unit - 1);
+
+  assert(m->avail <= m->size);
+}
+
+int blip_stereo_samples_avail(const blip_stereo_t *m) {
+  return m->avail;
+}
+
+/* GCC's SLP vectorizer packs the two sides into one vector register, then
+moves them to integer registers for clamping on every sample, which makes the
+loop slower than two mono passes. Kept scalar, the sides run in parallel. */
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-slp-vectorize")))
+#endif
+int blip_stereo_read_samples(blip_stereo_t *m, short out[], int count) {
+  assert(count >= 0);
+  if (count > m->avail) {
+    count = m->avail;
+  }
+  if (count) {
+    buf_t *buf = SAMPLES(m);
+    buf_t const *in = buf;
+    buf_t const *end = in + count * 2;
+    int left = m->integrator[0];
+    int right = m->integrator[1];
+    int remain;
+    do {
+      int l = ARITH_SHIFT(left, delta_bits);
+      int r = ARITH_SHIFT(right, delta_bits);
+
+      left += in[0];
+      right += in[1];
+      in += 2;
+
+      CLAMP(l);
+      CLAMP(r);
+
+      out[0] = l;
+      out[1] = r;
+      out += 2;
+
+      left -= l << (delta_bits - bass_shift);
+      right -= r << (delta_bits - bass_shift);
+    } while (in != end);
+    m->integrator[0] = left;
+    m->integrator[1] = right;
+
+    remain = (m->avail + buf_extra - count) * 2;
+    m->avail -= count;
+    memmove(&buf[0], &buf[count * 2], remain * sizeof buf[0]);
+    memset(&buf[remain], 0, count * 2 * sizeof buf[0]);
+  }
+  return count;
+}
+
+void blip_stereo_add_delta(blip_stereo_t *m, unsigned time, int left, int right) {
+  unsigned fixed = (unsigned) ((time * m->factor + m->offset) >> pre_shift);
+  buf_t *out = SAMPLES(m) + (m->avail + (fixed >> frac_bits)) * 2;
+
+  int const phase_shift = frac_bits - phase_bits;
+  int phase = fixed >> phase_shift & (phase_count - 1);
+
+  int interp = fixed >> (phase_shift - delta_bits) & (delta_unit - 1);
+  int left2 = (left * interp) >> delta_bits;
+  int right2 = (right * interp) >> delta_bits;
+  left -= left2;
+  right -= right2;
+
+  /* Fails if buffer size was exceeded */
+  assert(out <= &SAMPLES(m)[(m->size + end_frame_extra) * 2]);
+
+  add_kernel_stereo(out, phase, left, left2, right, right2);
+}
@@ -66,6 +66,57 @@ int blip_read_samples(blip_t *, short out[], int count, int stereo);
 void blip_delete(blip_t *);
 
 
+/** Stereo buffer: holds left and right interleaved, so a pair of deltas is
+added in one call and both sides are read back in one pass. Otherwise behaves
+like two blip_t with the same rates, and gives exactly the same samples. */
+typedef struct blip_stereo_t blip_stereo_t;
+
+/** Creates new stereo buffer that can hold at most sample_count samples per
+side. Returns pointer to new buffer, or NULL if insufficient memory. */
+blip_stereo_t *blip_stereo_new(int sample_count);
+
+/** Same as blip_set_rates(). */
+void blip_stereo_set_rates(blip_stereo_t *, double clock_rate, double sample_rate);
+
+/** Same as blip_clear(). */
+void blip_stereo_clear(blip_stereo_t *);
+
+/** Adds a left and a right delta into buffer at specified clock time. */
+void blip_stereo_add_delta(blip_stereo_t *, unsigned int clock_time, int left, int right);
+
+/** Same as blip_end_frame(). */
+void blip_stereo_end_frame(blip_stereo_t *, unsigned int clock_duration);
+
+/** Number of buffered samples available for reading, per side. */
+int blip_stereo_samples_avail(const blip_stereo_t *);
+
+/** Reads and removes at most 'count' samples per side and writes them to 'out'
+as interleaved left/right pairs. Returns number of samples read per side. */
+int blip_stereo_read_samples(blip_stereo_t *, short out[], int count);
+
+/** Frees stereo buffer. No effect if NULL is passed. */
+void blip_stereo_delete(blip_stereo_t *);
+
+
+/** Implementations of the delta synthesis in blip_add_delta() and
+blip_stereo_add_delta(). All of them give exactly the same samples. */
+typedef enum {
+  blip_impl_auto, /**< Fastest one the build and CPU support */
+  blip_impl_scalar,
+  blip_impl_sse2,
+  blip_impl_avx2,
+  blip_impl_neon
+} blip_impl_t;
+
+/** Selects the implementation used by every buffer. The first buffer created
+selects blip_impl_auto if nothing was selected yet. Returns 0 and keeps the
+current one if the build or CPU doesn't support it. */
+int blip_set_impl(blip_impl_t);
+
+/** Implementation in use, or blip_impl_auto if none was selected yet. */
+blip_impl_t blip_get_impl(void);
+
+
 /* Deprecated */
 typedef blip_t blip_buffer_t;
 
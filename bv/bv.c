@@ -1,11 +1,17 @@
 #include "../chip.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "../console.h"
 
+#include "../tables.h"
+
 #define CHIPS_IMPL
+#define M6581_CUTOFF_TABLE tables_m6581CutoffFreq
+#define M6581_DECIMATE_TABLE tables_m6581DecimateTaps
 
 #include "../m6581.h"
+#include "../sidfast.h"
 
 typedef enum Cmd6Bit_t : unsigned {
   Cmd6Bit_Control = 0,
@@ -213,14 +219,50 @@ typedef struct Song_t {
   } __attribute__((packed));
 } __attribute__((packed)) Song;
 
-static Song sSong;
-static Instrument sInstruments[8];
-static u8 sSidRegisters[0x20] = {0};
+#define NUM_META_DATA (6)
+
+struct ChipContext {
+  Song song;
+  Instrument instruments[8];
+  u8 sidRegisters[0x20];
+
+  // Player
+  bool playing;
+  u8 songTick[3];
+  u8 songPos[3];
+  u8 patternPos[3];
+  u8 pattern[3];
+  u8 instrumentPos[3];
+  u8 note[3];
+  u8 arpNote[3];
+  u16 freqDelta[3];
+  u16 pwDelta[3];
+  u8 vibratoDepth[3];
+  bool vibratoMode[3];
+  bool externalVoiceFlag[3];
+  u8 songSpeeds[4];
+  u8 waitCounter[3];
+  u8 frameCounter;
+  u8 *instrumentSet;
+  ChipLoopDetector loopDetector;
+  // Song settings as shown to the editor, which also keeps its text edits here
+  ChipMetaDataEntry metaData[NUM_META_DATA];
+
+  // SID
+  u32 sampleRate;
+  m6581_t sid;
+  u32 clocks;
+  // Sample-rate approximation used instead of sid while previewing
+  sidfast_t fastSid;
+  bool fastPreview;
+
+  ChipExpandState expand;
+};
 
 //////////////////////////////////////////////////
 // Playroutine
 
-void sidReset();
+void sidReset(ChipContext *_ctx);
 
 #define Cmd1BitMask 0xFE
 #define Cmd3BitMask 0xF8
@@ -269,114 +311,108 @@ static const s8 sVibratoLookup[16] = {
     0, 12, 22, 29, 31, 29, 22, 12, 0, -12, -22, -29, -31, -29, -22, -12
 };
 
-static bool sIsPlaying = false;
-static u8 sSongTick[3] = {0};
-static u8 sSongPos[3] = {0};
-static u8 sPatternPos[3] = {0};
-static u8 sPattern[3] = {0};
-static u8 sInstrumentPos[3] = {0};
-static u8 sNote[3] = {0};
-static u8 sArpNote[3] = {0};
-static u16 sFreqDelta[3] = {0};
-static u16 sPwDelta[3] = {0};
-static u8 sVibratoDepth[3] = {0};
-static bool sVibratoMode[3] = {true};
-static bool sExternalVoiceFlag[3] = {false};
-
-static u8 sSongSpeeds[4];
-static u8 sWaitCounter[3] = {0};
-static u8 sFrameCounter = 0;
-static u8 *sInstrumentSet = (u8 *) &(sInstruments[0]);
-
-void playerInit() {
-  u8 songSpeed = (sSong.tempo + 1) << 1;
+void playerInit(ChipContext *_ctx) {
+  u8 songSpeed = (_ctx->song.tempo + 1) << 1;
   for (s8 i = 3; i >= 0; --i) {
-    sSongSpeeds[i] = songSpeed << i;
+    _ctx->songSpeeds[i] = songSpeed << i;
   }
   for (s8 ch = 2; ch >= 0; --ch) {
-    sSongTick[ch] = 0;
-    sSongPos[ch] = 0;
-    sPattern[ch] = sSong.tracks[ch][0].pattern;
-    sPatternPos[ch] = 0;
-    sInstrumentPos[ch] = 0;
+    _ctx->songTick[ch] = 0;
+    _ctx->songPos[ch] = 0;
+    _ctx->pattern[ch] = _ctx->song.tracks[ch][0].pattern;
+    _ctx->patternPos[ch] = 0;
+    _ctx->instrumentPos[ch] = 0;
   }
 }
 
-void playerPlayNote(u8 _channel, u8 _note, u8 _instrument, bool _isDown) {
+void playerPlayNote(ChipContext *_ctx, u8 _channel, u8 _note, u8 _instrument, bool _isDown) {
   if (_isDown) {
-    sNote[_channel] = _note;
-    sInstrumentPos[_channel] = (_instrument << 5) + 2;
-    sWaitCounter[_channel] = 0;
-    sArpNote[_channel] = 0;
-    sVibratoDepth[_channel] = 0;
-    sSidRegisters[0x05 + _channel * 7] = sInstrumentSet[sInstrumentPos[_channel] - 2]; // AD
-    sSidRegisters[0x06 + _channel * 7] = sInstrumentSet[sInstrumentPos[_channel] - 1]; // SR
+    _ctx->note[_channel] = _note;
+    _ctx->instrumentPos[_channel] = (_instrument << 5) + 2;
+    _ctx->waitCounter[_channel] = 0;
+    _ctx->arpNote[_channel] = 0;
+    _ctx->vibratoDepth[_channel] = 0;
+    _ctx->sidRegisters[0x05 + _channel * 7] = _ctx->instrumentSet[_ctx->instrumentPos[_channel] - 2]; // AD
+    _ctx->sidRegisters[0x06 + _channel * 7] = _ctx->instrumentSet[_ctx->instrumentPos[_channel] - 1]; // SR
   } else {
-    sInstrumentPos[_channel] = (_instrument << 5) + 2;
-    u8 end = sInstrumentPos[_channel] + 30;
-    for (u8 i = sInstrumentPos[_channel]; i < end; ++i) {
-      if (sInstrumentSet[i] == CmdNoteOffJmpPos) {
-        sInstrumentPos[_channel] = i + 1;
+    _ctx->instrumentPos[_channel] = (_instrument << 5) + 2;
+    u8 end = _ctx->instrumentPos[_channel] + 30;
+    for (u8 i = _ctx->instrumentPos[_channel]; i < end; ++i) {
+      if (_ctx->instrumentSet[i] == CmdNoteOffJmpPos) {
+        _ctx->instrumentPos[_channel] = i + 1;
         return;
       }
     }
-    sInstrumentPos[_channel] = 0;
-    sWaitCounter[_channel] = 0;
-    sSidRegisters[0x04 + _channel * 7] &= 0xFE;
+    _ctx->instrumentPos[_channel] = 0;
+    _ctx->waitCounter[_channel] = 0;
+    _ctx->sidRegisters[0x04 + _channel * 7] &= 0xFE;
   }
 }
 
-void playerTick() {
-  if (sIsPlaying) {
+static void playerVisitLoopState(ChipContext *_ctx) {
+  u8 state[9];
+  memcpy(state, _ctx->songPos, 3);
+  memcpy(state + 3, _ctx->patternPos, 3);
+  memcpy(state + 6, _ctx->songTick, 3);
+  chip_loopVisit(&_ctx->loopDetector, state, sizeof(state));
+}
+
+void playerTick(ChipContext *_ctx) {
+  if (_ctx->playing) {
+    bool songPosChanged = false;
     // Trigger intruments from song lines
     for (int ch = 0; ch < 3; ++ch) {
-      if (sSongTick[ch] == 0) {
+      if (_ctx->songTick[ch] == 0) {
         // Get pattern line
         SongLine *line;
-        if (sSong.meter == SongMeter_4_4) {
-          line = &sSong.pattern44[sPattern[ch]][sPatternPos[ch]];
+        if (_ctx->song.meter == SongMeter_4_4) {
+          line = &_ctx->song.pattern44[_ctx->pattern[ch]][_ctx->patternPos[ch]];
         } else {
-          line = &sSong.pattern34[sPattern[ch]][sPatternPos[ch]];
+          line = &_ctx->song.pattern34[_ctx->pattern[ch]][_ctx->patternPos[ch]];
         }
         // Trigger instrument
         if (line->note == NoteOffSentinel) {
-          playerPlayNote(ch, 0, line->instrument, false);
+          playerPlayNote(_ctx, ch, 0, line->instrument, false);
         } else if (line->note != 0) {
-          playerPlayNote(ch, line->note, line->instrument, true);
+          playerPlayNote(_ctx, ch, line->note, line->instrument, true);
         }
-        SongTrack *track = &sSong.tracks[ch][sSongPos[ch]];
-        sSongTick[ch] = sSongSpeeds[track->speed];
+        SongTrack *track = &_ctx->song.tracks[ch][_ctx->songPos[ch]];
+        _ctx->songTick[ch] = _ctx->songSpeeds[track->speed];
       } else {
-        if (sSongTick[ch] == 1) {
+        if (_ctx->songTick[ch] == 1) {
           // Increment pattern position
-          sPatternPos[ch]++;
-          if ((sSong.meter == SongMeter_4_4 && sPatternPos[ch] >= 16) ||
-              (sSong.meter == SongMeter_3_4 && sPatternPos[ch] >= 12)) {
-            sPatternPos[ch] = 0;
+          _ctx->patternPos[ch]++;
+          if ((_ctx->song.meter == SongMeter_4_4 && _ctx->patternPos[ch] >= 16) ||
+              (_ctx->song.meter == SongMeter_3_4 && _ctx->patternPos[ch] >= 12)) {
+            _ctx->patternPos[ch] = 0;
             // Increment song position
-            sSongPos[ch]++;
-            if (sSongPos[ch] == 20) sSongPos[ch] = 0;
-            SongTrack *track = &sSong.tracks[ch][sSongPos[ch]];
-            sPattern[ch] = track->pattern;
+            _ctx->songPos[ch]++;
+            if (_ctx->songPos[ch] == 20) _ctx->songPos[ch] = 0;
+            SongTrack *track = &_ctx->song.tracks[ch][_ctx->songPos[ch]];
+            _ctx->pattern[ch] = track->pattern;
+            songPosChanged = true;
           }
         }
       }
-      sSongTick[ch]--;
+      _ctx->songTick[ch]--;
+    }
+    if (songPosChanged) {
+      playerVisitLoopState(_ctx);
     }
   }
   // Tick instruments
   for (u8 ch = 0; ch < 3; ++ch) {
     // Check end of instrument
-    if (sInstrumentPos[ch] == 0) continue;
+    if (_ctx->instrumentPos[ch] == 0) continue;
 
     // Wait if necessary
-    if (sWaitCounter[ch] != 0) {
-      sWaitCounter[ch]--;
+    if (_ctx->waitCounter[ch] != 0) {
+      _ctx->waitCounter[ch]--;
       continue;
     }
 
     // Process instrument instructions
-    u8 cmd = sInstrumentSet[sInstrumentPos[ch]];
+    u8 cmd = _ctx->instrumentSet[_ctx->instrumentPos[ch]];
     u8 value = cmd;
     if (cmd == CmdNoteOffJmpPos) {
 
@@ -385,66 +421,66 @@ void playerTick() {
       if (cmd == CmdSync) {
         // Sync
         if (value & 1) {
-          sSidRegisters[0x04 + ch * 7] |= 0x02;
+          _ctx->sidRegisters[0x04 + ch * 7] |= 0x02;
         } else {
-          sSidRegisters[0x04 + ch * 7] &= 0xFD;
+          _ctx->sidRegisters[0x04 + ch * 7] &= 0xFD;
         }
       } else if (cmd == CmdRing) {
         // Ring
         if (value & 1) {
-          sSidRegisters[0x04 + ch * 7] |= 0x04;
+          _ctx->sidRegisters[0x04 + ch * 7] |= 0x04;
         } else {
-          sSidRegisters[0x04 + ch * 7] &= 0xFB;
+          _ctx->sidRegisters[0x04 + ch * 7] &= 0xFB;
         }
       } else if (cmd == CmdExternalVoiceFlag) {
         // External voice flag
-        sExternalVoiceFlag[ch] = value & 1;
+        _ctx->externalVoiceFlag[ch] = value & 1;
       } else {
         cmd &= Cmd3BitMask;
         if (cmd == CmdWait) {
           // Wait
-          sWaitCounter[ch] = sWaitLookup[value & 0x07];
+          _ctx->waitCounter[ch] = sWaitLookup[value & 0x07];
         } else if (cmd == CmdVibrato) {
           // Vibrato
-          sVibratoDepth[ch] = value & 0x03;
-          sVibratoMode[ch] = value & 0x04;
+          _ctx->vibratoDepth[ch] = value & 0x03;
+          _ctx->vibratoMode[ch] = value & 0x04;
         } else {
           cmd &= Cmd4BitMask;
           if (cmd == CmdArpeggio) {
             // Arpeggio
-            sArpNote[ch] = value & 0x0F;
+            _ctx->arpNote[ch] = value & 0x0F;
           } else if (cmd == CmdLoop) {
             // Loop
             if (value == Cmd4Bit_Loop << 4) {
-              sInstrumentPos[ch] = 0;
+              _ctx->instrumentPos[ch] = 0;
               return;
             }
-            sInstrumentPos[ch] -= ((value & 0x0F) + 1);
+            _ctx->instrumentPos[ch] -= ((value & 0x0F) + 1);
           } else {
             cmd &= Cmd6BitMask;
             if (cmd == CmdControl) {
               // Control
               value &= 0x3F;
               value = (value << 3) | (value >> 5); // ROL*3
-              sSidRegisters[0x04 + ch * 7] &= ~0xF9;
-              sSidRegisters[0x04 + ch * 7] |= value;
+              _ctx->sidRegisters[0x04 + ch * 7] &= ~0xF9;
+              _ctx->sidRegisters[0x04 + ch * 7] |= value;
             } else if (cmd == CmdInc) {
               // Inc
               if (value & 0x20) {
                 // Frequency
-                sFreqDelta[ch] += (value & 0x10) ? value | 0xE0 : value & 0x1F;
+                _ctx->freqDelta[ch] += (value & 0x10) ? value | 0xE0 : value & 0x1F;
               } else {
                 // Pulse width
-                sPwDelta[ch] += (value & 0x10) ? value | 0xE0 : value & 0x1F;
+                _ctx->pwDelta[ch] += (value & 0x10) ? value | 0xE0 : value & 0x1F;
               }
             } else if (cmd == CmdSet) {
               // Set
               if (value & 0x20) {
                 // Frequency
-                sFreqDelta[ch] = (value & 0x1F) << 11;
+                _ctx->freqDelta[ch] = (value & 0x1F) << 11;
               } else {
                 // Pulse width
-                sPwDelta[ch] = (value & 0x1F) << 7;
+                _ctx->pwDelta[ch] = (value & 0x1F) << 7;
               }
             }
           }
@@ -453,25 +489,25 @@ void playerTick() {
     }
 
     // Set frequency
-    u8 note = sNote[ch] + sArpNote[ch];
+    u8 note = _ctx->note[ch] + _ctx->arpNote[ch];
     if (ch == 0) {
-      note += ((sSong.ch0Octave - 1) << 5);
+      note += ((_ctx->song.ch0Octave - 1) << 5);
     } else if (ch == 1) {
-      note += ((sSong.ch1Octave - 1) << 5);
+      note += ((_ctx->song.ch1Octave - 1) << 5);
     } else {
-      note += ((sSong.ch2Octave - 1) << 5);
+      note += ((_ctx->song.ch2Octave - 1) << 5);
     }
-    u16 *freq = (u16 *) &sSidRegisters[0x00 + ch * 7];
-    *freq = (sFreqTablePalLo[note] | sFreqTablePalHi[note] << 8) + sFreqDelta[ch];
+    u16 *freq = (u16 *) &_ctx->sidRegisters[0x00 + ch * 7];
+    *freq = (sFreqTablePalLo[note] | sFreqTablePalHi[note] << 8) + _ctx->freqDelta[ch];
 
     // Set pulse width
-    u16 *pw = (u16 *) &sSidRegisters[0x02 + ch * 7];
-    *pw = sPwDelta[ch];
+    u16 *pw = (u16 *) &_ctx->sidRegisters[0x02 + ch * 7];
+    *pw = _ctx->pwDelta[ch];
 
     // Apply Vibrato
-    if (sVibratoDepth[ch] != 0) {
-      s16 vibrato = (sVibratoLookup[sFrameCounter & 0x0F] << sVibratoDepth[ch]);
-      if (sVibratoMode[ch]) {
+    if (_ctx->vibratoDepth[ch] != 0) {
+      s16 vibrato = (sVibratoLookup[_ctx->frameCounter & 0x0F] << _ctx->vibratoDepth[ch]);
+      if (_ctx->vibratoMode[ch]) {
         *freq += vibrato;
       } else {
         *pw += vibrato;
@@ -479,38 +515,40 @@ void playerTick() {
     }
 
     // Increment instrument position
-    sInstrumentPos[ch] = ((sInstrumentPos[ch] + 1) & 0x1F) | (sInstrumentPos[ch] & 0xE0);
+    _ctx->instrumentPos[ch] = ((_ctx->instrumentPos[ch] + 1) & 0x1F) | (_ctx->instrumentPos[ch] & 0xE0);
   } // end for
-  sFrameCounter++;
+  _ctx->frameCounter++;
 }
 
-void playerPlay(int songPos, int patternPos) {
+void playerPlay(ChipContext *_ctx, int songPos, int patternPos) {
   con_msgf("playerPlay(%d, %d)", songPos, patternPos);
-  playerInit();
+  playerInit(_ctx);
   for (int i = 0; i < 3; ++i) {
-    sSongPos[i] = songPos;
-    sPatternPos[i] = patternPos;
-    sPattern[i] = sSong.tracks[i][sSongPos[i]].pattern;
+    _ctx->songPos[i] = songPos;
+    _ctx->patternPos[i] = patternPos;
+    _ctx->pattern[i] = _ctx->song.tracks[i][_ctx->songPos[i]].pattern;
   }
-  sIsPlaying = true;
+  chip_loopReset(&_ctx->loopDetector);
+  playerVisitLoopState(_ctx);
+  _ctx->playing = true;
 }
 
-static void playerPlayPattern(u8 songRow, u8 patternRow) {
+static void playerPlayPattern(ChipContext *_ctx, u8 songRow, u8 patternRow) {
   // TODO: Implement
 }
 
-void playerStop() {
-  sIsPlaying = false;
-  sidReset();
+void playerStop(ChipContext *_ctx) {
+  _ctx->playing = false;
+  sidReset(_ctx);
   for (int i = 0; i < 3; ++i) {
-    sInstrumentPos[i] = 0;
-    sWaitCounter[i] = 0;
-    sVibratoDepth[i] = 0;
-    sVibratoMode[i] = 0;
-    sArpNote[i] = 0;
-    sFreqDelta[i] = 0;
-    sPwDelta[i] = 0;
-    sExternalVoiceFlag[i] = 0;
+    _ctx->instrumentPos[i] = 0;
+    _ctx->waitCounter[i] = 0;
+    _ctx->vibratoDepth[i] = 0;
+    _ctx->vibratoMode[i] = 0;
+    _ctx->arpNote[i] = 0;
+    _ctx->freqDelta[i] = 0;
+    _ctx->pwDelta[i] = 0;
+    _ctx->externalVoiceFlag[i] = 0;
   }
 }
 
@@ -519,67 +557,108 @@ void playerStop() {
 
 #define C64_FREQUENCY (985248) // clock frequency in Hz
 #define C64_VBLANK (C64_FREQUENCY / 50) // 50 Hz
-m6581_t sid;
-uint64_t pins = 0;
-u32 clocks = 0;
-
-void sidReset() {
-  m6581_reset(&sid);
-  pins = 0;
+#define SID_RUN_SAMPLES (256)
+// Build with -DBV_MULTIRATE_FILTER=1 to run the SID filter four times per sample instead of every clock;
+// tools/sidcheck compares the two
+#ifndef BV_MULTIRATE_FILTER
+#define BV_MULTIRATE_FILTER (0)
+#endif
+
+void sidReset(ChipContext *_ctx) {
+  m6581_reset(&_ctx->sid);
+  sidfast_reset(&_ctx->fastSid);
   for (int i = 0; i < 32; ++i) {
-    sSidRegisters[i] = 0;
+    _ctx->sidRegisters[i] = 0;
   }
   // Set volume
-  sSidRegisters[0x18] = 0x0F;
+  _ctx->sidRegisters[0x18] = 0x0F;
 /*
   // Test tone
-  sSidRegisters[0x00] = 0x68;
-  sSidRegisters[0x01] = 0x11;
-  sSidRegisters[0x04] = 0x11;
-  sSidRegisters[0x05] = 0x00;
-  sSidRegisters[0x06] = 0xF0;
+  _ctx->sidRegisters[0x00] = 0x68;
+  _ctx->sidRegisters[0x01] = 0x11;
+  _ctx->sidRegisters[0x04] = 0x11;
+  _ctx->sidRegisters[0x05] = 0x00;
+  _ctx->sidRegisters[0x06] = 0xF0;
 */
 }
 
-void sidInit() {
-  m6581_init(&sid, &(m6581_desc_t) {
+void sidInit(ChipContext *_ctx) {
+  m6581_init(&_ctx->sid, &(m6581_desc_t) {
       .tick_hz = C64_FREQUENCY,
-      .sound_hz = 44100,
+      .sound_hz = _ctx->sampleRate,
       .magnitude = 1.0f,
+      .multirate_filter = BV_MULTIRATE_FILTER,
   });
-  sidReset();
+  sidfast_init(&_ctx->fastSid, &(sidfast_desc_t) {
+      .tick_hz = C64_FREQUENCY,
+      .sound_hz = _ctx->sampleRate,
+      .magnitude = 1.0f,
+  });
+  sidReset(_ctx);
+}
+
+static void sidOutput(ChipSample *_out, s16 _sample) {
+  _out->left = _sample;
+  _out->right = _sample;
 }
 
-void sidTick(ChipSample *_buf, int _len) {
+static void sidTickFast(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  float samples[SID_RUN_SAMPLES];
   int pos = 0;
   while (pos < _len) {
-    if (clocks == 0) {
+    if (_ctx->clocks == 0) {
+      playerTick(_ctx);
+      for (int i = 0; i < 0x20; i++) {
+        sidfast_write(&_ctx->fastSid, i, _ctx->sidRegisters[i]);
+      }
+    }
+    // clocks counts samples rather than SID clocks here, one frame being 1/50 s
+    const u32 frameSamples = _ctx->sampleRate / 50;
+    int numSamples = frameSamples - _ctx->clocks;
+    numSamples = _len - pos < numSamples ? _len - pos : numSamples;
+    numSamples = SID_RUN_SAMPLES < numSamples ? SID_RUN_SAMPLES : numSamples;
+    sidfast_run(&_ctx->fastSid, samples, numSamples);
+    for (int i = 0; i < numSamples; i++) {
+      // Resonance can push the filter past full scale; clamp rather than let the cast wrap
+      const float sample = samples[i] > 1.0f ? 1.0f : (samples[i] < -1.0f ? -1.0f : samples[i]);
+      sidOutput(&_buf[pos + i], (s16) (sample * INT16_MAX));
+    }
+    chip_expandSamples(&_ctx->expand, &_buf[pos], numSamples);
+    pos += numSamples;
+    _ctx->clocks += numSamples;
+    if (_ctx->clocks == frameSamples) {
+      _ctx->clocks = 0;
+    }
+  }
+}
+
+void sidTick(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  if (_ctx->fastPreview) {
+    sidTickFast(_ctx, _buf, _len);
+    return;
+  }
+  s16 samples[SID_RUN_SAMPLES];
+  int pos = 0;
+  while (pos < _len) {
+    if (_ctx->clocks == 0) {
       // Call playroutine
-      playerTick();
+      playerTick(_ctx);
+      // Copy shadow registers to SID, one per clock, while the frame runs
+      for (int i = 0; i < 0x20; i++) {
+        m6581_schedule_write(&_ctx->sid, i, i, _ctx->sidRegisters[i]);
+      }
     }
-    if (clocks < 0x20) {
-      // Copy shadow registers to SID
-      pins |= M6581_CS;
-      pins &= ~M6581_RW;
-      pins &= ~M6581_ADDR_MASK;
-      pins |= clocks;
-      M6581_SET_DATA(pins, sSidRegisters[clocks])
-      pins = m6581_tick(&sid, pins);
-      // con_msgf("%02X > %02X", clocks, sSidRegisters[clocks]);
-    } else {
-      // Do nothing to SID
-      pins &= ~M6581_CS;
-      pins |= M6581_RW;
-      M6581_SET_DATA(pins, 0)
-      pins = m6581_tick(&sid, pins);
+    int maxSamples = _len - pos < SID_RUN_SAMPLES ? _len - pos : SID_RUN_SAMPLES;
+    int numSamples;
+    _ctx->clocks += m6581_run(&_ctx->sid, C64_VBLANK - _ctx->clocks, samples, maxSamples, &numSamples);
+    for (int i = 0; i < numSamples; i++) {
+      sidOutput(&_buf[pos + i], samples[i]);
     }
-    if (pins & M6581_SAMPLE) {
-      _buf[pos].left = (s16) (sid.sample * INT16_MAX);
-      _buf[pos].right = (s16) (sid.sample * INT16_MAX);
-      _buf[pos] = chip_expandSample(_buf[pos]);
-      pos++;
+    chip_expandSamples(&_ctx->expand, &_buf[pos], numSamples);
+    pos += numSamples;
+    if (_ctx->clocks == C64_VBLANK) {
+      _ctx->clocks = 0;
     }
-    clocks = (clocks + 1) % C64_VBLANK;
   }
 }
 
@@ -595,36 +674,36 @@ static SongTrack newSongTrack() {
   };
 }
 
-static ChipError newSong() {
-  memset(&sSong, 0, sizeof(Song));
+static ChipError newSong(ChipContext *_ctx) {
+  memset(&_ctx->song, 0, sizeof(Song));
 
-  sSong.instrumentSet = 0;
-  sSong.ch0Octave = SongOctave_Bass;
-  sSong.ch1Octave = SongOctave_Alto;
-  sSong.ch2Octave = SongOctave_Treble;
-  sSong.meter = SongMeter_4_4;
-  sSong.loopSong = SongLoop_Stop;
-  sSong.tempo = 2;
+  _ctx->song.instrumentSet = 0;
+  _ctx->song.ch0Octave = SongOctave_Bass;
+  _ctx->song.ch1Octave = SongOctave_Alto;
+  _ctx->song.ch2Octave = SongOctave_Treble;
+  _ctx->song.meter = SongMeter_4_4;
+  _ctx->song.loopSong = SongLoop_Stop;
+  _ctx->song.tempo = 2;
   for (int i = 0; i < 3; i++) {
     for (int j = 0; j < 20; j++) {
-      sSong.tracks[i][j] = newSongTrack();
+      _ctx->song.tracks[i][j] = newSongTrack();
     }
   }
-  memset(&sSong.pattern44, 0, sizeof(sSong.pattern44));
+  memset(&_ctx->song.pattern44, 0, sizeof(_ctx->song.pattern44));
 
   // Init intstruments
   for (int i = 0; i < 8; i++) {
-    sInstruments[i].attack = 0;
-    sInstruments[i].decay = 0;
-    sInstruments[i].sustain = 0xf;
-    sInstruments[i].release = 0;
-    sInstruments[i].program[0].raw = 0;
-    sInstruments[i].program[0].control.cmd = Cmd6Bit_Control;
-    sInstruments[i].program[0].control.controlTriangle = 1;
-    sInstruments[i].program[0].control.controlGate = 1;
+    _ctx->instruments[i].attack = 0;
+    _ctx->instruments[i].decay = 0;
+    _ctx->instruments[i].sustain = 0xf;
+    _ctx->instruments[i].release = 0;
+    _ctx->instruments[i].program[0].raw = 0;
+    _ctx->instruments[i].program[0].control.cmd = Cmd6Bit_Control;
+    _ctx->instruments[i].program[0].control.controlTriangle = 1;
+    _ctx->instruments[i].program[0].control.controlGate = 1;
     for (int j = 1; j < 30; j++) {
-      sInstruments[i].program[j].loop.cmd = Cmd4Bit_Loop;
-      sInstruments[i].program[j].loop.loopPosition = 0;
+      _ctx->instruments[i].program[j].loop.cmd = Cmd4Bit_Loop;
+      _ctx->instruments[i].program[j].loop.loopPosition = 0;
     }
   }
 
@@ -662,100 +741,8 @@ static u8 labelString(const char *label, u8 col) {
   }
 }
 
-static ChipError init() {
-  sidInit();
-  newSong();
-
-  con_msgf("Size of song: %d", sizeof(sSong));
-  con_msgf("Size of instruments: %d", sizeof(sInstrumentSet));
-  con_msgf("Size of SongTrack: %d", sizeof(SongTrack));
-  con_msgf("Size of Instrument: %d", sizeof(Instrument));
-  con_msgf("Size of InstrumentInstruction: %d", sizeof(InstrumentInstruction));
-
-
-  return NO_ERR;
-}
-
-static ChipError shutdown() {
-  return NO_ERR;
-}
-
-static ChipError loadSong(const char *_filename) {
-  FILE *file = fopen(_filename, "rb");
-  if (file == NULL) {
-    return ERR_FILE_NOT_FOUND;
-  }
-  size_t res;
-  res = fread(&sSong, sizeof(Song), 1, file);
-  if (res != 1) {
-    return ERR_FILE_READ;
-  }
-  res = fread(&sInstruments, sizeof(sInstruments), 1, file);
-  if (res != 1) {
-    return ERR_FILE_READ;
-  }
-  fclose(file);
-  return NO_ERR;
-}
-
-static ChipError saveSong(const char *filename) {
-  FILE *file = fopen(filename, "wb");
-  if (file == NULL) {
-    return ERR_FILE_NOT_FOUND;
-  }
-  size_t res;
-  res = fwrite(&sSong, sizeof(Song), 1, file);
-  if (res != 1) {
-    return ERR_FILE_WRITE;
-  }
-  res = fwrite(&sInstruments, sizeof(sInstruments), 1, file);
-  if (res != 1) {
-    return ERR_FILE_WRITE;
-  }
-  fclose(file);
-  return NO_ERR;
-}
-
-static ChipError insertInstrumentRow(u8 _instrument, u8 _atInstrumentRow) {
-  con_msgf("insertInstrumentRow(%d, %d)", _instrument, _atInstrumentRow);
-  if (_atInstrumentRow < 4) return ERR_NOT_SUPPORTED;
-  if (_atInstrumentRow > 31) return ERR_NOT_SUPPORTED;
-  if (_instrument > 7) return ERR_NOT_SUPPORTED;
-  u8 start = _atInstrumentRow - 4;
-  u8 end = 30 - 4;
-  for (int i = end; i >= start; i--) {
-    sInstruments[_instrument].program[i + 1] = sInstruments[_instrument].program[i];
-  }
-  sInstruments[_instrument].program[start].loop.cmd = Cmd4Bit_Loop;
-  sInstruments[_instrument].program[start].loop.loopPosition = 0;
-  return NO_ERR;
-}
-
-static ChipError addInstrumentRow(u8 _instrument) {
-  return ERR_NOT_SUPPORTED;
-}
-
-static ChipError deleteInstrumentRow(u8 _instrument, u8 _instrumentRow) {
-  if (_instrumentRow < 4) return ERR_NOT_SUPPORTED;
-  if (_instrumentRow > 31) return ERR_NOT_SUPPORTED;
-  if (_instrument > 7) return ERR_NOT_SUPPORTED;
-  u8 start = _instrumentRow - 4;
-  u8 end = 30 - 4;
-  for (int i = start; i < end; i++) {
-    sInstruments[_instrument].program[i] = sInstruments[_instrument].program[i + 1];
-  }
-  sInstruments[_instrument].program[end].loop.cmd = Cmd4Bit_Loop;
-  sInstruments[_instrument].program[end].loop.loopPosition = 0;
-  return NO_ERR;
-}
-
-static ChipError insertTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
-
-static ChipError addTableColumn(u8 _tableKind, u8 _table) { return NO_ERR; }
-
-static ChipError deleteTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
-
-static ChipMetaDataEntry metaData[] =
+// Defaults for each context's metaData; the values shown are filled in from the song by getMetaData
+static const ChipMetaDataEntry sMetaDataDefaults[NUM_META_DATA] =
     {
         {
             .name = "Ch.0 Octave",
@@ -828,88 +815,193 @@ static ChipMetaDataEntry metaData[] =
         }
     };
 
-static u8 getNumMetaData() {
-  return sizeof(metaData) / sizeof(ChipMetaDataEntry);
+static ChipError init(ChipContext **_ctx, u32 _sampleRate) {
+  if (_sampleRate < CHIP_MIN_SAMPLE_RATE || _sampleRate > CHIP_MAX_SAMPLE_RATE) {
+    return ERR_NOT_SUPPORTED;
+  }
+  ChipContext *ctx = calloc(1, sizeof(ChipContext));
+  if (!ctx) {
+    return ERR_OUT_OF_MEMORY;
+  }
+  ctx->sampleRate = _sampleRate;
+  memcpy(ctx->metaData, sMetaDataDefaults, sizeof(ctx->metaData));
+  ctx->vibratoMode[0] = true;
+  ctx->instrumentSet = (u8 *) &(ctx->instruments[0]);
+  sidInit(ctx);
+  newSong(ctx);
+
+  con_msgf("Size of song: %d", sizeof(ctx->song));
+  con_msgf("Size of instruments: %d", sizeof(ctx->instrumentSet));
+  con_msgf("Size of SongTrack: %d", sizeof(SongTrack));
+  con_msgf("Size of Instrument: %d", sizeof(Instrument));
+  con_msgf("Size of InstrumentInstruction: %d", sizeof(InstrumentInstruction));
+
+  *_ctx = ctx;
+  return NO_ERR;
+}
+
+static ChipError shutdown(ChipContext *_ctx) {
+  free(_ctx);
+  return NO_ERR;
+}
+
+static ChipError loadSong(ChipContext *_ctx, const char *_filename) {
+  FILE *file = fopen(_filename, "rb");
+  if (file == NULL) {
+    return ERR_FILE_NOT_FOUND;
+  }
+  size_t res;
+  res = fread(&_ctx->song, sizeof(Song), 1, file);
+  if (res != 1) {
+    return ERR_FILE_READ;
+  }
+  res = fread(&_ctx->instruments, sizeof(_ctx->instruments), 1, file);
+  if (res != 1) {
+    return ERR_FILE_READ;
+  }
+  fclose(file);
+  return NO_ERR;
+}
+
+static ChipError saveSong(ChipContext *_ctx, const char *filename) {
+  FILE *file = fopen(filename, "wb");
+  if (file == NULL) {
+    return ERR_FILE_NOT_FOUND;
+  }
+  size_t res;
+  res = fwrite(&_ctx->song, sizeof(Song), 1, file);
+  if (res != 1) {
+    return ERR_FILE_WRITE;
+  }
+  res = fwrite(&_ctx->instruments, sizeof(_ctx->instruments), 1, file);
+  if (res != 1) {
+    return ERR_FILE_WRITE;
+  }
+  fclose(file);
+  return NO_ERR;
+}
+
+static ChipError insertInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _atInstrumentRow) {
+  con_msgf("insertInstrumentRow(%d, %d)", _instrument, _atInstrumentRow);
+  if (_atInstrumentRow < 4) return ERR_NOT_SUPPORTED;
+  if (_atInstrumentRow > 31) return ERR_NOT_SUPPORTED;
+  if (_instrument > 7) return ERR_NOT_SUPPORTED;
+  u8 start = _atInstrumentRow - 4;
+  u8 end = 30 - 4;
+  for (int i = end; i >= start; i--) {
+    _ctx->instruments[_instrument].program[i + 1] = _ctx->instruments[_instrument].program[i];
+  }
+  _ctx->instruments[_instrument].program[start].loop.cmd = Cmd4Bit_Loop;
+  _ctx->instruments[_instrument].program[start].loop.loopPosition = 0;
+  return NO_ERR;
+}
+
+static ChipError addInstrumentRow(ChipContext *_ctx, u8 _instrument) {
+  return ERR_NOT_SUPPORTED;
+}
+
+static ChipError deleteInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow) {
+  if (_instrumentRow < 4) return ERR_NOT_SUPPORTED;
+  if (_instrumentRow > 31) return ERR_NOT_SUPPORTED;
+  if (_instrument > 7) return ERR_NOT_SUPPORTED;
+  u8 start = _instrumentRow - 4;
+  u8 end = 30 - 4;
+  for (int i = start; i < end; i++) {
+    _ctx->instruments[_instrument].program[i] = _ctx->instruments[_instrument].program[i + 1];
+  }
+  _ctx->instruments[_instrument].program[end].loop.cmd = Cmd4Bit_Loop;
+  _ctx->instruments[_instrument].program[end].loop.loopPosition = 0;
+  return NO_ERR;
 }
 
-static ChipMetaDataEntry *getMetaData(u8 _index) {
-  ChipMetaDataEntry *entry = &metaData[_index];
+static ChipError insertTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
+
+static ChipError addTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table) { return NO_ERR; }
+
+static ChipError deleteTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
+
+static u8 getNumMetaData(ChipContext *_ctx) {
+  return NUM_META_DATA;
+}
+
+static ChipMetaDataEntry *getMetaData(ChipContext *_ctx, u8 _index) {
+  ChipMetaDataEntry *entry = &_ctx->metaData[_index];
   switch (_index) {
-    case 0:entry->value = sSong.ch0Octave;
+    case 0:entry->value = _ctx->song.ch0Octave;
       break;
-    case 1:entry->value = sSong.ch1Octave;
+    case 1:entry->value = _ctx->song.ch1Octave;
       break;
-    case 2:entry->value = sSong.ch2Octave;
+    case 2:entry->value = _ctx->song.ch2Octave;
       break;
-    case 3:entry->value = sSong.meter;
+    case 3:entry->value = _ctx->song.meter;
       break;
-    case 4:entry->value = sSong.loopSong;
+    case 4:entry->value = _ctx->song.loopSong;
       break;
-    case 5:entry->value = sSong.tempo;
+    case 5:entry->value = _ctx->song.tempo;
       break;
   }
   return entry;
 }
 
-static ChipError setMetaData(u8 _index, ChipMetaDataEntry *entry) {
+static ChipError setMetaData(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry) {
   switch (_index) {
-    case 0:sSong.ch0Octave = entry->value;
+    case 0:_ctx->song.ch0Octave = entry->value;
       break;
-    case 1:sSong.ch1Octave = entry->value;
+    case 1:_ctx->song.ch1Octave = entry->value;
       break;
-    case 2:sSong.ch2Octave = entry->value;
+    case 2:_ctx->song.ch2Octave = entry->value;
       break;
-    case 3:sSong.meter = entry->value;
+    case 3:_ctx->song.meter = entry->value;
       break;
-    case 4:sSong.loopSong = entry->value;
+    case 4:_ctx->song.loopSong = entry->value;
       break;
-    case 5:sSong.tempo = entry->value;
+    case 5:_ctx->song.tempo = entry->value;
       break;
   }
   return NO_ERR;
 }
 
-static u8 getNumSaveOptions() {
+static u8 getNumSaveOptions(ChipContext *_ctx) {
   return 0;
 }
 
-static ChipMetaDataEntry *getSaveOptions(u8 _index) {
+static ChipMetaDataEntry *getSaveOptions(ChipContext *_ctx, u8 _index) {
   return NULL;
 }
 
-static ChipError setSaveOptions(u8 _index, ChipMetaDataEntry *entry) {
+static ChipError setSaveOptions(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry) {
   return NO_ERR;
 }
 
-static u16 getNumSongRows() {
+static u16 getNumSongRows(ChipContext *_ctx) {
   return 20;
 }
 
-static u8 getNumSongDataColumns(u8 _channelNum) {
+static u8 getNumSongDataColumns(ChipContext *_ctx, u8 _channelNum) {
   return 5;
 }
 
-static ChipError insertSongRow(u8 _channelNum, u8 _atSongRow) {
-  for (int i = getNumSongRows() - 1; i > _atSongRow; i--) {
-    sSong.tracks[_channelNum][i] = sSong.tracks[_channelNum][i - 1];
+static ChipError insertSongRow(ChipContext *_ctx, u8 _channelNum, u8 _atSongRow) {
+  for (int i = getNumSongRows(_ctx) - 1; i > _atSongRow; i--) {
+    _ctx->song.tracks[_channelNum][i] = _ctx->song.tracks[_channelNum][i - 1];
   }
-  sSong.tracks[_channelNum][_atSongRow] = newSongTrack();
+  _ctx->song.tracks[_channelNum][_atSongRow] = newSongTrack();
   return NO_ERR;
 }
 
-static ChipError addSongRow() {
+static ChipError addSongRow(ChipContext *_ctx) {
   return ERR_NOT_SUPPORTED;
 }
 
-static ChipError deleteSongRow(u8 _channelNum, u8 _songRow) {
-  for (int i = _songRow; i < getNumSongRows() - 1; i++) {
-    sSong.tracks[_channelNum][i] = sSong.tracks[_channelNum][i + 1];
+static ChipError deleteSongRow(ChipContext *_ctx, u8 _channelNum, u8 _songRow) {
+  for (int i = _songRow; i < getNumSongRows(_ctx) - 1; i++) {
+    _ctx->song.tracks[_channelNum][i] = _ctx->song.tracks[_channelNum][i + 1];
   }
-  sSong.tracks[_channelNum][getNumSongRows() - 1] = newSongTrack();
+  _ctx->song.tracks[_channelNum][getNumSongRows(_ctx) - 1] = newSongTrack();
   return NO_ERR;
 }
 
-static ChipDataType getSongDataType(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static ChipDataType getSongDataType(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
     case 0:
     case 2:
@@ -918,7 +1010,7 @@ static ChipDataType getSongDataType(u8 _songRow, u8 _channelNum, u8 _songDataCol
   }
 }
 
-static const char *getSongHelp(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static const char *getSongHelp(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
     case 0: return "PATTERN";
     case 2: return "SPEED:0=1/1,1=1/2,2=1/4,3=1/8";
@@ -927,43 +1019,43 @@ static const char *getSongHelp(u8 _songRow, u8 _channelNum, u8 _songDataColumn)
   }
 }
 
-static u8 getSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static u8 getSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
-    case 0:return GETLO(sSong.tracks[_channelNum][_songRow].pattern);
-    case 2:return GETLO(sSong.tracks[_channelNum][_songRow].speed);
-    case 4:return GETLO(sSong.tracks[_channelNum][_songRow].options);
+    case 0:return GETLO(_ctx->song.tracks[_channelNum][_songRow].pattern);
+    case 2:return GETLO(_ctx->song.tracks[_channelNum][_songRow].speed);
+    case 4:return GETLO(_ctx->song.tracks[_channelNum][_songRow].options);
     default:return ':';
   }
   return 0;
 }
 
-static u8 clearSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static u8 clearSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
-    case 0:return SETLO(sSong.tracks[_channelNum][_songRow].pattern, 0);
-    case 2:return SETLO(sSong.tracks[_channelNum][_songRow].speed, 0);
-    case 4:return SETLO(sSong.tracks[_channelNum][_songRow].options, 0);
+    case 0:return SETLO(_ctx->song.tracks[_channelNum][_songRow].pattern, 0);
+    case 2:return SETLO(_ctx->song.tracks[_channelNum][_songRow].speed, 0);
+    case 4:return SETLO(_ctx->song.tracks[_channelNum][_songRow].options, 0);
   }
   return 0;
 }
 
-static u8 setSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data) {
+static u8 setSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data) {
   switch (_songDataColumn) {
-    case 0:return SETLO(sSong.tracks[_channelNum][_songRow].pattern, _data);
-    case 2:return SETLO(sSong.tracks[_channelNum][_songRow].speed, _data);
-    case 4:return SETLO(sSong.tracks[_channelNum][_songRow].options, _data);
+    case 0:return SETLO(_ctx->song.tracks[_channelNum][_songRow].pattern, _data);
+    case 2:return SETLO(_ctx->song.tracks[_channelNum][_songRow].speed, _data);
+    case 4:return SETLO(_ctx->song.tracks[_channelNum][_songRow].options, _data);
   }
   return _data;
 }
 
-static void setSongPattern(u8 _songRow, u8 _channelNum, u8 _pattern) {
-  SETLO(sSong.tracks[_channelNum][_songRow].pattern, _pattern);
+static void setSongPattern(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _pattern) {
+  SETLO(_ctx->song.tracks[_channelNum][_songRow].pattern, _pattern);
 }
 
-static u8 getNumChannels() {
+static u8 getNumChannels(ChipContext *_ctx) {
   return 3;
 }
 
-static const char *getChannelName(u8 _patternNum, u8 _width) {
+static const char *getChannelName(ChipContext *_ctx, u8 _patternNum, u8 _width) {
   static char buf[256];
   if (_width == 0) {
     _width = 255;
@@ -973,23 +1065,24 @@ static const char *getChannelName(u8 _patternNum, u8 _width) {
   return (const char *) buf;
 }
 
-static u16 getNumPatterns() {
-  return sSong.meter == SongMeter_4_4 ? 12 : 16;
+static u16 getNumPatterns(ChipContext *_ctx) {
+  return _ctx->song.meter == SongMeter_4_4 ? 12 : 16;
 }
 
-static u8 getPatternNum(u8 _songRow, u8 _channelNum) {
-  return sSong.tracks[_channelNum][_songRow].pattern;
+static u8 getPatternNum(ChipContext *_ctx, u8 _songRow, u8 _channelNum) {
+  return _ctx->song.tracks[_channelNum][_songRow].pattern;
 }
 
-static u8 getPatternLen(u8 _patternNum) {
-  return sSong.meter == SongMeter_4_4 ? 16 : 12;
+static u8 getPatternLen(ChipContext *_ctx, u8 _patternNum) {
+  return _ctx->song.meter == SongMeter_4_4 ? 16 : 12;
 }
 
-static u8 getNumPatternDataColumns(u8 _channelNum, u8 _patternNum, u8 _patternRow) {
+static u8 getNumPatternDataColumns(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow) {
   return 3;
 }
 
-static ChipDataType getPatternDataType(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static ChipDataType getPatternDataType(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow,
+                                       u8 _patternColumn) {
   switch (_patternColumn) {
     case 0: // Note
       return CDT_NOTE;
@@ -1001,12 +1094,12 @@ static ChipDataType getPatternDataType(u8 _channelNum, u8 _patternNum, u8 _patte
   }
 }
 
-static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static u8 getPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
   SongLine *line;
-  if (sSong.meter == SongMeter_4_4) {
-    line = &sSong.pattern44[_patternNum][_patternRow];
+  if (_ctx->song.meter == SongMeter_4_4) {
+    line = &_ctx->song.pattern44[_patternNum][_patternRow];
   } else {
-    line = &sSong.pattern34[_patternNum][_patternRow];
+    line = &_ctx->song.pattern34[_patternNum][_patternRow];
   }
   switch (_patternColumn) {
     case 0: {
@@ -1018,7 +1111,8 @@ static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _pat
   } /* switch */
 }   /* getPatternData */
 
-static const char *getPatternHelp(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static const char *getPatternHelp(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow,
+                                  u8 _patternColumn) {
   switch (_patternColumn) {
     case 0: return "NOTE";
     case 2: return "INSTRUMENT";
@@ -1026,12 +1120,12 @@ static const char *getPatternHelp(u8 _channelNum, u8 _patternNum, u8 _patternRow
   }
 }   /* getPatternHelp */
 
-static u8 clearPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static u8 clearPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
   SongLine *line;
-  if (sSong.meter == SongMeter_4_4) {
-    line = &sSong.pattern44[_patternNum][_patternRow];
+  if (_ctx->song.meter == SongMeter_4_4) {
+    line = &_ctx->song.pattern44[_patternNum][_patternRow];
   } else {
-    line = &sSong.pattern34[_patternNum][_patternRow];
+    line = &_ctx->song.pattern34[_patternNum][_patternRow];
   }
   switch (_patternColumn) {
     case 0: {
@@ -1050,13 +1144,14 @@ static u8 clearPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _p
   return 0;
 }
 
-static u8 setPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn, u8 _instrument,
+static u8 setPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn,
+                         u8 _instrument,
                          u8 _data) {
   SongLine *line;
-  if (sSong.meter == SongMeter_4_4) {
-    line = &sSong.pattern44[_patternNum][_patternRow];
+  if (_ctx->song.meter == SongMeter_4_4) {
+    line = &_ctx->song.pattern44[_patternNum][_patternRow];
   } else {
-    line = &sSong.pattern34[_patternNum][_patternRow];
+    line = &_ctx->song.pattern34[_patternNum][_patternRow];
   }
   switch (_patternColumn) {
     case 0: {
@@ -1083,51 +1178,51 @@ static u8 setPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _pat
   return 0;
 }
 
-static ChipError insertPatternRow(u8 _channelNum, u8 _patternNum, u8 _atPatternRow) {
-  for (u8 i = getPatternLen(_patternNum) - 1; i > _atPatternRow; i--) {
-    if (sSong.meter == SongMeter_4_4) {
-      sSong.pattern44[_patternNum][i] = sSong.pattern44[_patternNum][i - 1];
+static ChipError insertPatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _atPatternRow) {
+  for (u8 i = getPatternLen(_ctx, _patternNum) - 1; i > _atPatternRow; i--) {
+    if (_ctx->song.meter == SongMeter_4_4) {
+      _ctx->song.pattern44[_patternNum][i] = _ctx->song.pattern44[_patternNum][i - 1];
     } else {
-      sSong.pattern34[_patternNum][i] = sSong.pattern34[_patternNum][i - 1];
+      _ctx->song.pattern34[_patternNum][i] = _ctx->song.pattern34[_patternNum][i - 1];
     }
   }
-  if (sSong.meter == SongMeter_4_4) {
-    sSong.pattern44[_patternNum][_atPatternRow] = (SongLine) {0};
+  if (_ctx->song.meter == SongMeter_4_4) {
+    _ctx->song.pattern44[_patternNum][_atPatternRow] = (SongLine) {0};
   } else {
-    sSong.pattern34[_patternNum][_atPatternRow] = (SongLine) {0};
+    _ctx->song.pattern34[_patternNum][_atPatternRow] = (SongLine) {0};
   }
   return NO_ERR;
 }
 
-static ChipError addPatternRow(u8 _channelNum, u8 _patternNum) {
+static ChipError addPatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum) {
   return ERR_NOT_SUPPORTED;
 }
 
-static ChipError deletePatternRow(u8 _channelNum, u8 _patternNum, u8 _patternRow) {
-  for (u8 i = _patternRow; i < getPatternLen(_patternNum) - 1; i++) {
-    if (sSong.meter == SongMeter_4_4) {
-      sSong.pattern44[_patternNum][i] = sSong.pattern44[_patternNum][i + 1];
+static ChipError deletePatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow) {
+  for (u8 i = _patternRow; i < getPatternLen(_ctx, _patternNum) - 1; i++) {
+    if (_ctx->song.meter == SongMeter_4_4) {
+      _ctx->song.pattern44[_patternNum][i] = _ctx->song.pattern44[_patternNum][i + 1];
     } else {
-      sSong.pattern34[_patternNum][i] = sSong.pattern34[_patternNum][i + 1];
+      _ctx->song.pattern34[_patternNum][i] = _ctx->song.pattern34[_patternNum][i + 1];
     }
   }
-  if (sSong.meter == SongMeter_4_4) {
-    sSong.pattern44[_patternNum][getPatternLen(_patternNum) - 1] = (SongLine) {0};
+  if (_ctx->song.meter == SongMeter_4_4) {
+    _ctx->song.pattern44[_patternNum][getPatternLen(_ctx, _patternNum) - 1] = (SongLine) {0};
   } else {
-    sSong.pattern34[_patternNum][getPatternLen(_patternNum) - 1] = (SongLine) {0};
+    _ctx->song.pattern34[_patternNum][getPatternLen(_ctx, _patternNum) - 1] = (SongLine) {0};
   }
   return NO_ERR;
 }
 
-static u8 getMinOctave() {
+static u8 getMinOctave(ChipContext *_ctx) {
   return 0;
 }
 
-static u8 getMaxOctave() {
+static u8 getMaxOctave(ChipContext *_ctx) {
   return 2;
 }
 
-static const char *getInstrumentName(u8 _instrument, u8 _stringWidth) {
+static const char *getInstrumentName(ChipContext *_ctx, u8 _instrument, u8 _stringWidth) {
   static char buf[256] = {0};
   if (_stringWidth == 0) {
     _stringWidth = 3;
@@ -1137,25 +1232,25 @@ static const char *getInstrumentName(u8 _instrument, u8 _stringWidth) {
   return (const char *) buf;
 }
 
-static void setInstrumentName(u8 _instrument, char *_instrName) {}
+static void setInstrumentName(ChipContext *_ctx, u8 _instrument, char *_instrName) {}
 
-static u8 instrumentNameLength(u8 _instrument) {
+static u8 instrumentNameLength(ChipContext *_ctx, u8 _instrument) {
   return 2;
 }
 
-static u16 getNumInstruments() {
+static u16 getNumInstruments(ChipContext *_ctx) {
   return 8;
 }
 
-static u8 getInstrumentLen(u8 _instrument) {
+static u8 getInstrumentLen(ChipContext *_ctx, u8 _instrument) {
   return 34;
 }
 
-static u8 getNumInstrumentParams(u8 _instrument) {
+static u8 getNumInstrumentParams(ChipContext *_ctx, u8 _instrument) {
   return 2;
 }
 
-static const char *getInstrumentParamName(u8 _instrument, u8 _instrumentParam, u8 _stringWidth) {
+static const char *getInstrumentParamName(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _stringWidth) {
   switch (_instrumentParam) {
     case 0:return "Cmd";
     case 1:return "Info";
@@ -1163,7 +1258,7 @@ static const char *getInstrumentParamName(u8 _instrument, u8 _instrumentParam, u
   }
 }
 
-static u8 getNumInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow) {
+static u8 getNumInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow) {
   switch (_instrumentParam) {
     case 0: {
       if (_instrumentRow < 4) {
@@ -1180,7 +1275,7 @@ static u8 getNumInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrume
 }
 
 static ChipDataType
-getInstrumentDataType(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
+getInstrumentDataType(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
   if (_instrumentParam == 0) {
     if (_instrumentRow < 4) {
       return CDT_HEX;
@@ -1194,7 +1289,7 @@ getInstrumentDataType(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8
   }
 }
 
-static const char *getInstrumentLabel(u8 _instrument, u8 _instrumentRow) {
+static const char *getInstrumentLabel(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow) {
   static char buf[3];
   switch (_instrumentRow) {
     case 0:return " A";
@@ -1206,17 +1301,18 @@ static const char *getInstrumentLabel(u8 _instrument, u8 _instrumentRow) {
   }
 }
 
-static u8 getInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
+static u8 getInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                            u8 _instrumentColumn) {
   switch (_instrumentParam) {
     case 0:
       switch (_instrumentRow) {
-        case 0: return sInstruments[_instrument].attack;
-        case 1: return sInstruments[_instrument].decay;
-        case 2: return sInstruments[_instrument].sustain;
-        case 3: return sInstruments[_instrument].release;
+        case 0: return _ctx->instruments[_instrument].attack;
+        case 1: return _ctx->instruments[_instrument].decay;
+        case 2: return _ctx->instruments[_instrument].sustain;
+        case 3: return _ctx->instruments[_instrument].release;
         default: {
           if (_instrumentRow > 33) return ' ';
-          InstrumentInstruction *instr = &sInstruments[_instrument].program[_instrumentRow - 4];
+          InstrumentInstruction *instr = &_ctx->instruments[_instrument].program[_instrumentRow - 4];
           Cmd6Bit cmd6Bit = (instr->raw >> 6) & 0x3;
           switch (cmd6Bit) {
             case Cmd6Bit_Control: {
@@ -1293,7 +1389,7 @@ static u8 getInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentR
         }
       }
     case 1: { // Return Command info
-      Instrument *in = &sInstruments[_instrument];
+      Instrument *in = &_ctx->instruments[_instrument];
       switch (_instrumentRow) {
         case 0: return adsrLabelString('A', in->attack, _instrumentColumn);
         case 1: return adsrLabelString('D', in->decay, _instrumentColumn);
@@ -1301,7 +1397,7 @@ static u8 getInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentR
         case 3: return adsrLabelString('R', in->release, _instrumentColumn);
         default: {
           if (_instrumentRow > 33) return ' ';
-          InstrumentInstruction *instr = &sInstruments[_instrument].program[_instrumentRow - 4];
+          InstrumentInstruction *instr = &_ctx->instruments[_instrument].program[_instrumentRow - 4];
           Cmd6Bit cmd6Bit = (instr->raw >> 6) & 0x3;
           switch (cmd6Bit) {
             case Cmd6Bit_Control: {
@@ -1395,50 +1491,53 @@ static u8 getInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentR
   return 0;
 }
 
-static const char *getInstrumentHelp(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
+static const char *getInstrumentHelp(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                                     u8 _instrumentColumn) {
   return "Ctrl Inc Set Arp Loop Wait Vbr sYn Ring eXt (J)noff";
 }
 
-static u8 clearInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
+static u8 clearInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                              u8 _instrumentColumn) {
   switch (_instrumentRow) {
     case 0: {
-      sInstruments[_instrument].attack = 0;
+      _ctx->instruments[_instrument].attack = 0;
       break;
     }
     case 1: {
-      sInstruments[_instrument].decay = 0;
+      _ctx->instruments[_instrument].decay = 0;
       break;
     }
     case 2: {
-      sInstruments[_instrument].sustain = 0;
+      _ctx->instruments[_instrument].sustain = 0;
       break;
     }
     case 3: {
-      sInstruments[_instrument].release = 0;
+      _ctx->instruments[_instrument].release = 0;
       break;
     }
     default: {
-      sInstruments[_instrument].program[_instrumentRow - 4].loop.loopPosition = 0;
+      _ctx->instruments[_instrument].program[_instrumentRow - 4].loop.loopPosition = 0;
     }
   }
   return 0;
 }
 
-static bool setInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn,
+static bool setInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                              u8 _instrumentColumn,
                               u8 _data) {
   switch (_instrumentRow) {
-    case 0:sInstruments[_instrument].attack = _data;
+    case 0:_ctx->instruments[_instrument].attack = _data;
       break;
-    case 1:sInstruments[_instrument].decay = _data;
+    case 1:_ctx->instruments[_instrument].decay = _data;
       break;
-    case 2:sInstruments[_instrument].sustain = _data;
+    case 2:_ctx->instruments[_instrument].sustain = _data;
       break;
-    case 3:sInstruments[_instrument].release = _data;
+    case 3:_ctx->instruments[_instrument].release = _data;
       break;
     default: {
       if (_instrumentRow > 33) return false;
       if (_instrumentParam == 0) {
-        InstrumentInstruction *instr = &sInstruments[_instrument].program[_instrumentRow - 4];
+        InstrumentInstruction *instr = &_ctx->instruments[_instrument].program[_instrumentRow - 4];
         if (_instrumentColumn == 0) {
           switch (_data) {
             case 'c': {
@@ -1579,82 +1678,105 @@ static bool setInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumen
   return true;
 }
 
-static void swapInstrumentRow(u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2) {
+static void swapInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2) {
   if (_instrumentRow1 < 4 || _instrumentRow2 < 4) return;
   if (_instrumentRow1 > 31 || _instrumentRow2 > 31) return;
   if (_instrumentRow1 == _instrumentRow2) return;
-  InstrumentInstruction temp = sInstruments[_instrument].program[_instrumentRow1 - 4];
-  sInstruments[_instrument].program[_instrumentRow1 - 4] = sInstruments[_instrument].program[_instrumentRow2 - 4];
-  sInstruments[_instrument].program[_instrumentRow2 - 4] = temp;
+  InstrumentInstruction *program = _ctx->instruments[_instrument].program;
+  InstrumentInstruction temp = program[_instrumentRow1 - 4];
+  program[_instrumentRow1 - 4] = program[_instrumentRow2 - 4];
+  program[_instrumentRow2 - 4] = temp;
 }
 
-static bool useTables() { return false; }
+static bool useTables(ChipContext *_ctx) { return false; }
 
-static u8 getNumTableKinds() { return 0; }
+static u8 getNumTableKinds(ChipContext *_ctx) { return 0; }
 
-static const char *getTableKindName(u8 _tableKind) { return ""; }
+static const char *getTableKindName(ChipContext *_ctx, u8 _tableKind) { return ""; }
 
-static u16 getMinTable(u8 _tableKind) { return 0; }
+static u16 getMinTable(ChipContext *_ctx, u8 _tableKind) { return 0; }
 
-static u16 getNumTables(u8 _tableKind) { return 0; }
+static u16 getNumTables(ChipContext *_ctx, u8 _tableKind) { return 0; }
 
-static ChipTableStyle getTableStyle(u8 _tableKind) { return CTS_BOTTOM; }
+static ChipTableStyle getTableStyle(ChipContext *_ctx, u8 _tableKind) { return CTS_BOTTOM; }
 
-static u8 getTableDataLen(u8 _tableKind, u16 _table) { return 0; }
+static u8 getTableDataLen(ChipContext *_ctx, u8 _tableKind, u16 _table) { return 0; }
 
-static u8 getTableData(u8 _tableKind, u16 _table, u8 _tableColumn) { return 0; }
+static u8 getTableData(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn) { return 0; }
 
-static u8 setTableData(u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data) { return 0; }
+static u8 setTableData(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data) { return 0; }
 
-static u8 getPlayerSongRow(u8 _channelNum) {
-  return sSongPos[_channelNum];
+static u8 getPlayerSongRow(ChipContext *_ctx, u8 _channelNum) {
+  return _ctx->songPos[_channelNum];
 }
 
-static u8 getPlayerPatternRow(u8 _channelNum) {
-  return sPatternPos[_channelNum];
+static u8 getPlayerPatternRow(ChipContext *_ctx, u8 _channelNum) {
+  return _ctx->patternPos[_channelNum];
 }
 
-static u8 getPlayerPattern(u8 _channelNum) {
-  return sPattern[_channelNum];
+static u8 getPlayerPattern(ChipContext *_ctx, u8 _channelNum) {
+  return _ctx->pattern[_channelNum];
 }
 
-static u8 getPlayerInstrumentRow(u8 _channelNum) {
-  u8 pos = sInstrumentPos[_channelNum] & 0x1F;
+static u8 getPlayerInstrumentRow(ChipContext *_ctx, u8 _channelNum) {
+  u8 pos = _ctx->instrumentPos[_channelNum] & 0x1F;
   if (pos < 2) return 0x21;
   return pos + 2;
 }
 
-static u8 getPlayerInstrument(u8 _channelNum) {
-  return sInstrumentPos[_channelNum] >> 5;
+static u8 getPlayerInstrument(ChipContext *_ctx, u8 _channelNum) {
+  return _ctx->instrumentPos[_channelNum] >> 5;
 }
 
-static void plonk(u8 _note, u8 _channelNum, u8 _instrument, bool _isDown) {
+static void plonk(ChipContext *_ctx, u8 _note, u8 _channelNum, u8 _instrument, bool _isDown) {
   if (_note == 0xFF) _isDown = false;
-  playerPlayNote(_channelNum, _note, _instrument, _isDown);
+  playerPlayNote(_ctx, _channelNum, _note, _instrument, _isDown);
+}
+
+static void playSongFrom(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
+  playerPlay(_ctx, _songRow, _patternRow);
+}
+
+static void playPatternFrom(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
+  playerPlayPattern(_ctx, _songRow, _patternRow);
+}
+
+static bool isPlaying(ChipContext *_ctx) {
+  return _ctx->playing;
 }
 
-static void playSongFrom(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
-  playerPlay(_songRow, _patternRow);
+static u32 getLoopCount(ChipContext *_ctx) {
+  return _ctx->loopDetector.loopCount;
 }
 
-static void playPatternFrom(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
-  playerPlayPattern(_songRow, _patternRow);
+static void silence(ChipContext *_ctx) {
+  playerStop(_ctx);
 }
 
-static bool isPlaying() {
-  return sIsPlaying;
+static void stop(ChipContext *_ctx) {
+  silence(_ctx);
 }
 
-static void silence() {
-  playerStop();
+static void getSamples(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  sidTick(_ctx, _buf, _len);
 }
 
-static void stop() {
-  silence();
+static u32 dryRunTick(ChipContext *_ctx) {
+  // The shadow registers are all the SID would have seen; rendering picks up at the next frame
+  playerTick(_ctx);
+  _ctx->clocks = 0;
+  return _ctx->sampleRate / 50;
 }
 
-static void getSamples(ChipSample *_buf, int _len) {
-  sidTick(_buf, _len);
+static ChipError setFastPreview(ChipContext *_ctx, bool _fast) {
+  if (_fast != _ctx->fastPreview) {
+    // Start the other model from silence on a frame boundary
+    _ctx->fastPreview = _fast;
+    m6581_reset(&_ctx->sid);
+    sidfast_reset(&_ctx->fastSid);
+    _ctx->clocks = 0;
+  }
+  return NO_ERR;
 }
 
 static void preferredWindowSize(u32 *_width, u32 *_height) {
@@ -1758,9 +1880,12 @@ ChipInterface chip_bv = {
     playSongFrom,
     playPatternFrom,
     isPlaying,
+    getLoopCount,
     stop,
     silence,
     getSamples,
+    dryRunTick,
+    setFastPreview,
 
     // GUI Options
     preferredWindowSize
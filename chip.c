@@ -1,25 +1,122 @@
 
-#include "tracker.h"
 #include "chip.h"
+#include <string.h>
 
 extern ChipInterface chip_p1xl;
 extern ChipInterface chip_lft;
 extern ChipInterface chip_bv;
 ChipInterface *chips[] = {&chip_p1xl, &chip_lft, &chip_bv, NULL};
 
-#define DELAY_SIZE (512)
+#define DELAY_SIZE (CHIP_EXPAND_DELAY_SIZE)
 #define FEEDBACK (0.6f)
 #define EXPAND
 
-ChipSample chip_expandSample(ChipSample _sample) {
-  static s16 delay[DELAY_SIZE];
-  static int pos = 0;
+ChipSample chip_expandSample(ChipExpandState *_state, ChipSample _sample) {
+  s16 *delay = _state->delay;
+  int pos = _state->pos;
   ChipSample out;
   out.left = (_sample.left >> 1) + (delay[(pos + (DELAY_SIZE >> 1)) & (DELAY_SIZE - 1)] >> 1);
   out.right = (_sample.right >> 1) + (delay[pos & (DELAY_SIZE - 1)] >> 1);
   int oldPos = (pos + DELAY_SIZE - 1) & (DELAY_SIZE - 1);
   delay[oldPos] = (delay[oldPos] * (FEEDBACK / 2.0f)) + (((_sample.left + _sample.right) >> 1) * FEEDBACK);
-  pos++;
+  _state->pos = (pos + 1) & (DELAY_SIZE - 1);
   return out;
 }
 
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+typedef s16 v8s16 __attribute__((vector_size(16)));
+typedef s16 v4s16 __attribute__((vector_size(8)));
+typedef s32 v4s32 __attribute__((vector_size(16)));
+typedef float v4f32 __attribute__((vector_size(16)));
+
+/**
+ * Four samples of chip_expandSample at once; the caller makes sure none of the slots touched wrap around.
+ * Loading everything before storing matches the per-sample order, as each sample only writes the slot
+ * the one before it has already read.
+ */
+static void expandFour(s16 *_delay, int _pos, ChipSample *_buf) {
+  v4s16 right, left, old;
+  v8s16 in;
+  memcpy(&right, &_delay[_pos], sizeof(right));
+  memcpy(&left, &_delay[(_pos + (DELAY_SIZE >> 1)) & (DELAY_SIZE - 1)], sizeof(left));
+  memcpy(&old, &_delay[_pos - 1], sizeof(old));
+  memcpy(&in, _buf, sizeof(in));
+
+  v8s16 delayed = __builtin_shufflevector(left, right, 0, 4, 1, 5, 2, 6, 3, 7);
+  v8s16 out = (in >> 1) + (delayed >> 1);
+
+  // Left is the low half of each 32 bit lane on little endian targets
+  v4s32 pairs = (v4s32) in;
+  v4s32 mono = (((pairs << 16) >> 16) + (pairs >> 16)) >> 1;
+  v4f32 feedback = __builtin_convertvector(old, v4f32) * (FEEDBACK / 2.0f) +
+                   __builtin_convertvector(mono, v4f32) * FEEDBACK;
+  v4s16 written = __builtin_convertvector(__builtin_convertvector(feedback, v4s32), v4s16);
+
+  memcpy(_buf, &out, sizeof(out));
+  memcpy(&_delay[_pos - 1], &written, sizeof(written));
+}
+#endif
+
+void chip_expandSamples(ChipExpandState *_state, ChipSample *_buf, int _len) {
+  int i = 0;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (i + 4 <= _len) {
+    int pos = _state->pos;
+    // Slot 0 writes the last slot, and the left tap wraps half way through, so take those a sample at a time
+    int end = pos < (DELAY_SIZE >> 1) ? (DELAY_SIZE >> 1) : DELAY_SIZE;
+    if (pos == 0 || end - pos < 4) {
+      _buf[i] = chip_expandSample(_state, _buf[i]);
+      i++;
+      continue;
+    }
+    for (; pos + 4 <= end && i + 4 <= _len; pos += 4, i += 4) {
+      expandFour(_state->delay, pos, &_buf[i]);
+    }
+    _state->pos = pos & (DELAY_SIZE - 1);
+  }
+#endif
+  for (; i < _len; i++) {
+    _buf[i] = chip_expandSample(_state, _buf[i]);
+  }
+}
+
+void chip_loopReset(ChipLoopDetector *_detector) {
+  _detector->numHashes = 0;
+  _detector->loopCount = 0;
+}
+
+void chip_loopVisit(ChipLoopDetector *_detector, const void *_state, size_t _size) {
+  // FNV-1a
+  const u8 *bytes = _state;
+  u32 hash = 2166136261u;
+  for (size_t i = 0; i < _size; i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  for (u32 i = 0; i < _detector->numHashes; i++) {
+    if (_detector->hashes[i] == hash) {
+      _detector->loopCount++;
+      _detector->numHashes = 0;
+      break;
+    }
+  }
+  if (_detector->numHashes < CHIP_LOOP_STATES) {
+    _detector->hashes[_detector->numHashes++] = hash;
+  }
+}
+
+uint64_t chip_measureSong(ChipInterface *_chip, ChipContext *_ctx, u32 _loops, uint64_t _maxSamples) {
+  uint64_t length = 0;
+  _chip->playSongFrom(_ctx, 0, 0, 0, 0);
+  while (_chip->isPlaying(_ctx) && _chip->getLoopCount(_ctx) < _loops && length < _maxSamples) {
+    length += _chip->dryRunTick(_ctx);
+  }
+  return length < _maxSamples ? length : _maxSamples;
+}
+
+void chip_fadeOut(ChipSample *_buf, int _len, u32 _pos, u32 _length) {
+  for (int i = 0; i < _len; i++, _pos++) {
+    float gain = _pos < _length ? 1.0f - (float) _pos / _length : 0.0f;
+    _buf[i].left = _buf[i].left * gain;
+    _buf[i].right = _buf[i].right * gain;
+  }
+}
@@ -2,11 +2,16 @@
 #ifndef CHIP_H
 #define CHIP_H
 
+#include <stddef.h>
 #include "types.h"
 
 struct TextEdit;
 typedef struct TextEdit TextEdit;
 
+// Engine state for one song, defined privately by each chip
+struct ChipContext;
+typedef struct ChipContext ChipContext;
+
 #define SETLO(v, x) v = ((v) & 0xf0) | (x)
 #define SETHI(v, x) v = ((v) & 0x0f) | ((x) << 4)
 #define GETLO(v) ((v) & 0xf)
@@ -44,194 +49,262 @@ typedef struct {
 
 typedef const char *ChipError;
 
+#define CHIP_EXPAND_DELAY_SIZE (512)
+
+typedef struct {
+  s16 delay[CHIP_EXPAND_DELAY_SIZE];
+  int pos;
+} ChipExpandState;
+
+#define CHIP_LOOP_STATES (1024)
+
+typedef struct {
+  u32 hashes[CHIP_LOOP_STATES];
+  u32 numHashes;
+  u32 loopCount;
+} ChipLoopDetector;
+
+// Output rate used unless the frontend asks for another one; engines refuse rates outside the min/max
+#define CHIP_DEFAULT_SAMPLE_RATE (44100)
+#define CHIP_MIN_SAMPLE_RATE (8000)
+#define CHIP_MAX_SAMPLE_RATE (192000)
+
 #define NO_ERR (NULL)
 #define ERR_UNKNOWN ("Unknown error")
 #define ERR_FILE_NOT_FOUND ("File not found")
 #define ERR_FILE_WRITE ("File write error")
 #define ERR_FILE_READ ("File read error")
 #define ERR_NOT_SUPPORTED ("Not supported")
+#define ERR_OUT_OF_MEMORY ("Out of memory")
 
 typedef struct {
   // Tracker Commands
   const char *(*getChipId)();
 
-  ChipError (*init)();
+  // _sampleRate is the output rate in Hz; every later getSamples call produces samples at that rate
+  ChipError (*init)(ChipContext **_ctx, u32 _sampleRate);
 
-  ChipError (*shutdown)();
+  ChipError (*shutdown)(ChipContext *_ctx);
 
-  ChipError (*newSong)();
+  ChipError (*newSong)(ChipContext *_ctx);
 
-  ChipError (*loadSong)(const char *filename);
+  ChipError (*loadSong)(ChipContext *_ctx, const char *filename);
 
-  ChipError (*saveSong)(const char *filename);
+  ChipError (*saveSong)(ChipContext *_ctx, const char *filename);
 
-  ChipError (*insertSongRow)(u8 _channelNum, u8 _songRow);
+  ChipError (*insertSongRow)(ChipContext *_ctx, u8 _channelNum, u8 _songRow);
 
-  ChipError (*addSongRow)();
+  ChipError (*addSongRow)(ChipContext *_ctx);
 
-  ChipError (*deleteSongRow)(u8 _channelNum, u8 _songRow);
+  ChipError (*deleteSongRow)(ChipContext *_ctx, u8 _channelNum, u8 _songRow);
 
-  ChipError (*insertPatternRow)(u8 _channelNum, u8 _patternNum, u8 _atPatternRow);
+  ChipError (*insertPatternRow)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _atPatternRow);
 
-  ChipError (*addPatternRow)(u8 _channelNum, u8 _patternNum);
+  ChipError (*addPatternRow)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum);
 
-  ChipError (*deletePatternRow)(u8 _channelNum, u8 _patternNum, u8 _patternRow);
+  ChipError (*deletePatternRow)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow);
 
-  ChipError (*insertInstrumentRow)(u8 _instrument, u8 _atInstrumentRow);
+  ChipError (*insertInstrumentRow)(ChipContext *_ctx, u8 _instrument, u8 _atInstrumentRow);
 
-  ChipError (*addInstrumentRow)(u8 _instrument);
+  ChipError (*addInstrumentRow)(ChipContext *_ctx, u8 _instrument);
 
-  ChipError (*deleteInstrumentRow)(u8 _instrument, u8 _instrumentRow);
+  ChipError (*deleteInstrumentRow)(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow);
 
-  ChipError (*insertTableColumn)(u8 _tableKind, u8 _table, u8 _atColumn);
+  ChipError (*insertTableColumn)(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn);
 
-  ChipError (*addTableColumn)(u8 _tableKind, u8 _table);
+  ChipError (*addTableColumn)(ChipContext *_ctx, u8 _tableKind, u8 _table);
 
-  ChipError (*deleteTableColumn)(u8 _tableKind, u8 _table, u8 _atColumn);
+  ChipError (*deleteTableColumn)(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn);
 
   // Metadata
-  u8 (*getNumMetaData)();
+  u8 (*getNumMetaData)(ChipContext *_ctx);
 
-  ChipMetaDataEntry *(*getMetaData)(u8 _index);
+  ChipMetaDataEntry *(*getMetaData)(ChipContext *_ctx, u8 _index);
 
-  ChipError (*setMetaData)(u8 _index, ChipMetaDataEntry *entry);
+  ChipError (*setMetaData)(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry);
 
   // Save Options
-  u8 (*getNumSaveOptions)();
+  u8 (*getNumSaveOptions)(ChipContext *_ctx);
 
-  ChipMetaDataEntry *(*getSaveOptions)(u8 _index);
+  ChipMetaDataEntry *(*getSaveOptions)(ChipContext *_ctx, u8 _index);
 
-  ChipError (*setSaveOptions)(u8 _index, ChipMetaDataEntry *entry);
+  ChipError (*setSaveOptions)(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry);
 
   // Song Data
-  u16 (*getNumSongRows)();
+  u16 (*getNumSongRows)(ChipContext *_ctx);
 
-  u8 (*getNumSongDataColumns)(u8 _channelNum);
+  u8 (*getNumSongDataColumns)(ChipContext *_ctx, u8 _channelNum);
 
-  ChipDataType (*getSongDataType)(u8 _songRow, u8 _channelNum, u8 _songDataColumn);
+  ChipDataType (*getSongDataType)(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn);
 
-  u8 (*getSongData)(u8 _songRow, u8 _channelNum, u8 _songDataColumn);
+  u8 (*getSongData)(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn);
 
-  u8 (*clearSongData)(u8 _songRow, u8 _channelNum, u8 _songDataColumn);
+  u8 (*clearSongData)(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn);
 
-  u8 (*setSongData)(u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data);
+  u8 (*setSongData)(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data);
 
-  void (*setSongPattern)(u8 _songRow, u8 _channelNum, u8 _pattern);
+  void (*setSongPattern)(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _pattern);
 
-  const char *(*getSongHelp)(u8 _songRow, u8 _channelNum, u8 _songDataColumn);
+  const char *(*getSongHelp)(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn);
 
   // Channels
-  u8 (*getNumChannels)();
+  u8 (*getNumChannels)(ChipContext *_ctx);
 
-  const char *(*getChannelName)(u8 _patternNum, u8 _stringWidth);
+  const char *(*getChannelName)(ChipContext *_ctx, u8 _patternNum, u8 _stringWidth);
 
   // Patterns
-  u16 (*getNumPatterns)();
+  u16 (*getNumPatterns)(ChipContext *_ctx);
 
-  u8 (*getPatternNum)(u8 _songRow, u8 _channelNum);
+  u8 (*getPatternNum)(ChipContext *_ctx, u8 _songRow, u8 _channelNum);
 
-  u8 (*getPatternLen)(u8 _patternNum);
+  u8 (*getPatternLen)(ChipContext *_ctx, u8 _patternNum);
 
-  u8 (*getNumPatternDataColumns)(u8 _channelNum, u8 _patternNum, u8 _patternRow);
+  u8 (*getNumPatternDataColumns)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow);
 
-  ChipDataType (*getPatternDataType)(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
+  ChipDataType (*getPatternDataType)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
 
-  u8 (*getPatternData)(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
+  u8 (*getPatternData)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
 
-  const char *(*getPatternHelp)(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
+  const char *(*getPatternHelp)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
 
-  u8 (*clearPatternData)(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
+  u8 (*clearPatternData)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn);
 
-  u8 (*setPatternData)(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn, u8 _instrument,
+  u8 (*setPatternData)(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn, u8 _instrument,
                        u8 _data);
 
-  u8 (*getMinOctave)();
+  u8 (*getMinOctave)(ChipContext *_ctx);
 
-  u8 (*getMaxOctave)();
+  u8 (*getMaxOctave)(ChipContext *_ctx);
 
   // Instruments
-  const char *(*getInstrumentName)(u8 _instrument, u8 _stringWidth);
+  const char *(*getInstrumentName)(ChipContext *_ctx, u8 _instrument, u8 _stringWidth);
 
-  void (*setInstrumentName)(u8 _instrument, char *_instrName);
+  void (*setInstrumentName)(ChipContext *_ctx, u8 _instrument, char *_instrName);
 
-  u8 (*instrumentNameLength)(u8 _instrument);
+  u8 (*instrumentNameLength)(ChipContext *_ctx, u8 _instrument);
 
-  u16 (*getNumInstruments)();
+  u16 (*getNumInstruments)(ChipContext *_ctx);
 
-  u8 (*getInstrumentLen)(u8 _instrument);
+  u8 (*getInstrumentLen)(ChipContext *_ctx, u8 _instrument);
 
-  u8 (*getNumInstrumentParams)(u8 _instrument);
+  u8 (*getNumInstrumentParams)(ChipContext *_ctx, u8 _instrument);
 
-  const char *(*getInstrumentParamName)(u8 _instrument, u8 _instrumentParam, u8 _stringWidth);
+  const char *(*getInstrumentParamName)(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _stringWidth);
 
-  u8 (*getNumInstrumentData)(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow);
+  u8 (*getNumInstrumentData)(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow);
 
-  ChipDataType (*getInstrumentDataType)(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+  ChipDataType (*getInstrumentDataType)(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
                                         u8 _instrumentColumn);
 
-  u8 (*getInstrumentData)(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn);
+  u8 (*getInstrumentData)(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn);
 
-  const char *(*getInstrumentHelp)(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn);
+  const char *(*getInstrumentHelp)(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn);
 
-  const char *(*getInstrumentLabel)(u8 _instrument, u8 _instrumentRow);
+  const char *(*getInstrumentLabel)(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow);
 
-  u8 (*clearInstrumentData)(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn);
+  u8 (*clearInstrumentData)(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn);
 
-  bool (*setInstrumentData)(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn,
+  bool (*setInstrumentData)(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn,
                             u8 _data);
 
-  void (*swapInstrumentRow)(u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2);
+  void (*swapInstrumentRow)(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2);
 
   // Tables
-  bool (*useTables)();
+  bool (*useTables)(ChipContext *_ctx);
 
-  u8 (*getNumTableKinds)();
+  u8 (*getNumTableKinds)(ChipContext *_ctx);
 
-  const char *(*getTableKindName)(u8 _tableKind);
+  const char *(*getTableKindName)(ChipContext *_ctx, u8 _tableKind);
 
-  ChipTableStyle (*getTableStyle)(u8 _tableKind);
+  ChipTableStyle (*getTableStyle)(ChipContext *_ctx, u8 _tableKind);
 
-  u16 (*getMinTable)(u8 _tableKind);
+  u16 (*getMinTable)(ChipContext *_ctx, u8 _tableKind);
 
-  u16 (*getNumTables)(u8 _tableKind);
+  u16 (*getNumTables)(ChipContext *_ctx, u8 _tableKind);
 
-  u8 (*getTableDataLen)(u8 _tableKind, u16 _table);
+  u8 (*getTableDataLen)(ChipContext *_ctx, u8 _tableKind, u16 _table);
 
-  u8 (*getTableData)(u8 _tableKind, u16 _table, u8 _tableColumn);
+  u8 (*getTableData)(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn);
 
-  u8 (*setTableData)(u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data);
+  u8 (*setTableData)(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data);
 
   // Player
-  u8 (*getPlayerSongRow)(u8 _channelNum);
+  u8 (*getPlayerSongRow)(ChipContext *_ctx, u8 _channelNum);
+
+  u8 (*getPlayerPatternRow)(ChipContext *_ctx, u8 _channelNum);
+
+  u8 (*getPlayerPattern)(ChipContext *_ctx, u8 _channelNum);
+
+  u8 (*getPlayerInstrumentRow)(ChipContext *_ctx, u8 _channelNum);
 
-  u8 (*getPlayerPatternRow)(u8 _channelNum);
+  u8 (*getPlayerInstrument)(ChipContext *_ctx, u8 _channelNum);
 
-  u8 (*getPlayerPattern)(u8 _channelNum);
+  void (*plonk)(ChipContext *_ctx, u8 _note, u8 _channelNum, u8 _instrument, bool _isDown);
 
-  u8 (*getPlayerInstrumentRow)(u8 _channelNum);
+  void (*playSongFrom)(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn);
 
-  u8 (*getPlayerInstrument)(u8 _channelNum);
+  void (*playPatternFrom)(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn);
 
-  void (*plonk)(u8 _note, u8 _channelNum, u8 _instrument, bool _isDown);
+  bool (*isPlaying)(ChipContext *_ctx);
 
-  void (*playSongFrom)(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn);
+  u32 (*getLoopCount)(ChipContext *_ctx);
 
-  void (*playPatternFrom)(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn);
+  void (*stop)(ChipContext *_ctx);
 
-  bool (*isPlaying)();
+  void (*silence)(ChipContext *_ctx);
 
-  void (*stop)();
+  void (*getSamples)(ChipContext *_ctx, ChipSample *_buf, int _len);
 
-  void (*silence)();
+  // Runs the sequencer for one tick without synthesizing anything and returns the output samples the tick
+  // stands for. Oscillator state is left wherever it was, so silence or restart the song before rendering.
+  u32 (*dryRunTick)(ChipContext *_ctx);
 
-  void (*getSamples)(ChipSample *_buf, int _len);
+  // Trades accuracy for speed while editing; ERR_NOT_SUPPORTED when the engine has a single model
+  ChipError (*setFastPreview)(ChipContext *_ctx, bool _fast);
 
   void (*preferredWindowSize)(u32 *_width, u32 *_height);
 } ChipInterface;
 
 extern ChipInterface *chips[];
 
-ChipSample chip_expandSample(ChipSample _sample);
+/**
+ * Widens a sample into stereo through a feedback delay line
+ * @param _state Delay line owned by the caller, zero initialized
+ */
+ChipSample chip_expandSample(ChipExpandState *_state, ChipSample _sample);
+
+/**
+ * Same as calling chip_expandSample on every sample of a buffer, in place, but vectorised
+ * @param _state Delay line owned by the caller, so separate instances can run on separate threads
+ */
+void chip_expandSamples(ChipExpandState *_state, ChipSample *_buf, int _len);
+
+/**
+ * Forgets all visited sequencer states and resets the loop count
+ */
+void chip_loopReset(ChipLoopDetector *_detector);
+
+/**
+ * Records a sequencer state, usually taken at the start of a song row. When the state
+ * has been visited before the song has looped: the loop count is incremented and
+ * detection starts over from this state.
+ * @param _state Sequencer state to hash
+ * @param _size Size of the state in bytes
+ */
+void chip_loopVisit(ChipLoopDetector *_detector, const void *_state, size_t _size);
+
+/**
+ * Plays a song from its start with dryRunTick until it stops, has looped _loops times or reaches _maxSamples
+ * @return Length in samples at the rate _ctx was initialized with
+ */
+uint64_t chip_measureSong(ChipInterface *_chip, ChipContext *_ctx, u32 _loops, uint64_t _maxSamples);
+
+/**
+ * Applies a linear fade out to a block of samples
+ * @param _pos Position of the first sample within the fade
+ * @param _length Length of the whole fade in samples
+ */
+void chip_fadeOut(ChipSample *_buf, int _len, u32 _pos, u32 _length);
 
 #endif // ifndef CHIP_H
 
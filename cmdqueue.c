@@ -0,0 +1,77 @@
+#include "cmdqueue.h"
+
+void cmdqueue_init(CmdQueue *_queue) {
+  atomic_init(&_queue->head, 0);
+  atomic_init(&_queue->tail, 0);
+}
+
+ChipError cmdqueue_push(CmdQueue *_queue, const ChipCommand *_command) {
+  unsigned head = atomic_load_explicit(&_queue->head, memory_order_relaxed);
+  unsigned tail = atomic_load_explicit(&_queue->tail, memory_order_acquire);
+  if (head - tail >= CMDQUEUE_SIZE) {
+    return ERR_QUEUE_FULL;
+  }
+  _queue->commands[head & (CMDQUEUE_SIZE - 1)] = *_command;
+  // Publish the command before the consumer can see the new head
+  atomic_store_explicit(&_queue->head, head + 1, memory_order_release);
+  return NO_ERR;
+}
+
+ChipError cmdqueue_plonk(CmdQueue *_queue, u8 _note, u8 _channelNum, u8 _instrument, bool _isDown) {
+  ChipCommand command = {CMD_PLONK, {_note, _channelNum, _instrument, _isDown}};
+  return cmdqueue_push(_queue, &command);
+}
+
+ChipError cmdqueue_playSongFrom(CmdQueue *_queue, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
+  ChipCommand command = {CMD_PLAY_SONG_FROM, {_songRow, _songColumn, _patternRow, _patternColumn}};
+  return cmdqueue_push(_queue, &command);
+}
+
+ChipError cmdqueue_playPatternFrom(CmdQueue *_queue, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
+  ChipCommand command = {CMD_PLAY_PATTERN_FROM, {_songRow, _songColumn, _patternRow, _patternColumn}};
+  return cmdqueue_push(_queue, &command);
+}
+
+ChipError cmdqueue_stop(CmdQueue *_queue) {
+  ChipCommand command = {CMD_STOP};
+  return cmdqueue_push(_queue, &command);
+}
+
+ChipError cmdqueue_silence(CmdQueue *_queue) {
+  ChipCommand command = {CMD_SILENCE};
+  return cmdqueue_push(_queue, &command);
+}
+
+static void run(const ChipCommand *_command, ChipInterface *_chip, ChipContext *_ctx) {
+  const u8 *args = _command->args;
+  switch (_command->type) {
+    case CMD_PLONK:
+      _chip->plonk(_ctx, args[0], args[1], args[2], args[3]);
+      break;
+    case CMD_PLAY_SONG_FROM:
+      _chip->playSongFrom(_ctx, args[0], args[1], args[2], args[3]);
+      break;
+    case CMD_PLAY_PATTERN_FROM:
+      _chip->playPatternFrom(_ctx, args[0], args[1], args[2], args[3]);
+      break;
+    case CMD_STOP:
+      _chip->stop(_ctx);
+      break;
+    case CMD_SILENCE:
+      _chip->silence(_ctx);
+      break;
+    default: break;
+  }
+}
+
+int cmdqueue_drain(CmdQueue *_queue, ChipInterface *_chip, ChipContext *_ctx) {
+  unsigned tail = atomic_load_explicit(&_queue->tail, memory_order_relaxed);
+  unsigned head = atomic_load_explicit(&_queue->head, memory_order_acquire);
+  int count = head - tail;
+  for (; tail != head; tail++) {
+    run(&_queue->commands[tail & (CMDQUEUE_SIZE - 1)], _chip, _ctx);
+  }
+  // Hand the slots back to the producer only once the commands have been copied out
+  atomic_store_explicit(&_queue->tail, tail, memory_order_release);
+  return count;
+}
@@ -0,0 +1,69 @@
+#ifndef CMDQUEUE_H
+#define CMDQUEUE_H
+
+#include <stdatomic.h>
+#include "types.h"
+#include "chip.h"
+
+// Must be a power of two
+#define CMDQUEUE_SIZE (256)
+
+#define ERR_QUEUE_FULL ("Command queue full")
+
+// Only the play controls, which must never wait for the audio thread. Every edit to song data (song, pattern,
+// instrument, table and meta data, row inserts and deletes) is made in place while holding the producer lock
+// instead, since the UI reads the result straight back; see lockEngine in tracker.c.
+typedef enum {
+  CMD_PLONK,
+  CMD_PLAY_SONG_FROM,
+  CMD_PLAY_PATTERN_FROM,
+  CMD_STOP,
+  CMD_SILENCE,
+} ChipCommandType;
+
+typedef struct {
+  u8 type;
+  u8 args[7];
+} ChipCommand;
+
+/**
+ * Bounded queue of engine commands with a single producer, the UI thread, which never blocks. The consumer
+ * is whichever thread holds the producer lock: the audio producer thread between blocks, or the UI thread
+ * itself when it takes the lock for an in-place edit and drains first. The lock is what keeps the two from
+ * draining at once; the queue only orders head against tail.
+ */
+typedef struct {
+  ChipCommand commands[CMDQUEUE_SIZE];
+  atomic_uint head; // Next slot to write, owned by the producer
+  atomic_uint tail; // Next slot to read, owned by the consumer
+} CmdQueue;
+
+/**
+ * Empties the queue; only call while neither side is using it
+ */
+void cmdqueue_init(CmdQueue *_queue);
+
+/**
+ * Appends a command
+ * @return ERR_QUEUE_FULL if the consumer has fallen CMDQUEUE_SIZE commands behind
+ */
+ChipError cmdqueue_push(CmdQueue *_queue, const ChipCommand *_command);
+
+ChipError cmdqueue_plonk(CmdQueue *_queue, u8 _note, u8 _channelNum, u8 _instrument, bool _isDown);
+
+ChipError cmdqueue_playSongFrom(CmdQueue *_queue, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn);
+
+ChipError cmdqueue_playPatternFrom(CmdQueue *_queue, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn);
+
+ChipError cmdqueue_stop(CmdQueue *_queue);
+
+ChipError cmdqueue_silence(CmdQueue *_queue);
+
+/**
+ * Applies every queued command to an engine, in order. Only call while holding the producer lock, or with
+ * the producer stopped.
+ * @return Number of commands applied
+ */
+int cmdqueue_drain(CmdQueue *_queue, ChipInterface *_chip, ChipContext *_ctx);
+
+#endif // ifndef CMDQUEUE_H
@@ -6,13 +6,16 @@
 #include <SDL.h>
 #include <SDL_opengl.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <string.h>
+#include <unistd.h>
 #include <err.h>
 #include "types.h"
-#include "font.h"
+#include "tables.h"
 #include "console.h"
 #include "tracker.h"
 #include "actions.h"
+#include "timing.h"
 
 SDL_Keycode asciiKeys[] = {
     SDL_SCANCODE_0, SDL_SCANCODE_1, SDL_SCANCODE_2, SDL_SCANCODE_3, SDL_SCANCODE_4, SDL_SCANCODE_5,
@@ -70,11 +73,14 @@ static const GLubyte sPalette[] = {
 };
 
 #define BLINK_SPEED (15)
+#define AUDIO_CALLBACK_SAMPLES (512)
+#define DEFAULT_AHEAD_MS (50)
+#define PRODUCER_BLOCK (256)
+#define UNDERRUN_REPORT_MS (1000)
 
 static GLboolean sDirty = GL_TRUE;
 static u32 *sChars = NULL;
 static char *sPrintFBuffer = NULL;
-static GLubyte *sTexture;
 static int sCharsXPos = 0;
 static int sCharsYPos = 0;
 static u32 sLastAttrib = (128 + 31) << 8;
@@ -98,6 +104,26 @@ ConsoleMessage sMessages[NUM_MESSAGES];
 int sMessagesBottom = NUM_MESSAGES - 1;
 int sMessagesPos = NUM_MESSAGES - 1;
 
+// Render-ahead audio: a producer thread keeps sAudioAhead samples queued in a
+// single-producer/single-consumer ring and the SDL callback only copies out of it
+static ChipSample *sAudioRing = NULL;
+static u32 sAudioRingSize;
+static u32 sAudioAhead;
+// The callback wakes the producer once the ring has drained to this level
+static u32 sAudioWakeLevel;
+// Rate the device actually opened at, which may differ from the one asked for
+static u32 sAudioRate = CHIP_DEFAULT_SAMPLE_RATE;
+static atomic_uint sAudioWritePos;
+static atomic_uint sAudioReadPos;
+static atomic_uint sAudioUnderruns;
+static atomic_uint sAudioLowWater;
+static atomic_uint sAudioHighWater;
+static SDL_Thread *sProducerThread = NULL;
+static SDL_mutex *sProducerLock = NULL;
+static SDL_sem *sProducerWake = NULL;
+static bool sProducerPaused = false;
+static atomic_bool sProducerQuit;
+
 int _error(const char *_msg) {
   printf("%s\n", _msg);
   return -1;
@@ -410,19 +436,121 @@ void con_shutdown() {
 }
 
 /**
- * Pauses audio playback
+ * Renders up to PRODUCER_BLOCK samples into the ring
+ * @param _timed Whether playback is waiting on the ring, in which case the render is timed against the audio
+ *        already queued ahead of it, the time left before the callback runs dry
+ * @return false if the ring already holds sAudioAhead samples
+ */
+static bool renderAudioBlock(bool _timed) {
+  u32 write = atomic_load_explicit(&sAudioWritePos, memory_order_relaxed);
+  u32 read = atomic_load_explicit(&sAudioReadPos, memory_order_acquire);
+  if (write - read >= sAudioAhead) {
+    return false;
+  }
+  u32 pos = write & (sAudioRingSize - 1);
+  u32 len = sAudioAhead - (write - read);
+  if (len > PRODUCER_BLOCK) {
+    len = PRODUCER_BLOCK;
+  }
+  if (len > sAudioRingSize - pos) {
+    len = sAudioRingSize - pos;
+  }
+  double start = timing_now();
+  tracker_getSamples(sAudioRing + pos, len);
+  if (_timed) {
+    tracker_recordRenderTime(timing_now() - start, (double) (write - read) / sAudioRate);
+  }
+  atomic_store_explicit(&sAudioWritePos, write + len, memory_order_release);
+  return true;
+}
+
+/**
+ * Renders into the ring until it holds sAudioAhead samples; only while the producer thread is kept out
+ */
+static void fillAudioRing() {
+  while (renderAudioBlock(false)) {
+  }
+}
+
+/**
+ * Sleeps until the callback makes room, then tops the ring up a block at a time. The lock is dropped between
+ * blocks so an edit waits for at most one block rather than a whole refill.
+ */
+static int audioProducer(void *_data) {
+  for (;;) {
+    SDL_SemWait(sProducerWake);
+    if (atomic_load(&sProducerQuit)) {
+      return 0;
+    }
+    bool more = true;
+    while (more) {
+      SDL_LockMutex(sProducerLock);
+      more = !sProducerPaused && renderAudioBlock(true);
+      SDL_UnlockMutex(sProducerLock);
+    }
+  }
+}
+
+/**
+ * Pauses audio playback. Neither the producer thread nor the callback touch the engine until resumed.
  */
 void con_pauseAudio() {
+  SDL_LockMutex(sProducerLock);
+  sProducerPaused = true;
+  SDL_UnlockMutex(sProducerLock);
   SDL_PauseAudio(1);
 }
 
 /**
- * Resumes audio playback
+ * Keeps the producer thread out of the engine until con_unlockAudio. Playback carries on from the ring,
+ * so short edits are not heard as gaps. Nests, as SDL mutexes are recursive.
+ */
+void con_lockAudio() {
+  SDL_LockMutex(sProducerLock);
+}
+
+void con_unlockAudio() {
+  SDL_UnlockMutex(sProducerLock);
+}
+
+u32 con_audioUnderruns() {
+  return atomic_load(&sAudioUnderruns);
+}
+
+/**
+ * Resumes audio playback, discarding whatever was rendered ahead before the pause
  */
 void con_resumeAudio() {
+  atomic_store(&sAudioReadPos, atomic_load(&sAudioWritePos));
+  fillAudioRing();
+  SDL_LockMutex(sProducerLock);
+  sProducerPaused = false;
+  SDL_UnlockMutex(sProducerLock);
   SDL_PauseAudio(0);
 }
 
+/**
+ * Reports new underruns along with the ring fill range seen since the last report
+ */
+static void reportAudioUnderruns() {
+  static u32 lastTicks = 0;
+  static u32 reported = 0;
+  u32 ticks = SDL_GetTicks();
+  if (ticks - lastTicks < UNDERRUN_REPORT_MS) {
+    return;
+  }
+  lastTicks = ticks;
+  u32 underruns = atomic_load(&sAudioUnderruns);
+  if (underruns == reported) {
+    return;
+  }
+  u32 low = atomic_exchange(&sAudioLowWater, UINT32_MAX);
+  u32 high = atomic_exchange(&sAudioHighWater, 0);
+  con_msgf("AUDIO UNDERRUNS: %u (BUFFERED %u-%uMS OF %uMS)", underruns, low * 1000 / sAudioRate,
+           high * 1000 / sAudioRate, sAudioAhead * 1000 / sAudioRate);
+  reported = underruns;
+}
+
 void resize() {
   int w, h;
   SDL_GL_GetDrawableSize(gWindow, &w, &h);
@@ -575,13 +703,58 @@ void resize() {
 
 void audiocb(void *userdata, u8 *buf, int len) {
   ChipSample *bufCS = (ChipSample *) buf;
-  size_t lenCS = len / sizeof(ChipSample);
-  tracker_getSamples(bufCS, lenCS);
+  u32 lenCS = len / sizeof(ChipSample);
+  u32 read = atomic_load_explicit(&sAudioReadPos, memory_order_relaxed);
+  u32 available = atomic_load_explicit(&sAudioWritePos, memory_order_acquire) - read;
+  if (available < atomic_load_explicit(&sAudioLowWater, memory_order_relaxed)) {
+    atomic_store_explicit(&sAudioLowWater, available, memory_order_relaxed);
+  }
+  if (available > atomic_load_explicit(&sAudioHighWater, memory_order_relaxed)) {
+    atomic_store_explicit(&sAudioHighWater, available, memory_order_relaxed);
+  }
+  u32 count = available < lenCS ? available : lenCS;
+  u32 pos = read & (sAudioRingSize - 1);
+  u32 first = count < sAudioRingSize - pos ? count : sAudioRingSize - pos;
+  memcpy(bufCS, sAudioRing + pos, first * sizeof(ChipSample));
+  memcpy(bufCS + first, sAudioRing, (count - first) * sizeof(ChipSample));
+  atomic_store_explicit(&sAudioReadPos, read + count, memory_order_release);
+  // One pending wake is enough; the producer fills all the way up once it runs
+  if (available - count <= sAudioWakeLevel && SDL_SemValue(sProducerWake) == 0) {
+    SDL_SemPost(sProducerWake);
+  }
+  if (count < lenCS) {
+    // The producer fell behind; play silence rather than block
+    memset(bufCS + count, 0, (lenCS - count) * sizeof(ChipSample));
+    atomic_fetch_add_explicit(&sAudioUnderruns, 1, memory_order_relaxed);
+  }
 }
 
 int main(int argc, char *argv[]) {
+  u32 aheadMs = DEFAULT_AHEAD_MS;
+  bool fastPreview = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "a:fr:")) != -1) {
+    switch (opt) {
+      case 'a':
+        aheadMs = atoi(optarg);
+        break;
+      case 'f':
+        fastPreview = true;
+        break;
+      case 'r':
+        sAudioRate = atoi(optarg);
+        if (sAudioRate < CHIP_MIN_SAMPLE_RATE || sAudioRate > CHIP_MAX_SAMPLE_RATE) {
+          errx(1, "Sample rate must be %d-%d Hz", CHIP_MIN_SAMPLE_RATE, CHIP_MAX_SAMPLE_RATE);
+        }
+        break;
+      default:
+        errx(1, "Usage: %s [-a ahead_ms] [-f] [-r sample_rate] <chip> <filename>\n", argv[0]);
+    }
+  }
+  argc -= optind - 1;
+  argv += optind - 1;
   if (argc != 3) {
-    err(1, "Usage: %s <chip> <filename>\n", argv[0]);
+    errx(1, "Usage: %s [-a ahead_ms] [-f] [-r sample_rate] <chip> <filename>\n", argv[0]);
   }
 
   // Init messages array
@@ -592,6 +765,7 @@ int main(int argc, char *argv[]) {
     err(1, "Cannot find chip: %s", argv[1]);
   }
   tracker_setFilename(argv[2]);
+  tracker_setFastPreview(fastPreview);
   SDL_AudioSpec requested, obtained;
 
   // Initialize SDL
@@ -599,14 +773,16 @@ int main(int argc, char *argv[]) {
     err(1, "SDL could not initialize! SDL Error: %s\n", SDL_GetError());
   }
   atexit(SDL_Quit);
-  requested.freq = 44100;
+  requested.freq = sAudioRate;
   requested.format = AUDIO_S16;
-  requested.samples = 512;
+  requested.samples = AUDIO_CALLBACK_SAMPLES;
   requested.callback = audiocb;
   requested.channels = 2;
   if (SDL_OpenAudio(&requested, &obtained) < 0) {
     err(1, "SDL_OpenAudio");
   }
+  sAudioRate = obtained.freq;
+  tracker_setSampleRate(sAudioRate);
   //fprintf(stderr, "freq %d\n", obtained.freq);
   //fprintf(stderr, "format %x\n", obtained.format);
   //fprintf(stderr, "samples %d\n", obtained.samples);
@@ -642,28 +818,6 @@ int main(int argc, char *argv[]) {
     err(1, "Warning: Unable to set VSync! SDL Error: %s\n", SDL_GetError());
   }
 
-  // Allocate texture
-  sTexture = malloc(128 * 128);
-  if (!sTexture) {
-    err(1, "ERROR: Cannot allocate texture.");
-  }
-  memset(sTexture, 0, 128 * 128);
-
-  // Copy font to texture
-  {
-    for (int x = 0; x < 16; x++) {
-      for (int y = 0; y < 16; y++) {
-        for (int yy = 0; yy < 8; yy++) {
-          GLubyte row = font_data[((y * 16 + x) * 8) + yy];
-          for (int xx = 0; xx < 8; xx++) {
-            GLubyte alpha = ((row >> (7 - xx)) & 1) * 255;
-            sTexture[((y * 8 + yy) * 128) + (x * 8 + xx)] = alpha;
-          }
-        }
-      }
-    }
-  }
-
   // Scale texture matrix to pixel size
   glMatrixMode(GL_TEXTURE);
   glLoadIdentity();
@@ -673,7 +827,7 @@ int main(int argc, char *argv[]) {
   GLuint texId;
   glGenTextures(1, &texId);
   glBindTexture(GL_TEXTURE_2D, texId);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 128, 128, 0, GL_ALPHA, GL_UNSIGNED_BYTE, sTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 128, 128, 0, GL_ALPHA, GL_UNSIGNED_BYTE, tables_fontTexture);
   glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -689,6 +843,35 @@ int main(int argc, char *argv[]) {
   con_cls();
 
   tracker_init();
+
+  // Always keep at least one callback's worth ahead, or every callback would underrun
+  sAudioAhead = aheadMs * sAudioRate / 1000;
+  if (sAudioAhead < obtained.samples) {
+    sAudioAhead = obtained.samples;
+  }
+  // Wake the producer once there is room for a whole block
+  sAudioWakeLevel = sAudioAhead > PRODUCER_BLOCK ? sAudioAhead - PRODUCER_BLOCK : 0;
+  sAudioRingSize = 1;
+  while (sAudioRingSize < sAudioAhead) {
+    sAudioRingSize <<= 1;
+  }
+  sAudioRing = malloc(sAudioRingSize * sizeof(ChipSample));
+  sProducerLock = SDL_CreateMutex();
+  sProducerWake = SDL_CreateSemaphore(0);
+  if (!sAudioRing || !sProducerLock || !sProducerWake) {
+    err(1, "ERROR: Cannot allocate audio buffer.");
+  }
+  atomic_init(&sAudioWritePos, 0);
+  atomic_init(&sAudioReadPos, 0);
+  atomic_init(&sAudioUnderruns, 0);
+  atomic_init(&sAudioLowWater, UINT32_MAX);
+  atomic_init(&sAudioHighWater, 0);
+  atomic_init(&sProducerQuit, false);
+  fillAudioRing();
+  sProducerThread = SDL_CreateThread(audioProducer, "audio producer", NULL);
+  if (!sProducerThread) {
+    errx(1, "Cannot start audio thread: %s", SDL_GetError());
+  }
   SDL_PauseAudio(0);
   con_msg("READY");
 
@@ -890,6 +1073,8 @@ int main(int argc, char *argv[]) {
       } /* switch */
     }
 
+    reportAudioUnderruns();
+
     // Render tracker
     glClearColor(sPalette[0] / 255.0f, sPalette[1] / 255.0f, sPalette[2] / 255.0f, 1.0f);
     tracker_drawScreen();
@@ -1002,6 +1187,13 @@ int main(int argc, char *argv[]) {
     SDL_GL_SwapWindow(gWindow);
   }
   SDL_PauseAudio(1);
+  atomic_store(&sProducerQuit, true);
+  SDL_SemPost(sProducerWake);
+  SDL_WaitThread(sProducerThread, NULL);
+  SDL_DestroySemaphore(sProducerWake);
+  SDL_DestroyMutex(sProducerLock);
+  free(sAudioRing);
+  sAudioRing = NULL;
 
   // Free resources and close SDL
   tracker_destroy();
@@ -1009,9 +1201,6 @@ int main(int argc, char *argv[]) {
   free(sChars);
   sChars = NULL;
 
-  free(sTexture);
-  sTexture = NULL;
-
   // Destroy window
   SDL_DestroyWindow(gWindow);
   gWindow = NULL;
@@ -3,7 +3,6 @@
 #define CONSOLE_H
 
 #include "types.h"
-#include <SDL_keycode.h>
 #include "chip.h"
 
 #define STARTING_SCREEN_WIDTH (1360)
@@ -172,5 +171,20 @@ void con_pauseAudio();
  */
 void con_resumeAudio();
 
+/**
+ * Stops the producer thread from rendering while the engine is edited; playback goes on from what was rendered ahead
+ */
+void con_lockAudio();
+
+/**
+ * Lets the producer thread render again
+ */
+void con_unlockAudio();
+
+/**
+ * Number of audio callbacks that found the ring short and played silence
+ */
+u32 con_audioUnderruns();
+
 #endif // ifndef CONSOLE_H
 
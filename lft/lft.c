@@ -1,11 +1,27 @@
 
 #include "../chip.h"
 #include "../console.h"
+#include "../tables.h"
+#include "../blip_buf.h"
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <stdlib.h>
 
 #define TRACKLEN 32
+// Oscillator frequencies step the phase at the original hardware's rate
+#define PHASE_RATE 16000
+// The playroutine ran every BASE_TICK_SAMPLES samples at BASE_RATE, and the noise register shifted every
+// fourth sample. Everything is timed in clocks of 256 per BASE_RATE sample now, whatever the output rate,
+// and blip_buf converts.
+#define BASE_RATE 44100
+#define BASE_TICK_SAMPLES 496
+#define CLOCK_RATE (BASE_RATE * 256)
+#define CLOCKS_PER_TICK (BASE_TICK_SAMPLES * 256)
+#define CLOCKS_PER_NOISE (4 * 256)
+#define NOISE_PER_TICK (CLOCKS_PER_TICK / CLOCKS_PER_NOISE)
+// The fast preview model steps everything once per output sample instead, the noise at this rate
+#define NOISE_RATE (BASE_RATE / 4)
 
 enum {
   WF_TRI,
@@ -40,44 +56,10 @@ struct songline {
   u8 transp[4];
 };
 
-static struct instrument instrument[256];
-static struct track track[256];
-static struct songline song[256];
-static char sFilename[1024];
-static int songlen = 1;
-
-static volatile u16 callbackwait;
-static u16 noiseseedwait = 0;
-
-static u8 trackwait;
-static u8 trackpos;
-static u8 songpos;
-
-static u8 playsong;
-static u8 playtrack;
-
-/*static const u16 freqtable[] = {
-  0x010b, 0x011b, 0x012c, 0x013e, 0x0151, 0x0165, 0x017a, 0x0191, 0x01a9,
-  0x01c2, 0x01dd, 0x01f9, 0x0217, 0x0237, 0x0259, 0x027d, 0x02a3, 0x02cb,
-  0x02f5, 0x0322, 0x0352, 0x0385, 0x03ba, 0x03f3, 0x042f, 0x046f, 0x04b2,
-  0x04fa, 0x0546, 0x0596, 0x05eb, 0x0645, 0x06a5, 0x070a, 0x0775, 0x07e6,
-  0x085f, 0x08de, 0x0965, 0x09f4, 0x0a8c, 0x0b2c, 0x0bd6, 0x0c8b, 0x0d4a,
-  0x0e14, 0x0eea, 0x0fcd, 0x10be, 0x11bd, 0x12cb, 0x13e9, 0x1518, 0x1659,
-  0x17ad, 0x1916, 0x1a94, 0x1c28, 0x1dd5, 0x1f9b, 0x217c, 0x237a, 0x2596,
-  0x27d3, 0x2a31, 0x2cb3, 0x2f5b, 0x322c, 0x3528, 0x3851, 0x3bab, 0x3f37,
-  0x42f9, 0x46f5, 0x4b2d, 0x4fa6, 0x5462, 0x5967, 0x5eb7, 0x6459, 0x6a51,
-  0x70a3, 0x7756, 0x7e6f
-};*/
-
-static const u16 freqtable[] = {
-    0x0085, 0x008d, 0x0096, 0x009f, 0x00a8, 0x00b2, 0x00bd, 0x00c8, 0x00d4, 0x00e1, 0x00ee, 0x00fc, 0x010b,
-    0x011b, 0x012c, 0x013e, 0x0151, 0x0165, 0x017a, 0x0191, 0x01a9, 0x01c2, 0x01dd, 0x01f9, 0x0217, 0x0237,
-    0x0259, 0x027d, 0x02a3, 0x02cb, 0x02f5, 0x0322, 0x0352, 0x0385, 0x03ba, 0x03f3, 0x042f, 0x046f, 0x04b2,
-    0x04fa, 0x0546, 0x0596, 0x05eb, 0x0645, 0x06a5, 0x070a, 0x0775, 0x07e6, 0x085f, 0x08de, 0x0965, 0x09f4,
-    0x0a8c, 0x0b2c, 0x0bd6, 0x0c8b, 0x0d4a, 0x0e14, 0x0eea, 0x0fcd, 0x10be, 0x11bd, 0x12cb, 0x13e9, 0x1518,
-    0x1659, 0x17ad, 0x1916, 0x1a94, 0x1c28, 0x1dd5, 0x1f9b, 0x217c, 0x237a, 0x2596, 0x27d3, 0x2a31, 0x2cb3,
-    0x2f5b, 0x322c, 0x3528, 0x3851, 0x3bab, 0x3f37
-};
+// The original mix was left = (L + R * 0.8) * 0.8, then right = (R + left * 0.8) * 0.8, which comes to
+// these weights per voice, in 1/4096ths
+static const s32 sMixLeft[4] = {3277, 3277, 2621, 2621};
+static const s32 sMixRight[4] = {2097, 2097, 4954, 4954};
 
 static const s8 sinetable[] = {
     0, 12, 25, 37, 49, 60, 71, 81, 90, 98, 106, 112, 117, 122, 125, 126, 127, 126, 125, 122, 117, 112, 106, 98,
@@ -85,15 +67,19 @@ static const s8 sinetable[] = {
     -125, -126, -127, -126, -125, -122, -117, -112, -106, -98, -90, -81, -71, -60, -49, -37, -25, -12
 };
 
-static volatile struct oscillator {
+struct oscillator {
   s32 freq;
-  u16 phase;
+  u32 step; // phase increment per clock in 16.16 fixed point, derived from freq
+  u32 sampleStep; // phase increment per output sample in the top half, for the fast preview model
+  u32 phase; // 16.16 fixed point; the top half is the original 16 bit phase
+  s32 lastLeft; // Level last sent to the blip buffer
+  s32 lastRight;
   u16 duty;
   u8 waveform;
   u8 volume; // 0-255
-} osc[4];
+};
 
-static struct channel {
+struct channel {
   u8 tnum;
   s8 transp;
   u8 tnote;
@@ -111,155 +97,184 @@ static struct channel {
   u8 vpos;
   s16 inertia;
   u16 slur;
-} channel[4];
+};
+
+struct ChipContext {
+  u32 sampleRate;
+  u32 dryRunRemainder; // In 1/BASE_RATE samples
+  blip_stereo_t *blipBuffer;
+  // Fast preview: playroutine timing in output samples rather than clocks
+  bool fastPreview;
+  u32 tickRemainder; // Carried part of a sample, in 1/BASE_RATE units, so the tick rate stays exact
+  u16 callbackwait;
+  u32 noiseseedwait; // In 1/NOISE_RATE samples, so the noise pitch doesn't follow the output rate
+  struct instrument instrument[256];
+  struct track track[256];
+  struct songline song[256];
+  char filename[1024];
+  int songlen;
+
+  u32 noiseseed;
+
+  u8 trackwait;
+  u8 trackpos;
+  u8 songpos;
+
+  u8 playsong;
+  u8 playtrack;
+
+  struct oscillator osc[4];
+  struct channel channel[4];
+  ChipExpandState expand;
+};
 
-static void readsong(int pos, int ch, u8 *dest) {
-  dest[0] = song[pos].track[ch];
-  dest[1] = song[pos].transp[ch];
+static void readsong(ChipContext *_ctx, int pos, int ch, u8 *dest) {
+  dest[0] = _ctx->song[pos].track[ch];
+  dest[1] = _ctx->song[pos].transp[ch];
 }
 
-static void readtrack(int num, int pos, struct trackline *tl) {
-  tl->note = track[num].line[pos].note;
-  tl->instr = track[num].line[pos].instr;
-  tl->cmd[0] = track[num].line[pos].cmd[0];
-  tl->cmd[1] = track[num].line[pos].cmd[1];
-  tl->param[0] = track[num].line[pos].param[0];
-  tl->param[1] = track[num].line[pos].param[1];
+static void readtrack(ChipContext *_ctx, int num, int pos, struct trackline *tl) {
+  tl->note = _ctx->track[num].line[pos].note;
+  tl->instr = _ctx->track[num].line[pos].instr;
+  tl->cmd[0] = _ctx->track[num].line[pos].cmd[0];
+  tl->cmd[1] = _ctx->track[num].line[pos].cmd[1];
+  tl->param[0] = _ctx->track[num].line[pos].param[0];
+  tl->param[1] = _ctx->track[num].line[pos].param[1];
 }
 
-static void readinstr(int num, int pos, u8 *il) {
-  if (pos >= instrument[num].length) {
+static void readinstr(ChipContext *_ctx, int num, int pos, u8 *il) {
+  if (pos >= _ctx->instrument[num].length) {
     il[0] = 0;
     il[1] = 0;
   } else {
-    il[0] = instrument[num].line[pos].cmd;
-    il[1] = instrument[num].line[pos].param;
+    il[0] = _ctx->instrument[num].line[pos].cmd;
+    il[1] = _ctx->instrument[num].line[pos].param;
   }
 }
 
-static void silence() {
+static void silence(ChipContext *_ctx) {
   u8 i;
   for (i = 0; i < 4; i++) {
-    osc[i].volume = 0;
+    _ctx->osc[i].volume = 0;
   }
-  playsong = 0;
-  playtrack = 0;
+  _ctx->playsong = 0;
+  _ctx->playtrack = 0;
 }
 
-static void runcmd(u8 ch, u8 cmd, u8 param) {
+static void runcmd(ChipContext *_ctx, u8 ch, u8 cmd, u8 param) {
   switch (cmd) {
-    case 0:channel[ch].inum = 0;
+    case 0:_ctx->channel[ch].inum = 0;
       break;
-    case 'd':osc[ch].duty = param << 8;
+    case 'd':_ctx->osc[ch].duty = param << 8;
       break;
-    case 'f':channel[ch].volumed = param;
+    case 'f':_ctx->channel[ch].volumed = param;
       break;
-    case 'i':channel[ch].inertia = param << 1;
+    case 'i':_ctx->channel[ch].inertia = param << 1;
       break;
-    case 'j':channel[ch].iptr = param;
+    case 'j':_ctx->channel[ch].iptr = param;
       break;
-    case 'l':channel[ch].bendd = param;
+    case 'l':_ctx->channel[ch].bendd = param;
       break;
-    case 'm':channel[ch].dutyd = param << 6;
+    case 'm':_ctx->channel[ch].dutyd = param << 6;
       break;
-    case 't':channel[ch].iwait = param;
+    case 't':_ctx->channel[ch].iwait = param;
       break;
-    case 'v':osc[ch].volume = param;
+    case 'v':_ctx->osc[ch].volume = param;
       break;
-    case 'w':osc[ch].waveform = param;
+    case 'w':_ctx->osc[ch].waveform = param;
       break;
-    case '+':channel[ch].inote = param + channel[ch].tnote - 12 * 4;
+    case '+':_ctx->channel[ch].inote = param + _ctx->channel[ch].tnote - 12 * 4;
       break;
-    case '=':channel[ch].inote = param;
+    case '=':_ctx->channel[ch].inote = param;
       break;
     case '~':
-      if (channel[ch].vdepth != (param >> 4)) {
-        channel[ch].vpos = 0;
+      if (_ctx->channel[ch].vdepth != (param >> 4)) {
+        _ctx->channel[ch].vpos = 0;
       }
-      channel[ch].vdepth = param >> 4;
-      channel[ch].vrate = param & 15;
+      _ctx->channel[ch].vdepth = param >> 4;
+      _ctx->channel[ch].vrate = param & 15;
       break;
   } /* switch */
 }   /* runcmd */
 
 /*
-static void startplaytrack(int t) {
-  channel[0].tnum = t;
-  channel[1].tnum = 0;
-  channel[2].tnum = 0;
-  channel[3].tnum = 0;
-  trackpos = 0;
-  trackwait = 0;
-  playtrack = 1;
-  playsong = 0;
+static void startplaytrack(ChipContext *_ctx, int t) {
+  _ctx->channel[0].tnum = t;
+  _ctx->channel[1].tnum = 0;
+  _ctx->channel[2].tnum = 0;
+  _ctx->channel[3].tnum = 0;
+  _ctx->trackpos = 0;
+  _ctx->trackwait = 0;
+  _ctx->playtrack = 1;
+  _ctx->playsong = 0;
 }
 */
 
-static void startplaysong(int p) {
-  songpos = p;
-  trackpos = 0;
-  trackwait = 0;
-  playtrack = 0;
-  playsong = 1;
+static void startplaysong(ChipContext *_ctx, int p) {
+  _ctx->songpos = p;
+  _ctx->trackpos = 0;
+  _ctx->trackwait = 0;
+  _ctx->playtrack = 0;
+  _ctx->playsong = 1;
 }
 
-static void playroutine() { // called at 50 Hz
+static void playroutine(ChipContext *_ctx) { // called at 50 Hz
   u8 ch;
-  if (playtrack || playsong) {
-    if (trackwait) {
-      trackwait--;
+  if (_ctx->playtrack || _ctx->playsong) {
+    if (_ctx->trackwait) {
+      _ctx->trackwait--;
     } else {
-      trackwait = 4;
-      if (!trackpos) {
-        if (playsong) {
-          if (songpos >= songlen) {
-            playsong = 0;
+      _ctx->trackwait = 4;
+      if (!_ctx->trackpos) {
+        if (_ctx->playsong) {
+          if (_ctx->songpos >= _ctx->songlen) {
+            _ctx->playsong = 0;
           } else {
             for (ch = 0; ch < 4; ch++) {
               u8 tmp[2];
 
-              readsong(songpos, ch, tmp);
-              channel[ch].tnum = tmp[0];
-              channel[ch].transp = tmp[1];
+              readsong(_ctx, _ctx->songpos, ch, tmp);
+              _ctx->channel[ch].tnum = tmp[0];
+              _ctx->channel[ch].transp = tmp[1];
             }
-            songpos++;
+            _ctx->songpos++;
           }
         }
       }
-      if (playtrack || playsong) {
+      if (_ctx->playtrack || _ctx->playsong) {
         for (ch = 0; ch < 4; ch++) {
-          if (channel[ch].tnum) {
+          if (_ctx->channel[ch].tnum) {
             struct trackline tl;
             u8 instr = 0;
 
-            readtrack(channel[ch].tnum, trackpos, &tl);
+            readtrack(_ctx, _ctx->channel[ch].tnum, _ctx->trackpos, &tl);
             if (tl.note) {
-              channel[ch].tnote = tl.note + channel[ch].transp;
-              instr = channel[ch].lastinstr;
+              _ctx->channel[ch].tnote = tl.note + _ctx->channel[ch].transp;
+              instr = _ctx->channel[ch].lastinstr;
             }
             if (tl.instr) {
               instr = tl.instr;
             }
             if (instr) {
-              channel[ch].lastinstr = instr;
-              channel[ch].inum = instr;
-              channel[ch].iptr = 0;
-              channel[ch].iwait = 0;
-              channel[ch].bend = 0;
-              channel[ch].bendd = 0;
-              channel[ch].volumed = 0;
-              channel[ch].dutyd = 0;
-              channel[ch].vdepth = 0;
+              _ctx->channel[ch].lastinstr = instr;
+              _ctx->channel[ch].inum = instr;
+              _ctx->channel[ch].iptr = 0;
+              _ctx->channel[ch].iwait = 0;
+              _ctx->channel[ch].bend = 0;
+              _ctx->channel[ch].bendd = 0;
+              _ctx->channel[ch].volumed = 0;
+              _ctx->channel[ch].dutyd = 0;
+              _ctx->channel[ch].vdepth = 0;
             }
             if (tl.cmd[0]) {
-              runcmd(ch, tl.cmd[0], tl.param[0]);
+              runcmd(_ctx, ch, tl.cmd[0], tl.param[0]);
             }
             /*if(tl.cmd[1])
-              runcmd(ch, tl.cmd[1], tl.param[1]);*/
+              runcmd(_ctx, ch, tl.cmd[1], tl.param[1]);*/
           }
         }
-        trackpos++;
-        trackpos &= 31;
+        _ctx->trackpos++;
+        _ctx->trackpos &= 31;
       }
     }
   }
@@ -267,58 +282,65 @@ static void playroutine() { // called at 50 Hz
     s16 vol;
     u16 duty;
     u16 slur;
-    while (channel[ch].inum && !channel[ch].iwait) {
+    while (_ctx->channel[ch].inum && !_ctx->channel[ch].iwait) {
       u8 il[2];
 
-      readinstr(channel[ch].inum, channel[ch].iptr, il);
-      channel[ch].iptr++;
+      readinstr(_ctx, _ctx->channel[ch].inum, _ctx->channel[ch].iptr, il);
+      _ctx->channel[ch].iptr++;
 
-      runcmd(ch, il[0], il[1]);
+      runcmd(_ctx, ch, il[0], il[1]);
     }
-    if (channel[ch].iwait) {
-      channel[ch].iwait--;
+    if (_ctx->channel[ch].iwait) {
+      _ctx->channel[ch].iwait--;
     }
-    if (channel[ch].inertia) {
+    if (_ctx->channel[ch].inertia) {
       s16 diff;
 
-      slur = channel[ch].slur;
-      diff = freqtable[channel[ch].inote] - slur;
+      slur = _ctx->channel[ch].slur;
+      diff = tables_lftFreq[_ctx->channel[ch].inote] - slur;
       // diff >>= channel[ch].inertia;
       if (diff > 0) {
-        if (diff > channel[ch].inertia) {
-          diff = channel[ch].inertia;
+        if (diff > _ctx->channel[ch].inertia) {
+          diff = _ctx->channel[ch].inertia;
         }
       } else if (diff < 0) {
-        if (diff < -channel[ch].inertia) {
-          diff = -channel[ch].inertia;
+        if (diff < -_ctx->channel[ch].inertia) {
+          diff = -_ctx->channel[ch].inertia;
         }
       }
       slur += diff;
-      channel[ch].slur = slur;
+      _ctx->channel[ch].slur = slur;
     } else {
-      slur = freqtable[channel[ch].inote];
+      slur = tables_lftFreq[_ctx->channel[ch].inote];
     }
-    osc[ch].freq = slur + channel[ch].bend + ((channel[ch].vdepth * sinetable[channel[ch].vpos & 63]) >> 2);
-    channel[ch].bend += channel[ch].bendd;
-    vol = osc[ch].volume + channel[ch].volumed;
+    _ctx->osc[ch].freq = slur + _ctx->channel[ch].bend +
+                         ((_ctx->channel[ch].vdepth * sinetable[_ctx->channel[ch].vpos & 63]) >> 2);
+    if (_ctx->osc[ch].freq < 0) {
+      _ctx->osc[ch].freq = 0;
+    }
+    // freq steps the 16 bit phase at the original 16 kHz rate
+    _ctx->osc[ch].step = (u32) (((uint64_t) _ctx->osc[ch].freq * PHASE_RATE << 16) / CLOCK_RATE);
+    _ctx->osc[ch].sampleStep = (u32) (((uint64_t) _ctx->osc[ch].freq * PHASE_RATE) / _ctx->sampleRate);
+    _ctx->channel[ch].bend += _ctx->channel[ch].bendd;
+    vol = _ctx->osc[ch].volume + _ctx->channel[ch].volumed;
     if (vol < 0) {
       vol = 0;
     }
     if (vol > 255) {
       vol = 255;
     }
-    osc[ch].volume = vol;
+    _ctx->osc[ch].volume = vol;
 
-    duty = osc[ch].duty + channel[ch].dutyd;
+    duty = _ctx->osc[ch].duty + _ctx->channel[ch].dutyd;
     if (duty > 0xe000) {
       duty = 0x2000;
     }
     if (duty < 0x2000) {
       duty = 0xe000;
     }
-    osc[ch].duty = duty;
+    _ctx->osc[ch].duty = duty;
 
-    channel[ch].vpos += channel[ch].vrate;
+    _ctx->channel[ch].vpos += _ctx->channel[ch].vrate;
   }
 } /* playroutine */
 
@@ -326,76 +348,97 @@ static const char *getChipId() {
   return "LFT";
 }
 
-static ChipError init() {
-  trackwait = 0;
-  trackpos = 0;
-  playsong = 0;
-  playtrack = 0;
-
-  osc[0].volume = 0;
-  channel[0].inum = 0;
-  osc[1].volume = 0;
-  channel[1].inum = 0;
-  osc[2].volume = 0;
-  channel[2].inum = 0;
-  osc[3].volume = 0;
-  channel[3].inum = 0;
+static ChipError init(ChipContext **_ctx, u32 _sampleRate) {
+  if (_sampleRate < CHIP_MIN_SAMPLE_RATE || _sampleRate > CHIP_MAX_SAMPLE_RATE) {
+    return ERR_NOT_SUPPORTED;
+  }
+  ChipContext *ctx = calloc(1, sizeof(ChipContext));
+  if (!ctx) {
+    return ERR_OUT_OF_MEMORY;
+  }
+  // Room for two ticks
+  ctx->blipBuffer = blip_stereo_new(BASE_TICK_SAMPLES * 2 * _sampleRate / BASE_RATE + 1);
+  if (!ctx->blipBuffer) {
+    free(ctx);
+    return ERR_OUT_OF_MEMORY;
+  }
+  ctx->sampleRate = _sampleRate;
+  blip_stereo_set_rates(ctx->blipBuffer, CLOCK_RATE, _sampleRate);
+  blip_stereo_clear(ctx->blipBuffer);
+  ctx->songlen = 1;
+  ctx->noiseseed = 1;
+  ctx->trackwait = 0;
+  ctx->trackpos = 0;
+  ctx->playsong = 0;
+  ctx->playtrack = 0;
+
+  ctx->osc[0].volume = 0;
+  ctx->channel[0].inum = 0;
+  ctx->osc[1].volume = 0;
+  ctx->channel[1].inum = 0;
+  ctx->osc[2].volume = 0;
+  ctx->channel[2].inum = 0;
+  ctx->osc[3].volume = 0;
+  ctx->channel[3].inum = 0;
   for (int i = 1; i < 256; i++) {
-    instrument[i].length = 1;
-    instrument[i].line[0].cmd = '0';
-    instrument[i].line[0].param = 0;
+    ctx->instrument[i].length = 1;
+    ctx->instrument[i].line[0].cmd = '0';
+    ctx->instrument[i].line[0].param = 0;
   }
+  *_ctx = ctx;
   return NO_ERR;
 }
 
-static ChipError shutdown() {
+static ChipError shutdown(ChipContext *_ctx) {
+  blip_stereo_delete(_ctx->blipBuffer);
+  free(_ctx);
   return NO_ERR;
 }
 
-static ChipError newSong() {
+static ChipError newSong(ChipContext *_ctx) {
   return NO_ERR;
 }
 
-static ChipError loadSong(const char *_filename) {
+static ChipError loadSong(ChipContext *_ctx, const char *_filename) {
   FILE *f;
   char buf[1024];
   int cmd[3];
   int i1, i2, trk[4], transp[4], param[3], note, instr;
   int i;
 
-  snprintf(sFilename, sizeof(sFilename), "%s", _filename);
+  snprintf(_ctx->filename, sizeof(_ctx->filename), "%s", _filename);
 
   f = fopen(_filename, "r");
   if (!f) {
     return "Cannot load file.";
   }
-  songlen = 1;
+  _ctx->songlen = 1;
   while (!feof(f) && fgets(buf, sizeof(buf), f)) {
     if (9 == sscanf(buf, "songline %x %x %x %x %x %x %x %x %x", &i1, &trk[0], &transp[0], &trk[1], &transp[1],
                     &trk[2],
                     &transp[2], &trk[3], &transp[3])) {
       for (i = 0; i < 4; i++) {
-        song[i1].track[i] = trk[i];
-        song[i1].transp[i] = transp[i];
+        _ctx->song[i1].track[i] = trk[i];
+        _ctx->song[i1].transp[i] = transp[i];
       }
-      if (songlen <= i1) {
-        songlen = i1 + 1;
+      if (_ctx->songlen <= i1) {
+        _ctx->songlen = i1 + 1;
       }
     } else if (8 ==
                sscanf(buf, "trackline %x %x %x %x %x %x %x %x", &i1, &i2, &note, &instr, &cmd[0], &param[0],
                       &cmd[1],
                       &param[1])) {
-      track[i1].line[i2].note = note;
-      track[i1].line[i2].instr = instr;
+      _ctx->track[i1].line[i2].note = note;
+      _ctx->track[i1].line[i2].instr = instr;
       for (i = 0; i < 2; i++) {
-        track[i1].line[i2].cmd[i] = cmd[i];
-        track[i1].line[i2].param[i] = param[i];
+        _ctx->track[i1].line[i2].cmd[i] = cmd[i];
+        _ctx->track[i1].line[i2].param[i] = param[i];
       }
     } else if (4 == sscanf(buf, "instrumentline %x %x %x %x", &i1, &i2, &cmd[0], &param[0])) {
-      instrument[i1].line[i2].cmd = cmd[0];
-      instrument[i1].line[i2].param = param[0];
-      if (instrument[i1].length <= i2) {
-        instrument[i1].length = i2 + 1;
+      _ctx->instrument[i1].line[i2].cmd = cmd[0];
+      _ctx->instrument[i1].line[i2].param = param[0];
+      if (_ctx->instrument[i1].length <= i2) {
+        _ctx->instrument[i1].length = i2 + 1;
       }
     }
   }
@@ -403,7 +446,7 @@ static ChipError loadSong(const char *_filename) {
   return NO_ERR;
 } /* loadSong */
 
-static ChipError saveSong(const char *filename) {
+static ChipError saveSong(ChipContext *_ctx, const char *filename) {
   FILE *f;
   int i, j;
 
@@ -414,15 +457,15 @@ static ChipError saveSong(const char *filename) {
   fprintf(f, "musicchip tune\n");
   fprintf(f, "version 1\n");
   fprintf(f, "\n");
-  for (i = 0; i < songlen; i++) {
-    fprintf(f, "songline %02x %02x %02x %02x %02x %02x %02x %02x %02x\n", i, song[i].track[0],
-            song[i].transp[0], song[i].track[1], song[i].transp[1], song[i].track[2], song[i].transp[2],
-            song[i].track[3], song[i].transp[3]);
+  for (i = 0; i < _ctx->songlen; i++) {
+    fprintf(f, "songline %02x %02x %02x %02x %02x %02x %02x %02x %02x\n", i, _ctx->song[i].track[0],
+            _ctx->song[i].transp[0], _ctx->song[i].track[1], _ctx->song[i].transp[1], _ctx->song[i].track[2],
+            _ctx->song[i].transp[2], _ctx->song[i].track[3], _ctx->song[i].transp[3]);
   }
   fprintf(f, "\n");
   for (i = 1; i < 256; i++) {
     for (j = 0; j < TRACKLEN; j++) {
-      struct trackline *tl = &track[i].line[j];
+      struct trackline *tl = &_ctx->track[i].line[j];
       if (tl->note || tl->instr || tl->cmd[0] || tl->cmd[1]) {
         fprintf(f, "trackline %02x %02x %02x %02x %02x %02x %02x %02x\n", i, j, tl->note, tl->instr,
                 tl->cmd[0], tl->param[0], tl->cmd[1], tl->param[1]);
@@ -431,10 +474,10 @@ static ChipError saveSong(const char *filename) {
   }
   fprintf(f, "\n");
   for (i = 1; i < 256; i++) {
-    if (instrument[i].length > 1) {
-      for (j = 0; j < instrument[i].length; j++) {
-        fprintf(f, "instrumentline %02x %02x %02x %02x\n", i, j, instrument[i].line[j].cmd,
-                instrument[i].line[j].param);
+    if (_ctx->instrument[i].length > 1) {
+      for (j = 0; j < _ctx->instrument[i].length; j++) {
+        fprintf(f, "instrumentline %02x %02x %02x %02x\n", i, j, _ctx->instrument[i].line[j].cmd,
+                _ctx->instrument[i].line[j].param);
       }
     }
   }
@@ -442,61 +485,61 @@ static ChipError saveSong(const char *filename) {
   return NO_ERR;
 }
 
-static ChipError insertSongRow(u8 _channelNum, u8 _atSongRow) {
-  if (songlen < 256) {
-    memmove(&song[_atSongRow + 1],
-            &song[_atSongRow + 0],
-            sizeof(struct songline) * (songlen - _atSongRow));
-    songlen++;
-    memset(&song[_atSongRow], 0, sizeof(struct songline));
+static ChipError insertSongRow(ChipContext *_ctx, u8 _channelNum, u8 _atSongRow) {
+  if (_ctx->songlen < 256) {
+    memmove(&_ctx->song[_atSongRow + 1],
+            &_ctx->song[_atSongRow + 0],
+            sizeof(struct songline) * (_ctx->songlen - _atSongRow));
+    _ctx->songlen++;
+    memset(&_ctx->song[_atSongRow], 0, sizeof(struct songline));
     return NO_ERR;
   } else {
     return "Song is full.";
   }
 }
 
-static ChipError addSongRow() {
-  if (songlen < 256) {
-    memset(&song[songlen], 0, sizeof(struct songline));
-    songlen++;
+static ChipError addSongRow(ChipContext *_ctx) {
+  if (_ctx->songlen < 256) {
+    memset(&_ctx->song[_ctx->songlen], 0, sizeof(struct songline));
+    _ctx->songlen++;
     return NO_ERR;
   } else {
     return "Song is full.";
   }
 }
 
-static ChipError deleteSongRow(u8 _channelNum, u8 _songRow) {
-  if (songlen > 1) {
-    memmove(&song[_songRow + 0],
-            &song[_songRow + 1],
-            sizeof(struct songline) * (songlen - _songRow - 1));
-    songlen--;
+static ChipError deleteSongRow(ChipContext *_ctx, u8 _channelNum, u8 _songRow) {
+  if (_ctx->songlen > 1) {
+    memmove(&_ctx->song[_songRow + 0],
+            &_ctx->song[_songRow + 1],
+            sizeof(struct songline) * (_ctx->songlen - _songRow - 1));
+    _ctx->songlen--;
   }
   return NO_ERR;
 }
 
-static ChipError insertPatternRow(u8 _channelNum, u8 _patternNum, u8 _atPatternRow) {
-  memmove(&(track[_patternNum].line[_atPatternRow + 1]),
-          &(track[_patternNum].line[_atPatternRow + 0]),
+static ChipError insertPatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _atPatternRow) {
+  memmove(&(_ctx->track[_patternNum].line[_atPatternRow + 1]),
+          &(_ctx->track[_patternNum].line[_atPatternRow + 0]),
           sizeof(struct trackline) * (TRACKLEN - _atPatternRow));
-  memset(&(track[_patternNum].line[_atPatternRow]), 0, sizeof(struct trackline));
+  memset(&(_ctx->track[_patternNum].line[_atPatternRow]), 0, sizeof(struct trackline));
   return NO_ERR;
 }
 
-static ChipError addPatternRow(u8 _channelNum, u8 _patternNum) {
+static ChipError addPatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum) {
   return NO_ERR;
 }
 
-static ChipError deletePatternRow(u8 _channelNum, u8 _patternNum, u8 _patternRow) {
-  memmove(&(track[_patternNum].line[_patternRow + 0]),
-          &(track[_patternNum].line[_patternRow + 1]),
+static ChipError deletePatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow) {
+  memmove(&(_ctx->track[_patternNum].line[_patternRow + 0]),
+          &(_ctx->track[_patternNum].line[_patternRow + 1]),
           sizeof(struct trackline) * (TRACKLEN - _patternRow - 1));
-  memset(&(track[_patternNum].line[TRACKLEN - 1]), 0, sizeof(struct trackline));
+  memset(&(_ctx->track[_patternNum].line[TRACKLEN - 1]), 0, sizeof(struct trackline));
   return NO_ERR;
 }
 
-static ChipError insertInstrumentRow(u8 _instrument, u8 _atInstrumentRow) {
-  struct instrument *in = &instrument[_instrument];
+static ChipError insertInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _atInstrumentRow) {
+  struct instrument *in = &_ctx->instrument[_instrument];
   if (in->length < 256) {
     memmove(&in->line[_atInstrumentRow + 1],
             &in->line[_atInstrumentRow + 0],
@@ -510,8 +553,8 @@ static ChipError insertInstrumentRow(u8 _instrument, u8 _atInstrumentRow) {
   }
 }
 
-static ChipError addInstrumentRow(u8 _instrument) {
-  struct instrument *in = &instrument[_instrument];
+static ChipError addInstrumentRow(ChipContext *_ctx, u8 _instrument) {
+  struct instrument *in = &_ctx->instrument[_instrument];
   if (in->length < 256) {
     in->line[in->length].cmd = '0';
     in->line[in->length].param = 0;
@@ -522,8 +565,8 @@ static ChipError addInstrumentRow(u8 _instrument) {
   }
 }
 
-static ChipError deleteInstrumentRow(u8 _instrument, u8 _instrumentRow) {
-  struct instrument *in = &instrument[_instrument];
+static ChipError deleteInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow) {
+  struct instrument *in = &_ctx->instrument[_instrument];
   if (in->length > 1) {
     memmove(&in->line[_instrumentRow + 0],
             &in->line[_instrumentRow + 1],
@@ -533,91 +576,91 @@ static ChipError deleteInstrumentRow(u8 _instrument, u8 _instrumentRow) {
   return NO_ERR;
 }
 
-static ChipError insertTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
+static ChipError insertTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
 
-static ChipError addTableColumn(u8 _tableKind, u8 _table) { return NO_ERR; }
+static ChipError addTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table) { return NO_ERR; }
 
-static ChipError deleteTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
+static ChipError deleteTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn) { return NO_ERR; }
 
-static u8 getNumMetaData() {
+static u8 getNumMetaData(ChipContext *_ctx) {
   return 0;
 }
 
-static ChipMetaDataEntry *getMetaData(u8 _index) {
+static ChipMetaDataEntry *getMetaData(ChipContext *_ctx, u8 _index) {
   return NULL;
 }
 
-static ChipError setMetaData(u8 _index, ChipMetaDataEntry *entry) {
+static ChipError setMetaData(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry) {
   return NO_ERR;
 }
 
-static u8 getNumSaveOptions() {
+static u8 getNumSaveOptions(ChipContext *_ctx) {
   return 0;
 }
 
-static ChipMetaDataEntry *getSaveOptions(u8 _index) {
+static ChipMetaDataEntry *getSaveOptions(ChipContext *_ctx, u8 _index) {
   return NULL;
 }
 
-static ChipError setSaveOptions(u8 _index, ChipMetaDataEntry *entry) {
+static ChipError setSaveOptions(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry) {
   return NO_ERR;
 }
 
-static u16 getNumSongRows() {
-  return songlen;
+static u16 getNumSongRows(ChipContext *_ctx) {
+  return _ctx->songlen;
 }
 
-static u8 getNumSongDataColumns(u8 _channelNum) {
+static u8 getNumSongDataColumns(ChipContext *_ctx, u8 _channelNum) {
   return 5;
 }
 
-static ChipDataType getSongDataType(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static ChipDataType getSongDataType(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   if (_songDataColumn == 2) {
     return CDT_LABEL;
   }
   return CDT_HEX;
 }
 
-static u8 getSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static u8 getSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
-    case 0:return GETHI(song[_songRow].track[_channelNum]);
-    case 1:return GETLO(song[_songRow].track[_channelNum]);
+    case 0:return GETHI(_ctx->song[_songRow].track[_channelNum]);
+    case 1:return GETLO(_ctx->song[_songRow].track[_channelNum]);
     case 2:return ':';
-    case 3:return GETHI(song[_songRow].transp[_channelNum]);
-    case 4:return GETLO(song[_songRow].transp[_channelNum]);
+    case 3:return GETHI(_ctx->song[_songRow].transp[_channelNum]);
+    case 4:return GETLO(_ctx->song[_songRow].transp[_channelNum]);
   }
   return 0;
 }
 
-static u8 clearSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static u8 clearSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
-    case 0:return SETHI(song[_songRow].track[_channelNum], 0);
-    case 1:return SETLO(song[_songRow].track[_channelNum], 0);
-    case 3:return SETHI(song[_songRow].transp[_channelNum], 0);
-    case 4:return SETLO(song[_songRow].transp[_channelNum], 0);
+    case 0:return SETHI(_ctx->song[_songRow].track[_channelNum], 0);
+    case 1:return SETLO(_ctx->song[_songRow].track[_channelNum], 0);
+    case 3:return SETHI(_ctx->song[_songRow].transp[_channelNum], 0);
+    case 4:return SETLO(_ctx->song[_songRow].transp[_channelNum], 0);
   }
   return 0;
 }
 
-static u8 setSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data) {
+static u8 setSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data) {
   switch (_songDataColumn) {
-    case 0:return SETHI(song[_songRow].track[_channelNum], _data);
-    case 1:return SETLO(song[_songRow].track[_channelNum], _data);
-    case 3:return SETHI(song[_songRow].transp[_channelNum], _data);
-    case 4:return SETLO(song[_songRow].transp[_channelNum], _data);
+    case 0:return SETHI(_ctx->song[_songRow].track[_channelNum], _data);
+    case 1:return SETLO(_ctx->song[_songRow].track[_channelNum], _data);
+    case 3:return SETHI(_ctx->song[_songRow].transp[_channelNum], _data);
+    case 4:return SETLO(_ctx->song[_songRow].transp[_channelNum], _data);
   }
   return _data;
 }
 
-static void setSongPattern(u8 _songRow, u8 _channelNum, u8 _pattern) {
-  song[_songRow].track[_channelNum] = _pattern;
+static void setSongPattern(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _pattern) {
+  _ctx->song[_songRow].track[_channelNum] = _pattern;
 }
 
-static u8 getNumChannels() {
+static u8 getNumChannels(ChipContext *_ctx) {
   return 4;
 }
 
-static const char *getChannelName(u8 _patternNum, u8 _width) {
+static const char *getChannelName(ChipContext *_ctx, u8 _patternNum, u8 _width) {
   static char buf[256];
   if (_width == 0) {
     _width = 255;
@@ -627,23 +670,24 @@ static const char *getChannelName(u8 _patternNum, u8 _width) {
   return (const char *) buf;
 }
 
-static u16 getNumPatterns() {
+static u16 getNumPatterns(ChipContext *_ctx) {
   return 256;
 }
 
-static u8 getPatternNum(u8 _songRow, u8 _channelNum) {
-  return song[_songRow].track[_channelNum];
+static u8 getPatternNum(ChipContext *_ctx, u8 _songRow, u8 _channelNum) {
+  return _ctx->song[_songRow].track[_channelNum];
 }
 
-static u8 getPatternLen(u8 _patternNum) {
+static u8 getPatternLen(ChipContext *_ctx, u8 _patternNum) {
   return TRACKLEN;
 }
 
-static u8 getNumPatternDataColumns(u8 _channelNum, u8 _patternNum, u8 _patternRow) {
+static u8 getNumPatternDataColumns(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow) {
   return 12;
 }
 
-static ChipDataType getPatternDataType(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static ChipDataType getPatternDataType(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow,
+                                       u8 _patternColumn) {
   switch (_patternColumn) {
     // Note
     case 0:return CDT_NOTE;
@@ -670,18 +714,18 @@ static ChipDataType getPatternDataType(u8 _channelNum, u8 _patternNum, u8 _patte
   }
 }
 
-static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static u8 getPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
   switch (_patternColumn) {
     // Note
-    case 0:return track[_patternNum].line[_patternRow].note;
+    case 0:return _ctx->track[_patternNum].line[_patternRow].note;
 
       // Instrument
-    case 2:return GETHI(track[_patternNum].line[_patternRow].instr);
-    case 3:return GETLO(track[_patternNum].line[_patternRow].instr);
+    case 2:return GETHI(_ctx->track[_patternNum].line[_patternRow].instr);
+    case 3:return GETLO(_ctx->track[_patternNum].line[_patternRow].instr);
 
       // Command 1
     case 5: {
-      int cmd = track[_patternNum].line[_patternRow].cmd[0];
+      int cmd = _ctx->track[_patternNum].line[_patternRow].cmd[0];
       if (cmd == 0) {
         return '.';
       }
@@ -690,19 +734,19 @@ static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _pat
 
       // Param
     case 6:
-      if (track[_patternNum].line[_patternRow].cmd[0] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[0] == 0) {
         return '.';
       }
-      return GETHI(track[_patternNum].line[_patternRow].param[0]);
+      return GETHI(_ctx->track[_patternNum].line[_patternRow].param[0]);
     case 7:
-      if (track[_patternNum].line[_patternRow].cmd[0] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[0] == 0) {
         return '.';
       }
-      return GETLO(track[_patternNum].line[_patternRow].param[0]);
+      return GETLO(_ctx->track[_patternNum].line[_patternRow].param[0]);
 
       // Command 1
     case 9: {
-      int cmd = track[_patternNum].line[_patternRow].cmd[1];
+      int cmd = _ctx->track[_patternNum].line[_patternRow].cmd[1];
       if (cmd == 0) {
         return '.';
       }
@@ -711,98 +755,99 @@ static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _pat
 
       // Param
     case 10:
-      if (track[_patternNum].line[_patternRow].cmd[1] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[1] == 0) {
         return '.';
       }
-      return GETHI(track[_patternNum].line[_patternRow].param[1]);
+      return GETHI(_ctx->track[_patternNum].line[_patternRow].param[1]);
     case 11:
-      if (track[_patternNum].line[_patternRow].cmd[1] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[1] == 0) {
         return '.';
       }
-      return GETLO(track[_patternNum].line[_patternRow].param[1]);
+      return GETLO(_ctx->track[_patternNum].line[_patternRow].param[1]);
 
     default:return ' ';
   } /* switch */
 }   /* getPatternData */
 
-static u8 clearPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static u8 clearPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
   u8 ret;
   switch (_patternColumn) {
     // Note
-    case 0:SETHI(track[_patternNum].line[_patternRow].instr, 0);
-      SETLO(track[_patternNum].line[_patternRow].instr, 0);
-      return track[_patternNum].line[_patternRow].note = 0;
+    case 0:SETHI(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      SETLO(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      return _ctx->track[_patternNum].line[_patternRow].note = 0;
 
       // Instrument
-    case 2:ret = SETHI(track[_patternNum].line[_patternRow].instr, 0);
-      if (track[_patternNum].line[_patternRow].instr == 0) {
-        track[_patternNum].line[_patternRow].note = 0;
+    case 2:ret = SETHI(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      if (_ctx->track[_patternNum].line[_patternRow].instr == 0) {
+        _ctx->track[_patternNum].line[_patternRow].note = 0;
       }
       return ret;
-    case 3:ret = SETLO(track[_patternNum].line[_patternRow].instr, 0);
-      if (track[_patternNum].line[_patternRow].instr == 0) {
-        track[_patternNum].line[_patternRow].note = 0;
+    case 3:ret = SETLO(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      if (_ctx->track[_patternNum].line[_patternRow].instr == 0) {
+        _ctx->track[_patternNum].line[_patternRow].note = 0;
       }
       return ret;
 
       // Command 1
-    case 5:track[_patternNum].line[_patternRow].param[0] = 0;
-      return track[_patternNum].line[_patternRow].cmd[0] = 0;
+    case 5:_ctx->track[_patternNum].line[_patternRow].param[0] = 0;
+      return _ctx->track[_patternNum].line[_patternRow].cmd[0] = 0;
 
       // Param
-    case 6:return SETHI(track[_patternNum].line[_patternRow].param[0], 0);
-    case 7:return SETLO(track[_patternNum].line[_patternRow].param[0], 0);
+    case 6:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[0], 0);
+    case 7:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[0], 0);
 
       // Command 1
-    case 9:track[_patternNum].line[_patternRow].param[1] = 0;
-      return track[_patternNum].line[_patternRow].cmd[1] = 0;
+    case 9:_ctx->track[_patternNum].line[_patternRow].param[1] = 0;
+      return _ctx->track[_patternNum].line[_patternRow].cmd[1] = 0;
 
       // Param
-    case 10:return SETHI(track[_patternNum].line[_patternRow].param[1], 0);
-    case 11:return SETLO(track[_patternNum].line[_patternRow].param[1], 0);
+    case 10:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[1], 0);
+    case 11:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[1], 0);
 
     default:return ' ';
   } /* switch */
 }   /* getPatternData */
 
-static u8 setPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn, u8 _instrument,
+static u8 setPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn,
+                         u8 _instrument,
                          u8 _data) {
   switch (_patternColumn) {
     // Note
-    case 0:track[_patternNum].line[_patternRow].instr = _instrument;
-      return track[_patternNum].line[_patternRow].note = _data + 1;
+    case 0:_ctx->track[_patternNum].line[_patternRow].instr = _instrument;
+      return _ctx->track[_patternNum].line[_patternRow].note = _data + 1;
 
       // Instrument
-    case 2:return SETHI(track[_patternNum].line[_patternRow].instr, _data);
-    case 3:return SETLO(track[_patternNum].line[_patternRow].instr, _data);
+    case 2:return SETHI(_ctx->track[_patternNum].line[_patternRow].instr, _data);
+    case 3:return SETLO(_ctx->track[_patternNum].line[_patternRow].instr, _data);
 
       // Command 1
-    case 5:return track[_patternNum].line[_patternRow].cmd[0] = _data;
+    case 5:return _ctx->track[_patternNum].line[_patternRow].cmd[0] = _data;
 
       // Param
-    case 6:return SETHI(track[_patternNum].line[_patternRow].param[0], _data);
-    case 7:return SETLO(track[_patternNum].line[_patternRow].param[0], _data);
+    case 6:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[0], _data);
+    case 7:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[0], _data);
 
       // Command 1
-    case 9:return track[_patternNum].line[_patternRow].cmd[1] = _data;
+    case 9:return _ctx->track[_patternNum].line[_patternRow].cmd[1] = _data;
 
       // Param
-    case 10:return SETHI(track[_patternNum].line[_patternRow].param[1], _data);
-    case 11:return SETLO(track[_patternNum].line[_patternRow].param[1], _data);
+    case 10:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[1], _data);
+    case 11:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[1], _data);
 
     default:return ' ';
   }
 }
 
-static u8 getMinOctave() {
+static u8 getMinOctave(ChipContext *_ctx) {
   return 0;
 }
 
-static u8 getMaxOctave() {
+static u8 getMaxOctave(ChipContext *_ctx) {
   return 7;
 }
 
-static const char *getInstrumentName(u8 _instrument, u8 _stringWidth) {
+static const char *getInstrumentName(ChipContext *_ctx, u8 _instrument, u8 _stringWidth) {
   static char buf[256];
   if (_stringWidth == 0) {
     _stringWidth = 255;
@@ -812,25 +857,25 @@ static const char *getInstrumentName(u8 _instrument, u8 _stringWidth) {
   return (const char *) buf;
 }
 
-static void setInstrumentName(u8 _instrument, char *_instrName) {}
+static void setInstrumentName(ChipContext *_ctx, u8 _instrument, char *_instrName) {}
 
-static u8 instrumentNameLength(u8 _instrument) {
+static u8 instrumentNameLength(ChipContext *_ctx, u8 _instrument) {
   return 0;
 }
 
-static u16 getNumInstruments() {
+static u16 getNumInstruments(ChipContext *_ctx) {
   return 256;
 }
 
-static u8 getInstrumentLen(u8 _instrument) {
-  return instrument[_instrument].length;
+static u8 getInstrumentLen(ChipContext *_ctx, u8 _instrument) {
+  return _ctx->instrument[_instrument].length;
 }
 
-static u8 getNumInstrumentParams(u8 _instrument) {
+static u8 getNumInstrumentParams(ChipContext *_ctx, u8 _instrument) {
   return 1;
 }
 
-static const char *getInstrumentParamName(u8 _instrument, u8 _instrumentParam, u8 _stringWidth) {
+static const char *getInstrumentParamName(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _stringWidth) {
   static char buf[256];
   if (_stringWidth == 0) {
     _stringWidth = 255;
@@ -840,52 +885,55 @@ static const char *getInstrumentParamName(u8 _instrument, u8 _instrumentParam, u
   return (const char *) buf;
 }
 
-static u8 getNumInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow) {
-  u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+static u8 getNumInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow) {
+  u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
   if (cmd == '+' || cmd == '=') {
     return 2;
   }
   return 3;
 }
 
-static const char *getInstrumentLabel(u8 _instrument, u8 _instrumentRow) {
+static const char *getInstrumentLabel(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow) {
   static char buf[3];
   snprintf(buf, 3, "%02X", _instrumentRow);
   return buf;
 }
 
-static ChipDataType getInstrumentDataType(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+static ChipDataType getInstrumentDataType(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
                                           u8 _instrumentColumn) {
   if (_instrumentColumn == 0) {
     return CDT_ASCII;
   }
-  u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+  u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
   if (cmd == '+' || cmd == '=') {
     return CDT_NOTE;
   }
   return CDT_HEX;
 }
 
-static u8 getInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
-  u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+static u8 getInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                            u8 _instrumentColumn) {
+  u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
   if (_instrumentColumn == 0) {
     return toupper(cmd);
   }
   if (cmd == '+' || cmd == '=') {
-    return instrument[_instrument].line[_instrumentRow].param;
+    return _ctx->instrument[_instrument].line[_instrumentRow].param;
   }
   if (_instrumentColumn == 1) {
-    return GETHI(instrument[_instrument].line[_instrumentRow].param);
+    return GETHI(_ctx->instrument[_instrument].line[_instrumentRow].param);
   }
-  return GETLO(instrument[_instrument].line[_instrumentRow].param);
+  return GETLO(_ctx->instrument[_instrument].line[_instrumentRow].param);
 }
 
-static const char *getInstrumentHelp(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
+static const char *getInstrumentHelp(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                                     u8 _instrumentColumn) {
   return ""; // TODO: Implement
 }
 
-static u8 clearInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
-  u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+static u8 clearInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                              u8 _instrumentColumn) {
+  u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
   if (_instrumentColumn == 0) {
     return 0;
   }
@@ -900,196 +948,412 @@ static u8 clearInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumen
 
 static char *validcmds = "0dfijlmtvw~+=";
 
-static bool setInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn,
+static bool setInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                              u8 _instrumentColumn,
                               u8 _data) {
-  u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+  u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
   if (_instrumentColumn == 0) {
     u8 ascii = _data;
     if (ascii >= 'A' && ascii <= 'Z') {
       ascii = tolower(_data);
     }
     if (strchr(validcmds, ascii) != 0) {
-      instrument[_instrument].line[_instrumentRow].cmd = tolower(_data);
+      _ctx->instrument[_instrument].line[_instrumentRow].cmd = tolower(_data);
       return true;
     } else {
       return false;
     }
   } else {
     if (cmd == '+' || cmd == '=') {
-      instrument[_instrument].line[_instrumentRow].param = _data + 1;
+      _ctx->instrument[_instrument].line[_instrumentRow].param = _data + 1;
       return true;
     } else {
       if (_instrumentColumn == 1) {
-        SETHI(instrument[_instrument].line[_instrumentRow].param, _data);
+        SETHI(_ctx->instrument[_instrument].line[_instrumentRow].param, _data);
       } else {
-        SETLO(instrument[_instrument].line[_instrumentRow].param, _data);
+        SETLO(_ctx->instrument[_instrument].line[_instrumentRow].param, _data);
       }
     }
   }
   return true;
 }
 
-static void swapInstrumentRow(u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2) {
-  struct instrline temp = instrument[_instrument].line[_instrumentRow1];
-  instrument[_instrument].line[_instrumentRow1] = instrument[_instrument].line[_instrumentRow2];
-  instrument[_instrument].line[_instrumentRow2] = temp;
+static void swapInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2) {
+  struct instrline temp = _ctx->instrument[_instrument].line[_instrumentRow1];
+  _ctx->instrument[_instrument].line[_instrumentRow1] = _ctx->instrument[_instrument].line[_instrumentRow2];
+  _ctx->instrument[_instrument].line[_instrumentRow2] = temp;
 }
 
 // Tables
-static bool useTables() { return false; }
+static bool useTables(ChipContext *_ctx) { return false; }
 
-static u8 getNumTableKinds() { return 0; }
+static u8 getNumTableKinds(ChipContext *_ctx) { return 0; }
 
-static const char *getTableKindName(u8 _tableKind) { return ""; }
+static const char *getTableKindName(ChipContext *_ctx, u8 _tableKind) { return ""; }
 
-static u16 getMinTable(u8 _tableKind) { return 0; }
+static u16 getMinTable(ChipContext *_ctx, u8 _tableKind) { return 0; }
 
-static u16 getNumTables(u8 _tableKind) { return 0; }
+static u16 getNumTables(ChipContext *_ctx, u8 _tableKind) { return 0; }
 
-static ChipTableStyle getTableStyle(u8 _tableKind) { return CTS_BOTTOM; }
+static ChipTableStyle getTableStyle(ChipContext *_ctx, u8 _tableKind) { return CTS_BOTTOM; }
 
-static u8 getTableDataLen(u8 _tableKind, u16 _table) { return 0; }
+static u8 getTableDataLen(ChipContext *_ctx, u8 _tableKind, u16 _table) { return 0; }
 
-static u8 getTableData(u8 _tableKind, u16 _table, u8 _tableColumn) { return 0; }
+static u8 getTableData(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn) { return 0; }
 
-static u8 setTableData(u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data) { return 0; }
+static u8 setTableData(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data) { return 0; }
 
-static u8 getPlayerSongRow(u8 _channel) {
-  if (songpos == 0) {
+static u8 getPlayerSongRow(ChipContext *_ctx, u8 _channel) {
+  if (_ctx->songpos == 0) {
     return 0;
   }
-  return songpos - 1;
+  return _ctx->songpos - 1;
 }
 
-static u8 getPlayerPatternRow(u8 _channel) {
-  return trackpos;
+static u8 getPlayerPatternRow(ChipContext *_ctx, u8 _channel) {
+  return _ctx->trackpos;
 }
 
-static u8 getPlayerPattern(u8 _channelNum) {
+static u8 getPlayerPattern(ChipContext *_ctx, u8 _channelNum) {
   return 0; // TODO: Implement
 }
 
-static u8 getPlayerInstrumentRow(u8 _channelNum) {
+static u8 getPlayerInstrumentRow(ChipContext *_ctx, u8 _channelNum) {
   return 0; // TODO: Implement
 }
 
-static u8 getPlayerInstrument(u8 _channelNum) {
+static u8 getPlayerInstrument(ChipContext *_ctx, u8 _channelNum) {
   return 0; // TODO: Implement
 }
 
-static void plonk(u8 _note, u8 _channelNum, u8 _instrument, bool _isDown) {
-  channel[_channelNum].tnote = _note + 1;
-  channel[_channelNum].inum = _instrument;
-  channel[_channelNum].iptr = 0;
-  channel[_channelNum].iwait = 0;
-  channel[_channelNum].bend = 0;
-  channel[_channelNum].bendd = 0;
-  channel[_channelNum].volumed = 0;
-  channel[_channelNum].dutyd = 0;
-  channel[_channelNum].vdepth = 0;
+static void plonk(ChipContext *_ctx, u8 _note, u8 _channelNum, u8 _instrument, bool _isDown) {
+  _ctx->channel[_channelNum].tnote = _note + 1;
+  _ctx->channel[_channelNum].inum = _instrument;
+  _ctx->channel[_channelNum].iptr = 0;
+  _ctx->channel[_channelNum].iwait = 0;
+  _ctx->channel[_channelNum].bend = 0;
+  _ctx->channel[_channelNum].bendd = 0;
+  _ctx->channel[_channelNum].volumed = 0;
+  _ctx->channel[_channelNum].dutyd = 0;
+  _ctx->channel[_channelNum].vdepth = 0;
 }
 
-static void playSongFrom(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
-  startplaysong(_songRow);
+static void playSongFrom(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
+  startplaysong(_ctx, _songRow);
 }
 
-static void playPatternFrom(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {}
+static void playPatternFrom(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {}
 
-static bool isPlaying() {
-  return playsong != 0;
+static bool isPlaying(ChipContext *_ctx) {
+  return _ctx->playsong != 0;
 }
 
-static void stop() {
-  silence();
+static u32 getLoopCount(ChipContext *_ctx) {
+  // Songs stop at their last row, they never loop
+  return 0;
 }
 
-static ChipSample getSample() {
-  u8 i;
-  ChipSample acc;
-  static u32 noiseseed = 1;
-  u8 newbit;
-  if (noiseseedwait) {
-    noiseseedwait--;
-  } else {
-    newbit = 0;
-    if (noiseseed & 0x80000000L) {
-      newbit ^= 1;
-    }
-    if (noiseseed & 0x01000000L) {
-      newbit ^= 1;
-    }
-    if (noiseseed & 0x00000040L) {
-      newbit ^= 1;
+static void stop(ChipContext *_ctx) {
+  silence(_ctx);
+}
+
+static void stepNoise(ChipContext *_ctx) {
+  u8 newbit = 0;
+  if (_ctx->noiseseed & 0x80000000L) {
+    newbit ^= 1;
+  }
+  if (_ctx->noiseseed & 0x01000000L) {
+    newbit ^= 1;
+  }
+  if (_ctx->noiseseed & 0x00000040L) {
+    newbit ^= 1;
+  }
+  if (_ctx->noiseseed & 0x00000200L) {
+    newbit ^= 1;
+  }
+  _ctx->noiseseed = (_ctx->noiseseed << 1) | newbit;
+}
+
+/**
+ * Output of a tone voice, [-32,31]
+ * @param _phase Phase in 16.16 fixed point
+ */
+static s8 voiceValue(const struct oscillator *_osc, u32 _phase) {
+  const u16 phase = _phase >> 16;
+  switch (_osc->waveform) {
+    case WF_TRI:
+      if (phase < 0x8000) {
+        return -32 + (phase >> 9);
+      }
+      return 31 - ((phase - 0x8000) >> 9);
+    case WF_SAW:return -32 + (phase >> 10);
+    case WF_PUL:return (phase > _osc->duty) ? -32 : 31;
+    default:return 0;
+  }
+}
+
+/**
+ * Phase at which a tone voice's output next changes, 1 << 32 being the wrap
+ */
+static uint64_t nextEdge(const struct oscillator *_osc, u32 _phase) {
+  switch (_osc->waveform) {
+    case WF_TRI:return ((uint64_t) _phase | 0x1ffffff) + 1;
+    case WF_SAW:return ((uint64_t) _phase | 0x3ffffff) + 1;
+    default: {
+      const uint64_t duty = ((uint64_t) _osc->duty + 1) << 16;
+      return _phase < duty ? duty : (uint64_t) 1 << 32;
     }
-    if (noiseseed & 0x00000200L) {
-      newbit ^= 1;
+  }
+}
+
+/**
+ * Sends a voice's new level to the blip buffer as a delta, if it changed
+ */
+static inline void addLevel(ChipContext *_ctx, struct oscillator *_osc, s32 _left, s32 _right, u32 _time) {
+  if (_osc->lastLeft != _left || _osc->lastRight != _right) {
+    blip_stereo_add_delta(_ctx->blipBuffer, _time, _left - _osc->lastLeft, _right - _osc->lastRight);
+    _osc->lastLeft = _left;
+    _osc->lastRight = _right;
+  }
+}
+
+/**
+ * Runs the playroutine and adds one tick of output changes to the blip buffer, each at the clock it happens on
+ */
+static void fillBlips(ChipContext *_ctx) {
+  playroutine(_ctx);
+  // Noise only moves on its own clock, so the tick's noise values are shared by all noise voices
+  s8 noise[NOISE_PER_TICK];
+  for (int n = 0; n < NOISE_PER_TICK; n++) {
+    stepNoise(_ctx);
+    noise[n] = (_ctx->noiseseed & 63) - 32;
+  }
+  for (int i = 0; i < 4; i++) {
+    struct oscillator *osc = &_ctx->osc[i];
+    const s32 volumeLeft = osc->volume * sMixLeft[i];
+    const s32 volumeRight = osc->volume * sMixRight[i];
+    if (osc->waveform == WF_NOI) {
+      for (int n = 0; n < NOISE_PER_TICK; n++) {
+        addLevel(_ctx, osc, (noise[n] * volumeLeft) >> 12, (noise[n] * volumeRight) >> 12, n * CLOCKS_PER_NOISE);
+      }
+    } else {
+      // Every change of output at its own time; a silent voice has none
+      const bool moving = osc->step != 0 && osc->waveform <= WF_PUL && osc->volume != 0;
+      u32 phase = osc->phase;
+      u32 t = 0;
+      for (;;) {
+        const s8 value = voiceValue(osc, phase);
+        addLevel(_ctx, osc, (value * volumeLeft) >> 12, (value * volumeRight) >> 12, t);
+        if (!moving) {
+          break;
+        }
+        const uint64_t clocks = (nextEdge(osc, phase) - phase + osc->step - 1) / osc->step;
+        if (t + clocks >= CLOCKS_PER_TICK) {
+          break;
+        }
+        t += clocks;
+        phase += clocks * osc->step;
+      }
     }
-    noiseseed = (noiseseed << 1) | newbit;
-    noiseseedwait = 3;
+    // Wraps exactly like stepping clock by clock would
+    osc->phase += osc->step * CLOCKS_PER_TICK;
   }
-  if (callbackwait) {
-    callbackwait--;
+  blip_stereo_end_frame(_ctx->blipBuffer, CLOCKS_PER_TICK);
+} /* fillBlips */
+
+/**
+ * Shifts the noise register when a NOISE_RATE period has passed, for the fast preview model
+ */
+static void sampleNoise(ChipContext *_ctx) {
+  if (_ctx->noiseseedwait >= NOISE_RATE) {
+    _ctx->noiseseedwait -= NOISE_RATE;
   } else {
-    playroutine();
-    callbackwait = 496 - 1;
+    stepNoise(_ctx);
+    _ctx->noiseseedwait += _ctx->sampleRate - NOISE_RATE;
   }
+}
+
+/**
+ * One output sample of the fast preview model: every voice sampled once, with no band limiting
+ */
+static ChipSample getSample(ChipContext *_ctx) {
+  u8 i;
+  ChipSample acc;
+  sampleNoise(_ctx);
   acc.left = 0;
   acc.right = 0;
   for (i = 0; i < 4; i++) {
     s8 value; // [-32,31]
-    switch (osc[i].waveform) {
-      case WF_TRI:
-        if (osc[i].phase < 0x8000) {
-          value = -32 + (osc[i].phase >> 9);
-        } else {
-          value = 31 - ((osc[i].phase - 0x8000) >> 9);
-        }
-        break;
-      case WF_SAW:value = -32 + (osc[i].phase >> 10);
-        break;
-      case WF_PUL:value = (osc[i].phase > osc[i].duty) ? -32 : 31;
-        break;
-      case WF_NOI:value = (noiseseed & 63) - 32;
-        break;
-      default:value = 0;
-        break;
-    }
-    if (osc[i].freq < 0) {
-      osc[i].freq = 0;
+    if (_ctx->osc[i].waveform == WF_NOI) {
+      value = (_ctx->noiseseed & 63) - 32;
+    } else {
+      value = voiceValue(&_ctx->osc[i], _ctx->osc[i].phase);
     }
-    osc[i].phase += (osc[i].freq / 2.75625);
+    _ctx->osc[i].phase += _ctx->osc[i].sampleStep << 16;
     if ((i & 2) == 0) {
-      acc.left += value * osc[i].volume;  // rhs = [-8160,7905]
+      acc.left += value * _ctx->osc[i].volume;  // rhs = [-8160,7905]
     } else {
-      acc.right += value * osc[i].volume; // rhs = [-8160,7905]
+      acc.right += value * _ctx->osc[i].volume; // rhs = [-8160,7905]
     }
   }
   acc.left = (acc.left + acc.right * 0.8f) * 0.8f;
   acc.right = (acc.right + acc.left * 0.8f) * 0.8f;
-
-  // acc [-32640,31620]
-  // return 128 + (acc >> 8); // [1,251]
-  return chip_expandSample(acc);
+  return acc;
 } /* getSample */
 
-static void getSamples(ChipSample *_buf, int _len) {
-  for (size_t i = 0; i < _len; i++) {
-    _buf[i] = getSample();
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+typedef u16 v8u16 __attribute__((vector_size(16)));
+typedef s16 v8s16 __attribute__((vector_size(16)));
+typedef s16 v4s16 __attribute__((vector_size(8)));
+typedef s32 v4s32 __attribute__((vector_size(16)));
+typedef float v4f32 __attribute__((vector_size(16)));
+
+/**
+ * Renders two samples per pass with all four oscillators of both samples in one
+ * register: lanes 0-3 are voices 0-3 at sample n, lanes 4-7 the same voices at
+ * n + 1. Every waveform is computed for every lane and the wanted one is masked in,
+ * so there are no branches. Gives the same samples as getSample.
+ */
+static void renderVoices(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  struct oscillator *osc = _ctx->osc;
+  v8u16 phase, step, duty;
+  v8s16 volume, isTri, isSaw, isPul, isNoi;
+  for (int i = 0; i < 4; i++) {
+    phase[i] = osc[i].phase >> 16;
+    phase[i + 4] = (osc[i].phase >> 16) + osc[i].sampleStep;
+    step[i] = step[i + 4] = osc[i].sampleStep * 2;
+    duty[i] = duty[i + 4] = osc[i].duty;
+    volume[i] = volume[i + 4] = osc[i].volume;
+    isTri[i] = isTri[i + 4] = osc[i].waveform == WF_TRI ? -1 : 0;
+    isSaw[i] = isSaw[i + 4] = osc[i].waveform == WF_SAW ? -1 : 0;
+    isPul[i] = isPul[i + 4] = osc[i].waveform == WF_PUL ? -1 : 0;
+    isNoi[i] = isNoi[i + 4] = osc[i].waveform == WF_NOI ? -1 : 0;
+  }
+  for (int n = 0; n + 1 < _len; n += 2) {
+    v8s16 noise;
+    sampleNoise(_ctx);
+    s16 first = (_ctx->noiseseed & 63) - 32;
+    sampleNoise(_ctx);
+    s16 second = (_ctx->noiseseed & 63) - 32;
+    noise = (v8s16) {first, first, first, first, second, second, second, second};
+
+    // Triangle folds the top half back down: t ^ 127 == 127 - t once bit 15 is set
+    v8s16 high = (v8s16) (phase >> 9);
+    v8s16 tri = (high ^ (((v8s16) phase >> 15) & 127)) - 32;
+    v8s16 saw = (v8s16) (phase >> 10) - 32;
+    v8s16 pul = 31 + ((v8s16) (phase > duty) & -63);
+    v8s16 value = (tri & isTri) | (saw & isSaw) | (pul & isPul) | (noise & isNoi);
+    v8s16 level = value * volume;
+    phase += step;
+
+    // Voices 0+1 go left and 2+3 right: summing each pair of 16 bit lanes in place (lane 0 is the
+    // low half on little endian targets) gives {left n, right n, left n + 1, right n + 1}
+    v4s32 pairs = (v4s32) level;
+    v4f32 acc = __builtin_convertvector(((pairs << 16) >> 16) + (pairs >> 16), v4f32);
+    v4f32 swapped = __builtin_shufflevector(acc, acc, 1, 0, 3, 2);
+    v4s32 left = __builtin_convertvector((acc + swapped * 0.8f) * 0.8f, v4s32);
+    v4f32 leftf = __builtin_convertvector(left, v4f32);
+    v4s32 right = __builtin_convertvector((acc + __builtin_shufflevector(leftf, leftf, 0, 0, 2, 2) * 0.8f) * 0.8f,
+                                          v4s32);
+    v4s16 out = __builtin_convertvector(__builtin_shufflevector(left, right, 0, 5, 2, 7), v4s16);
+    memcpy(&_buf[n], &out, sizeof(out));
+  }
+  for (int i = 0; i < 4; i++) {
+    osc[i].phase = (u32) phase[i] << 16;
+  }
+  if (_len & 1) {
+    _buf[_len - 1] = getSample(_ctx);
+  }
+} /* renderVoices */
+#else
+static void renderVoices(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  for (int i = 0; i < _len; i++) {
+    _buf[i] = getSample(_ctx);
+  }
+}
+#endif
+
+/**
+ * Fast preview model: oscillator settings only change in playroutine, so everything up to the next call is
+ * one run of renderVoices
+ */
+static void getSamplesFast(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  while (_len > 0) {
+    if (!_ctx->callbackwait) {
+      playroutine(_ctx);
+      u32 wait = BASE_TICK_SAMPLES * _ctx->sampleRate + _ctx->tickRemainder;
+      _ctx->callbackwait = wait / BASE_RATE;
+      _ctx->tickRemainder = wait % BASE_RATE;
+    }
+    int run = _len < _ctx->callbackwait ? _len : _ctx->callbackwait;
+    renderVoices(_ctx, _buf, run);
+    chip_expandSamples(&_ctx->expand, _buf, run);
+    _ctx->callbackwait -= run;
+    _buf += run;
+    _len -= run;
+  }
+}
+
+static void getSamples(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  if (_ctx->fastPreview) {
+    getSamplesFast(_ctx, _buf, _len);
+    return;
+  }
+  // The blip buffer only holds two ticks, so large requests are read a tick at a time
+  while (_len > 0) {
+    int avail = blip_stereo_samples_avail(_ctx->blipBuffer);
+    if (avail == 0) {
+      fillBlips(_ctx);
+      continue;
+    }
+    int len = avail < _len ? avail : _len;
+    blip_stereo_read_samples(_ctx->blipBuffer, (short *) _buf, len);
+    chip_expandSamples(&_ctx->expand, _buf, len);
+    _buf += len;
+    _len -= len;
   }
 }
 
-static const char *getSongHelp(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static u32 dryRunTick(ChipContext *_ctx) {
+  playroutine(_ctx);
+  // Carry the fraction of a sample so long runs add up to the rendered length
+  u32 samples = BASE_TICK_SAMPLES * _ctx->sampleRate + _ctx->dryRunRemainder;
+  _ctx->dryRunRemainder = samples % BASE_RATE;
+  return samples / BASE_RATE;
+}
+
+static const char *getSongHelp(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
     default: return "";
   }
 }
 
-static const char *getPatternHelp(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static const char *getPatternHelp(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow,
+                                  u8 _patternColumn) {
   switch (_patternColumn) {
     default:return "";
   }
 }   /* getPatternHelp */
 
+static ChipError setFastPreview(ChipContext *_ctx, bool _fast) {
+  if (_fast == _ctx->fastPreview) {
+    return NO_ERR;
+  }
+  // Each model starts the next tick afresh: the blip buffer drops what it held and the fast model forgets
+  // the phase fractions it can't represent, so both give the same samples from here as from a fresh start
+  _ctx->fastPreview = _fast;
+  _ctx->callbackwait = 0;
+  _ctx->tickRemainder = 0;
+  _ctx->noiseseedwait = 0;
+  blip_stereo_clear(_ctx->blipBuffer);
+  for (int i = 0; i < 4; i++) {
+    _ctx->osc[i].phase &= 0xffff0000;
+    _ctx->osc[i].lastLeft = 0;
+    _ctx->osc[i].lastRight = 0;
+  }
+  return NO_ERR;
+}
+
 static void preferredWindowSize(u32 *_width, u32 *_height) {
   *_width = 1280;
   *_height = 632;
@@ -1191,9 +1455,12 @@ ChipInterface chip_lft = {
     playSongFrom,
     playPatternFrom,
     isPlaying,
+    getLoopCount,
     stop,
     silence,
     getSamples,
+    dryRunTick,
+    setFastPreview,
 
     // Misc
     preferredWindowSize
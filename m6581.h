@@ -18,6 +18,12 @@
     CHIPS_ASSERT(c)
     ~~~
 
+    Define M6581_CUTOFF_TABLE as the name of a precomputed const float[2048]
+    cutoff table, and M6581_DECIMATE_TABLE as the name of a precomputed
+    const int32_t[M6581_DECIMATE_TAPS] decimation filter (see tools/gentables.c),
+    to skip building them in m6581_init. Without them every m6581_init rewrites
+    the shared tables, so SIDs must then be initialized from one thread at a time.
+
     ## Emulated Pins
 
     ***********************************
@@ -60,6 +66,7 @@
 #*/
 #include <stdint.h>
 #include <stdbool.h>
+#include "tablegen.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -170,8 +177,16 @@ typedef struct {
   int tick_hz;        // frequency at which m6581_tick() will be called in Hz
   int sound_hz;       // sound sample frequency
   float magnitude;    // output sample magnitude (0=silence to 1=max volume)
+  bool multirate_filter;  // run filter and mixer M6581_DECIMATE_FACTOR times per sample instead of every tick
 } m6581_desc_t;
 
+// the mix is averaged into this many steps per output sample, then decimated to sound_hz
+#define M6581_DECIMATE_FACTOR (TABLEGEN_M6581_DECIMATE_FACTOR)
+// length of the FIR filter decimating the steps to sound_hz
+#define M6581_DECIMATE_TAPS (TABLEGEN_M6581_DECIMATE_TAPS)
+// longest run of ticks covered by one filter step with multirate_filter
+#define M6581_MULTIRATE_MAX_TICKS (64)
+
 // envelope generator state
 typedef enum {
   M6581_ENV_FROZEN,
@@ -217,8 +232,26 @@ typedef struct {
   int v_hp;
   int v_bp;
   int v_lp;
+  /* multirate_filter: the per-tick filter above advanced n ticks at a time with a constant
+     input, as lp/bp = step_a[n] * lp/bp + step_b[n] * input
+  */
+  int step_max_ticks;
+  float step_a[M6581_MULTIRATE_MAX_TICKS + 1][4];
+  float step_b[M6581_MULTIRATE_MAX_TICKS + 1][2];
+  float step_lp;
+  float step_bp;
 } m6581_filter_t;
 
+// number of register writes that can be scheduled ahead
+#define M6581_MAX_WRITES (64)
+
+// a register write scheduled for a specific tick
+typedef struct {
+  uint32_t tick;
+  uint8_t reg;
+  uint8_t data;
+} m6581_write_t;
+
 // m6581 instance state
 typedef struct {
   int sound_hz;
@@ -233,11 +266,22 @@ typedef struct {
   m6581_filter_t filter;
   // sample generation state
   int sample_period;
-  int sample_counter;
-  float sample_accum;
-  float sample_accum_count;
-  float sample_mag;
-  float sample;
+  int sample_mag;                 // M6581_SAMPLE_MAG_BITS fraction bits, from the mix to 16 bit
+  int16_t sample;
+  int step_counter;
+  int step_ticks;
+  int step_sum;
+  int step_phase;
+  int decimate_pos;
+  int32_t decimate_history[2 * M6581_DECIMATE_TAPS];
+  // multirate_filter state; step_sum then holds the unfiltered voices and step_filtered the filter input
+  bool multirate;
+  int step_filtered;
+  // scheduled register writes, ordered by tick
+  uint32_t clock;
+  m6581_write_t writes[M6581_MAX_WRITES];
+  int write_head;
+  int num_writes;
   // debug inspection
   uint64_t pins;
 } m6581_t;
@@ -251,6 +295,21 @@ void m6581_reset(m6581_t *sid);
 // tick a m6581_t instance
 uint64_t m6581_tick(m6581_t *sid, uint64_t pins);
 
+/* run a m6581_t instance for up to num_ticks ticks without bus access, storing
+   each new sample in samples; stops early once max_samples samples have been
+   produced, returns the number of ticks run and the sample count in num_samples
+*/
+int m6581_run(m6581_t *sid, int num_ticks, int16_t *samples, int max_samples, int *num_samples);
+
+// write a register immediately, bypassing the pins
+void m6581_write(m6581_t *sid, uint8_t reg, uint8_t data);
+
+/* schedule a register write for the end of the tick delay_ticks from now, the same
+   point at which m6581_tick() applies a write on its pins (0 means the next tick);
+   returns false when M6581_MAX_WRITES writes are already pending
+*/
+bool m6581_schedule_write(m6581_t *sid, uint32_t delay_ticks, uint8_t reg, uint8_t data);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -279,6 +338,10 @@ uint64_t m6581_tick(m6581_t *sid, uint64_t pins);
 #define M6581_SET_DATA(p, d) {p=(((p)&~0xFF0000ULL)|(((d)<<16)&0xFF0000ULL));}
 /* fixed point precision for sample period */
 #define M6581_FIXEDPOINT_SCALE (16)
+/* fraction bits of sample_mag */
+#define M6581_SAMPLE_MAG_BITS (16)
+/* fraction bits of the decimation taps */
+#define M6581_DECIMATE_TAP_BITS (15)
 /* move bit into first position */
 #define M6581_BIT(val, bitnr) ((val>>bitnr)&1)
 /* filter constants */
@@ -310,7 +373,18 @@ static const uint8_t _m6581_env_gen_dr_divisors[256] = {
     1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
 };
 
+#ifdef M6581_CUTOFF_TABLE
+#define _m6581_cutoff_freq M6581_CUTOFF_TABLE
+#else
 static float _m6581_cutoff_freq[2048];
+#endif
+#ifdef M6581_DECIMATE_TABLE
+#define _m6581_decimate_taps M6581_DECIMATE_TABLE
+_Static_assert(sizeof(M6581_DECIMATE_TABLE) == M6581_DECIMATE_TAPS * sizeof(int32_t),
+               "M6581_DECIMATE_TABLE must have M6581_DECIMATE_TAPS taps");
+#else
+static int32_t _m6581_decimate_taps[M6581_DECIMATE_TAPS];
+#endif
 
 static void _m6581_init_voice(m6581_voice_t *v) {
   memset(v, 0, sizeof(*v));
@@ -320,20 +394,27 @@ static void _m6581_init_voice(m6581_voice_t *v) {
 }
 
 static void _m6581_init_cutoff_table() {
+#ifndef M6581_CUTOFF_TABLE
   for (int i = 0; i < 2048; i++) {
-    float x = i / 8.0f;
-    float cf = -0.0156f * x * x + 48.473f * x - 45.074f;
-    _m6581_cutoff_freq[i] = cf <= 0 ? 0 : cf;
+    _m6581_cutoff_freq[i] = tablegen_m6581Cutoff(i);
   }
+#endif
+}
+
+static void _m6581_init_decimate_taps() {
+#ifndef M6581_DECIMATE_TABLE
+  tablegen_m6581DecimateTaps(_m6581_decimate_taps, M6581_DECIMATE_TAPS, M6581_DECIMATE_FACTOR);
+#endif
 }
 
 static void _m6581_set_filter_cutoff(m6581_filter_t *);
 
 static void _m6581_set_resonance(m6581_filter_t *);
 
-static void _m6581_init_filter(m6581_filter_t *f, int sound_hz) {
+static void _m6581_init_filter(m6581_filter_t *f, int sound_hz, int step_max_ticks) {
   memset(f, 0, sizeof(*f));
   f->nyquist_freq = sound_hz / 2;
+  f->step_max_ticks = step_max_ticks;
   _m6581_set_filter_cutoff(f);
   _m6581_set_resonance(f);
 }
@@ -345,14 +426,23 @@ void m6581_init(m6581_t *sid, const m6581_desc_t *desc) {
   memset(sid, 0, sizeof(*sid));
   sid->sound_hz = desc->sound_hz;
   sid->sample_period = (desc->tick_hz * M6581_FIXEDPOINT_SCALE) / desc->sound_hz;
-  sid->sample_counter = sid->sample_period;
-  sid->sample_mag = desc->magnitude;
-  sid->sample_accum_count = 1.0f;
+  /* a full scale mix is 16384 */
+  sid->sample_mag = (int) (desc->magnitude * 32767.0f / 16384.0f * (1 << M6581_SAMPLE_MAG_BITS));
+  sid->multirate = desc->multirate_filter;
   for (int i = 0; i < 3; i++) {
     _m6581_init_voice(&sid->voice[i]);
   }
   _m6581_init_cutoff_table();
-  _m6581_init_filter(&sid->filter, sid->sound_hz);
+  _m6581_init_decimate_taps();
+  int step_max_ticks = 0;
+  if (sid->multirate) {
+    /* a filter step covers sample_period / M6581_DECIMATE_FACTOR ticks, rounded either way */
+    step_max_ticks = sid->sample_period / (M6581_DECIMATE_FACTOR * M6581_FIXEDPOINT_SCALE) + 1;
+    CHIPS_ASSERT(step_max_ticks <= M6581_MULTIRATE_MAX_TICKS);
+  }
+  _m6581_init_filter(&sid->filter, sid->sound_hz, step_max_ticks);
+  sid->step_counter = sid->sample_period;
+  sid->step_phase = M6581_DECIMATE_FACTOR;
 }
 
 void m6581_reset(m6581_t *sid) {
@@ -362,11 +452,17 @@ void m6581_reset(m6581_t *sid) {
   for (int i = 0; i < 3; i++) {
     _m6581_init_voice(&sid->voice[i]);
   }
-  _m6581_init_filter(&sid->filter, sid->sound_hz);
-  sid->sample_counter = sid->sample_period;
-  sid->sample = 0.0f;
-  sid->sample_accum = 0.0f;
-  sid->sample_accum_count = 1.0f;
+  _m6581_init_filter(&sid->filter, sid->sound_hz, sid->filter.step_max_ticks);
+  sid->sample = 0;
+  sid->step_counter = sid->sample_period;
+  sid->step_ticks = 0;
+  sid->step_sum = 0;
+  sid->step_filtered = 0;
+  sid->step_phase = M6581_DECIMATE_FACTOR;
+  sid->decimate_pos = 0;
+  memset(sid->decimate_history, 0, sizeof(sid->decimate_history));
+  sid->write_head = 0;
+  sid->num_writes = 0;
   sid->pins = 0;
 }
 
@@ -592,6 +688,36 @@ static inline void _m6581_voice_sync(m6581_t *sid, int voice_index) {
 }
 
 /*--- FILTER IMPLEMENTATION ---------------------------------------------------*/
+/* precompute the multirate steps: one tick of _m6581_filter_output() is
+   [lp bp] = A * [lp bp] + B * vi with A = [1 -w; w 1-w*rc] and B = [0 w],
+   so n ticks are A^n and (A^0 + ... + A^(n-1)) * B
+*/
+static void _m6581_set_filter_steps(m6581_filter_t *f) {
+  if (f->step_max_ticks == 0) {
+    return;
+  }
+  const float w = (float) (f->w0 / (1 << 6)) / (1 << 14);
+  const float rc = (float) f->resonance_coeff_div_1024 / (1 << 10);
+  const float a[4] = {1.0f, -w, w, 1.0f - w * rc};
+  float *p = f->step_a[0];
+  p[0] = 1.0f;
+  p[1] = 0.0f;
+  p[2] = 0.0f;
+  p[3] = 1.0f;
+  f->step_b[0][0] = 0.0f;
+  f->step_b[0][1] = 0.0f;
+  for (int n = 1; n <= f->step_max_ticks; n++) {
+    const float *prev = f->step_a[n - 1];
+    float *next = f->step_a[n];
+    f->step_b[n][0] = f->step_b[n - 1][0] + prev[1] * w;
+    f->step_b[n][1] = f->step_b[n - 1][1] + prev[3] * w;
+    next[0] = a[0] * prev[0] + a[1] * prev[2];
+    next[1] = a[0] * prev[1] + a[1] * prev[3];
+    next[2] = a[2] * prev[0] + a[3] * prev[2];
+    next[3] = a[2] * prev[1] + a[3] * prev[3];
+  }
+}
+
 static void _m6581_set_filter_cutoff(m6581_filter_t *f) {
   const float freq_domain_div_coeff = 2.0f * ((float) M_PI) * 1.048576f;
   f->w0 = (int) (_m6581_cutoff_freq[f->cutoff] * freq_domain_div_coeff);
@@ -601,10 +727,12 @@ static void _m6581_set_filter_cutoff(m6581_filter_t *f) {
   if (f->w0 > w0_max_dt) {
     f->w0 = w0_max_dt;
   }
+  _m6581_set_filter_steps(f);
 }
 
 static void _m6581_set_resonance(m6581_filter_t *f) {
   f->resonance_coeff_div_1024 = (int) (1024.0f / (0.707f + 1.9f * ((float) f->resonance) / 15.0f) + 0.5f);
+  _m6581_set_filter_steps(f);
 }
 
 static void _m6581_set_cutoff_lo(m6581_filter_t *f, uint8_t data) {
@@ -654,8 +782,57 @@ static inline int _m6581_filter_output(m6581_filter_t *f, int vi) {
   return vf * (1 << 7);
 }
 
-/* tick the sound generation, return true when new sample ready */
-static uint64_t _m6581_tick(m6581_t *sid, uint64_t pins) {
+/* run the filter over the ticks since the last step, with their average input */
+static inline float _m6581_filter_step(m6581_filter_t *f, int ticks, float vi) {
+  const float *a = f->step_a[ticks];
+  const float *b = f->step_b[ticks];
+  float lp = a[0] * f->step_lp + a[1] * f->step_bp + b[0] * vi;
+  float bp = a[2] * f->step_lp + a[3] * f->step_bp + b[1] * vi;
+  f->step_lp = lp;
+  f->step_bp = bp;
+  float vf = 0.0f;
+  if (f->mode & M6581_FILTER_LP) {
+    vf += lp;
+  }
+  if (f->mode & M6581_FILTER_BP) {
+    vf += bp;
+  }
+  if (f->mode & M6581_FILTER_HP) {
+    vf += bp * ((float) f->resonance_coeff_div_1024 / (1 << 10)) - lp - vi;
+  }
+  return vf;
+}
+
+/* end a step with its average mix, return true when a new sample is ready */
+static inline bool _m6581_decimate(m6581_t *sid, int32_t mix) {
+  /* history is stored twice so the taps can always be read in one run */
+  int pos = sid->decimate_pos;
+  sid->decimate_history[pos] = mix;
+  sid->decimate_history[pos + M6581_DECIMATE_TAPS] = mix;
+  sid->decimate_pos = (pos + 1) % M6581_DECIMATE_TAPS;
+  if (--sid->step_phase > 0) {
+    return false;
+  }
+  sid->step_phase = M6581_DECIMATE_FACTOR;
+  const int32_t *history = &sid->decimate_history[sid->decimate_pos];
+  /* four partial sums keep the adds independent */
+  int64_t s0 = 0;
+  int64_t s1 = 0;
+  int64_t s2 = 0;
+  int64_t s3 = 0;
+  for (int i = 0; i < M6581_DECIMATE_TAPS; i += 4) {
+    s0 += (int64_t) _m6581_decimate_taps[i] * history[i];
+    s1 += (int64_t) _m6581_decimate_taps[i + 1] * history[i + 1];
+    s2 += (int64_t) _m6581_decimate_taps[i + 2] * history[i + 2];
+    s3 += (int64_t) _m6581_decimate_taps[i + 3] * history[i + 3];
+  }
+  int64_t s = (((s0 + s1) + (s2 + s3)) * sid->sample_mag) >> (M6581_DECIMATE_TAP_BITS + M6581_SAMPLE_MAG_BITS);
+  sid->sample = (int16_t) (s > INT16_MAX ? INT16_MAX : (s < INT16_MIN ? INT16_MIN : s));
+  return true;
+}
+
+/* tick wave and envelope generators and the register bus */
+static inline void _m6581_voices_tick(m6581_t *sid) {
   /* decay the last written register value */
   if (sid->bus_decay > 0) {
     if (--sid->bus_decay == 0) {
@@ -671,6 +848,12 @@ static uint64_t _m6581_tick(m6581_t *sid, uint64_t pins) {
   for (int i = 0; i < 3; i++) {
     _m6581_voice_sync(sid, i);
   }
+}
+
+/* tick the sound generation and add the tick's mix to the current step */
+static inline void _m6581_mix_tick(m6581_t *sid) {
+  _m6581_voices_tick(sid);
+  sid->step_ticks++;
   /* filter */
   int sum_filtered_outp = 0;
   int sum_outp = 0;
@@ -688,19 +871,47 @@ static uint64_t _m6581_tick(m6581_t *sid, uint64_t pins) {
       }
     }
   }
+  if (sid->multirate) {
+    /* the filter and mixer run once per step, on the step's average */
+    sid->step_filtered += sum_filtered_outp;
+    sid->step_sum += sum_outp;
+    return;
+  }
   int accu = (sum_outp + _m6581_filter_output(&sid->filter, sum_filtered_outp) + M6581_DCMIXER) * sid->filter.volume;
-  int sample = accu / (1 << 12);
-  sid->sample_accum += (sample / 16384.0f);
-  sid->sample_accum_count += 1.0f;
-
-  /* new sample? */
-  sid->sample_counter -= M6581_FIXEDPOINT_SCALE;
-  if (sid->sample_counter <= 0) {
-    sid->sample_counter += sid->sample_period;
-    float s = sid->sample_accum / sid->sample_accum_count;
-    sid->sample = sid->sample_mag * s;
-    sid->sample_accum = 0.0f;
-    sid->sample_accum_count = 0.0f;
+  sid->step_sum += accu / (1 << 12);
+}
+
+/* average the current step and feed it to the decimator, return true when new sample ready */
+static inline bool _m6581_end_step(m6581_t *sid) {
+  int32_t mix;
+  if (sid->multirate) {
+    const float scale = 1.0f / (float) sid->step_ticks;
+    float vf = _m6581_filter_step(&sid->filter, sid->step_ticks, sid->step_filtered * scale);
+    float accu = (sid->step_sum * scale + vf + M6581_DCMIXER) * sid->filter.volume;
+    mix = (int32_t) (accu * (1.0f / (1 << 12)));
+    sid->step_filtered = 0;
+  } else {
+    mix = sid->step_sum / sid->step_ticks;
+  }
+  sid->step_sum = 0;
+  sid->step_ticks = 0;
+  return _m6581_decimate(sid, mix);
+}
+
+/* tick the sound generation, return true when new sample ready */
+static inline bool _m6581_generate(m6581_t *sid) {
+  _m6581_mix_tick(sid);
+  /* new step? M6581_DECIMATE_FACTOR of them per sample_period */
+  sid->step_counter -= M6581_DECIMATE_FACTOR * M6581_FIXEDPOINT_SCALE;
+  if (sid->step_counter > 0) {
+    return false;
+  }
+  sid->step_counter += sid->sample_period;
+  return _m6581_end_step(sid);
+}
+
+static uint64_t _m6581_tick(m6581_t *sid, uint64_t pins) {
+  if (_m6581_generate(sid)) {
     pins |= M6581_SAMPLE;
   } else {
     pins &= ~M6581_SAMPLE;
@@ -735,9 +946,8 @@ static uint64_t _m6581_read(m6581_t *sid, uint64_t pins) {
 }
 
 /* write a register */
-static void _m6581_write(m6581_t *sid, uint64_t pins) {
-  uint8_t reg = pins & M6581_ADDR_MASK;
-  uint8_t data = M6581_GET_DATA(pins);
+void m6581_write(m6581_t *sid, uint8_t reg, uint8_t data) {
+  CHIPS_ASSERT(sid);
   sid->bus_value = data;
   sid->bus_decay = 0x2000;
   switch (reg) {
@@ -794,12 +1004,54 @@ static void _m6581_write(m6581_t *sid, uint64_t pins) {
   }
 }
 
+static void _m6581_write(m6581_t *sid, uint64_t pins) {
+  m6581_write(sid, pins & M6581_ADDR_MASK, M6581_GET_DATA(pins));
+}
+
+bool m6581_schedule_write(m6581_t *sid, uint32_t delay_ticks, uint8_t reg, uint8_t data) {
+  CHIPS_ASSERT(sid);
+  if (sid->num_writes == M6581_MAX_WRITES) {
+    return false;
+  }
+  /* insert from the back, keeping writes for the same tick in the order given */
+  uint32_t tick = sid->clock + delay_ticks;
+  int i = sid->num_writes++;
+  while (i > 0) {
+    m6581_write_t *prev = &sid->writes[(sid->write_head + i - 1) % M6581_MAX_WRITES];
+    if ((int32_t) (tick - prev->tick) >= 0) {
+      break;
+    }
+    sid->writes[(sid->write_head + i) % M6581_MAX_WRITES] = *prev;
+    i--;
+  }
+  m6581_write_t *w = &sid->writes[(sid->write_head + i) % M6581_MAX_WRITES];
+  w->tick = tick;
+  w->reg = reg & M6581_ADDR_MASK;
+  w->data = data;
+  return true;
+}
+
+/* apply the scheduled writes whose tick has been run */
+static void _m6581_apply_writes(m6581_t *sid) {
+  while (sid->num_writes > 0) {
+    m6581_write_t *w = &sid->writes[sid->write_head];
+    if ((int32_t) (sid->clock - w->tick) <= 0) {
+      break;
+    }
+    m6581_write(sid, w->reg, w->data);
+    sid->write_head = (sid->write_head + 1) % M6581_MAX_WRITES;
+    sid->num_writes--;
+  }
+}
+
 /* the all-in-one tick function */
 uint64_t m6581_tick(m6581_t *sid, uint64_t pins) {
   CHIPS_ASSERT(sid);
 
   /* first perform the regular per-tick actions */
   pins = _m6581_tick(sid, pins);
+  sid->clock++;
+  _m6581_apply_writes(sid);
 
   /* register read/write */
   if (pins & M6581_CS) {
@@ -813,4 +1065,48 @@ uint64_t m6581_tick(m6581_t *sid, uint64_t pins) {
   return pins;
 }
 
+/* the bulk tick function, for stretches without register access */
+int m6581_run(m6581_t *sid, int num_ticks, int16_t *samples, int max_samples, int *num_samples) {
+  CHIPS_ASSERT(sid && samples && num_samples);
+  int ticks = 0;
+  int n = 0;
+  while ((ticks < num_ticks) && (n < max_samples)) {
+    /* run up to and including the tick of the next scheduled write */
+    int end = num_ticks;
+    if (sid->num_writes > 0) {
+      int32_t until = (int32_t) (sid->writes[sid->write_head].tick - sid->clock) + 1;
+      if (until < 1) {
+        until = 1;
+      }
+      if (until < end - ticks) {
+        end = ticks + until;
+      }
+    }
+    int start = ticks;
+    while ((ticks < end) && (n < max_samples)) {
+      /* mix up to the end of the current step without checking for it on every tick */
+      const int step = M6581_DECIMATE_FACTOR * M6581_FIXEDPOINT_SCALE;
+      int run = (sid->step_counter + step - 1) / step;
+      if (run > end - ticks) {
+        run = end - ticks;
+      }
+      for (int i = 0; i < run; i++) {
+        _m6581_mix_tick(sid);
+      }
+      ticks += run;
+      sid->step_counter -= run * step;
+      if (sid->step_counter <= 0) {
+        sid->step_counter += sid->sample_period;
+        if (_m6581_end_step(sid)) {
+          samples[n++] = sid->sample;
+        }
+      }
+    }
+    sid->clock += ticks - start;
+    _m6581_apply_writes(sid);
+  }
+  *num_samples = n;
+  return ticks;
+}
+
 #endif /* CHIPS_IMPL */
@@ -4,8 +4,11 @@
 #include <ctype.h>
 #include <string.h>
 #include <math.h>
+#include <stdlib.h>
 #include "blip_buf.h"
 #include "console.h"
+#include "tables.h"
+#include "tablegen.h"
 
 #define PATTERN_LEN 32
 #define NUM_CHANNELS 4
@@ -60,39 +63,6 @@ struct PanTable {
   u8 column[256];
 };
 
-static blip_t *sBlipBuffer[2];
-
-static struct Instrument instrument[256];
-static struct Pattern track[256];
-static struct SongLine song[256];
-static char sFilename[1024];
-static int songlen = 1;
-static struct VolumeTable volumeTable[16];
-static struct DutyTable dutyTable[16];
-static struct PanTable panTable[16];
-static u8 waveTable[16][32];
-static u8 sTempo = 6;
-static u8 trackwait;
-static u8 trackpos;
-static u8 songpos;
-static u8 playsong;
-static u8 playtrack;
-
-static const u16 waveStep[8 * 12] = {
-    0x5448, 0x4f8d, 0x4b16, 0x46df, 0x42e5, 0x3f24, 0x3b98, 0x3840,
-    0x3518, 0x321d, 0x2f4d, 0x2ca5, 0x2a24, 0x27c6, 0x258b, 0x2370,
-    0x2172, 0x1f92, 0x1dcc, 0x1c20, 0x1a8c, 0x190f, 0x17a7, 0x1653,
-    0x1512, 0x13e3, 0x12c5, 0x11b8, 0x10b9, 0x0fc9, 0x0ee6, 0x0e10,
-    0x0d46, 0x0c87, 0x0bd3, 0x0b29, 0x0a89, 0x09f2, 0x0963, 0x08dc,
-    0x085d, 0x07e4, 0x0773, 0x0708, 0x06a3, 0x0644, 0x05ea, 0x0595,
-    0x0544, 0x04f9, 0x04b1, 0x046e, 0x042e, 0x03f2, 0x03ba, 0x0384,
-    0x0351, 0x0322, 0x02f5, 0x02ca, 0x02a2, 0x027c, 0x0259, 0x0237,
-    0x0217, 0x01f9, 0x01dd, 0x01c2, 0x01a9, 0x0191, 0x017a, 0x0165,
-    0x0151, 0x013e, 0x012c, 0x011b, 0x010c, 0x00fd, 0x00ee, 0x00e1,
-    0x00d4, 0x00c8, 0x00bd, 0x00b3, 0x00a9, 0x009f, 0x0096, 0x008e,
-    0x0086, 0x007e, 0x0077, 0x0071, 0x006a, 0x0064, 0x005f, 0x0059,
-};
-
 static const s8 sinetable[] = {
     0, 12, 25, 37, 49, 60, 71, 81,
     90, 98, 106, 112, 117, 122, 125, 126,
@@ -104,10 +74,9 @@ static const s8 sinetable[] = {
     -90, -81, -71, -60, -49, -37, -25, -12
 };
 
-static volatile struct oscillator {
+struct oscillator {
   s32 freq;
   u16 phase;
-  u16 lastPhase;
   u16 duty;
   u8 waveform;
   u8 volume;  // 0-255
@@ -116,9 +85,21 @@ static volatile struct oscillator {
   s16 lastLeft;
   s16 lastRight;
   size_t lastTime;
-} osc[NUM_CHANNELS];
+  // Left/right output for each of the 32 steps (noise uses the low 4 bits of buzzseed instead),
+  // rebuilt by updateLevels whenever the settings they were built from change. Like the rest of the
+  // context they belong to whichever thread holds the engine: the audio producer while it renders, the
+  // editor inside lockEngine.
+  s16 levelLeft[32];
+  s16 levelRight[32];
+  u8 levelSkip[32]; // Steps from each phase to the next one with a different output, 32 if it never changes
+  bool levelsValid;
+  u8 levelWaveform;
+  u16 levelDuty;
+  u8 levelVolume;
+  u8 levelPan;
+};
 
-static struct channel {
+struct channel {
   u8 tnum;
   s8 transp;
   u8 tnote;
@@ -149,342 +130,472 @@ static struct channel {
   u8 panPtr;
   u8 filterLow;
   u8 filterHigh;
-} channel[NUM_CHANNELS];
+};
 
-// FILTER_LENGTH MUST BE ODD
-#define FILTER_LENGTH 31
-#define SAMPLE_RATE 44100.0
-#define CLOCK_RATE (44100.0 * 256.0)
-#define SAMPLES_PER_PLAYROUTINE (SAMPLE_RATE / 60)
+#define FILTER_LENGTH TABLEGEN_P1XL_FILTER_LENGTH
+// Samples over which a new filter kernel is crossfaded in
+#define FILTER_FADE 64
+// Samples filtered per pass in filter_mix
+#define FILTER_BLOCK 256
+// Floats of past input the kernel overlaps, interleaved left/right
+#define FILTER_HISTORY ((FILTER_LENGTH - 1) * 2)
+// Oscillators count in clocks at a fixed rate whatever the output rate; blip_buf converts
+#define CLOCK_RATE TABLES_CLOCK_RATE
 #define CLOCKS_PER_PLAYROUTINE (CLOCK_RATE / 60)
 
+struct filter {
+  u8 low;
+  u8 high;
+  bool routed; // Own blip buffer, from the first filter command on
+  float kernel[FILTER_LENGTH];
+  float fadeKernel[FILTER_LENGTH]; // Previous kernel while it is being faded out
+  int fadeLeft;
+  float history[FILTER_HISTORY];
+};
 
-static float filter_freqKernels[256][FILTER_LENGTH];
-static float filter_kernel[NUM_CHANNELS][FILTER_LENGTH];
-static float filter_buffer[NUM_CHANNELS][2][FILTER_LENGTH];
-static uint_fast16_t filter_bufferPos[NUM_CHANNELS];
+struct ChipContext {
+  u32 sampleRate;
+  u32 dryRunRemainder; // In 1/60 samples
+  blip_stereo_t *blipBuffer;
+  // Only channels with a filter get a buffer of their own, so unfiltered songs mix everything in one
+  blip_stereo_t *channelBlipBuffer[NUM_CHANNELS];
+
+  struct Instrument instrument[256];
+  struct Pattern track[256];
+  struct SongLine song[256];
+  char filename[1024];
+  int songlen;
+  struct VolumeTable volumeTable[16];
+  struct DutyTable dutyTable[16];
+  struct PanTable panTable[16];
+  u8 waveTable[16][32];
+  u8 tempo;
+  u8 trackwait;
+  u8 trackpos;
+  u8 songpos;
+  u8 playsong;
+  u8 playtrack;
+  ChipLoopDetector loopDetector;
+
+  struct oscillator osc[NUM_CHANNELS];
+  struct channel channel[NUM_CHANNELS];
+
+  struct filter filter[NUM_CHANNELS];
+  // tables.h when it was generated for sampleRate, otherwise builtKernels
+  const float (*filterKernels)[FILTER_LENGTH];
+  float (*builtKernels)[FILTER_LENGTH];
+
+  ChipExpandState expand;
+};
 
-void filter_setFreqs(const u8 _channelNum, u8 _low, u8 _high) {
-  if (_low == 0) {
+void filter_setFreqs(ChipContext *_ctx, const u8 _channelNum, u8 _low, u8 _high) {
+  struct filter *filter = &_ctx->filter[_channelNum];
+  if (filter->low == _low && filter->high == _high) {
+    return;
+  }
+  filter->low = _low;
+  filter->high = _high;
+  memcpy(filter->fadeKernel, filter->kernel, sizeof(filter->kernel));
+  filter->fadeLeft = FILTER_FADE;
+  if (_low == 0 && _high == 255) {
+    // Wide open passes the input straight through
+    memset(filter->kernel, 0, sizeof(filter->kernel));
+    filter->kernel[(FILTER_LENGTH - 1) / 2] = 1;
+  } else if (_low == 0) {
     for (size_t i = 0; i < FILTER_LENGTH; i++) {
-      filter_kernel[_channelNum][i] = filter_freqKernels[_high][i];
+      filter->kernel[i] = _ctx->filterKernels[_high][i];
     }
   } else {
     for (size_t i = 0; i < FILTER_LENGTH; i++) {
-      filter_kernel[_channelNum][i] = filter_freqKernels[_high][i] - filter_freqKernels[_low][i];
+      filter->kernel[i] = _ctx->filterKernels[_high][i] - _ctx->filterKernels[_low][i];
     }
   }
 }
 
-void filter_init() {
-  // Init kernels
-  for (size_t f = 0; f < 256; f++) {
-    float filtFreq = 16.42 + pow(1.029410639, 90 + f);
-    if (f == 255) {
-      filtFreq = 22050.0;
-    }
-    int j = 0;
-    for (int i = (-(FILTER_LENGTH - 1) / 2); i <= ((FILTER_LENGTH - 1) / 2); i++) {
-      // const float w = 0.5 * (1.0 - cos(2.0 * M_PI * ((float)j + 1.0) / ((float)FILTER_LENGTH)));
-      const float w = 0.5 - 0.5 * cos((2.0 * M_PI * ((float) j + 1.0)) / (float) FILTER_LENGTH);
-      const float b = 2.0 * filtFreq * ((float) i) / SAMPLE_RATE;
-      const float sinc_b = (b == 0) ? 1.0 : sin(M_PI * b) / (M_PI * b);
-      const float lowPass = w * (2.0 * filtFreq / SAMPLE_RATE) * sinc_b;
-      filter_freqKernels[f][j] = lowPass;
-      j++;
+/**
+ * Same kernels tools/gentables writes into tables.h, for output rates it was not generated for
+ */
+static void filter_buildKernels(float (*_kernels)[FILTER_LENGTH], double _sampleRate) {
+  for (int f = 0; f < 256; f++) {
+    tablegen_p1xlFilterKernel(_kernels[f], FILTER_LENGTH, f, _sampleRate);
+  }
+}
+
+ChipError filter_init(ChipContext *_ctx) {
+  if (_ctx->sampleRate == TABLES_SAMPLE_RATE) {
+    _ctx->filterKernels = tables_p1xlFilterKernels;
+  } else {
+    _ctx->builtKernels = malloc(256 * sizeof(*_ctx->builtKernels));
+    if (!_ctx->builtKernels) {
+      return ERR_OUT_OF_MEMORY;
     }
+    filter_buildKernels(_ctx->builtKernels, _ctx->sampleRate);
+    _ctx->filterKernels = (const float (*)[FILTER_LENGTH]) _ctx->builtKernels;
   }
-  // Init buffers
+  // Every channel starts wide open and unrouted
   for (size_t x = 0; x < NUM_CHANNELS; x++) {
-    for (size_t y = 0; y < 2; y++) {
-      for (size_t z = 0; z < FILTER_LENGTH; z++) {
-        filter_buffer[x][y][z] = 0;
-      }
-    }
-    filter_setFreqs(x, 0, 255);
-    filter_bufferPos[x] = 0;
+    struct filter *filter = &_ctx->filter[x];
+    memset(filter, 0, sizeof(*filter));
+    filter->kernel[(FILTER_LENGTH - 1) / 2] = 1;
+    filter->high = 255;
   }
+  return NO_ERR;
 }
 
-s16 filter_sample(const s16 _input, const u8 _channelNum, const u8 _zeroForLeft) {
-  float out = 0;
-  uint_fast16_t *pos = &filter_bufferPos[_channelNum];
-  float *buf = filter_buffer[_channelNum][_zeroForLeft];
-
-  buf[(*pos)++] = _input;
-  if (*pos == FILTER_LENGTH) {
-    *pos = 0;
+// Floats filter_convolve produces per pass
+#define FILTER_STEP 16
+
+#if defined(__GNUC__)
+typedef float v4f32 __attribute__((vector_size(16)));
+
+/**
+ * _y[j] = sum of _kernel[k] * _x[j + 2k], over interleaved stereo so both sides go through the same loop
+ * @param _count Number of floats in _y, a multiple of FILTER_STEP
+ */
+static void filter_convolve(const float *_kernel, const float *_x, float *_y, int _count) {
+  // Four independent sums per pass, or every tap would wait on the previous add
+  for (int j = 0; j < _count; j += FILTER_STEP) {
+    v4f32 acc[4] = {{0}};
+    for (int k = 0; k < FILTER_LENGTH; k++) {
+      v4f32 x[4];
+      memcpy(x, &_x[j + k * 2], sizeof(x));
+      for (int n = 0; n < 4; n++) {
+        acc[n] += x[n] * _kernel[k];
+      }
+    }
+    memcpy(&_y[j], acc, sizeof(acc));
   }
-  for (size_t i = 0; i < FILTER_LENGTH; i++) {
-    out += buf[(*pos)++] * filter_kernel[_channelNum][i];
-    if (*pos == FILTER_LENGTH) {
-      *pos = 0;
+}
+#else
+static void filter_convolve(const float *_kernel, const float *_x, float *_y, int _count) {
+  for (int j = 0; j < _count; j++) {
+    float acc = 0;
+    for (int k = 0; k < FILTER_LENGTH; k++) {
+      acc += _x[j + k * 2] * _kernel[k];
+    }
+    _y[j] = acc;
+  }
+}
+#endif
+
+/**
+ * Reads a routed channel's own blip buffer, filters it and adds it into _buf
+ */
+static void filter_mix(ChipContext *_ctx, const u8 _channelNum, ChipSample *_buf, int _len) {
+  struct filter *filter = &_ctx->filter[_channelNum];
+  float x[FILTER_HISTORY + FILTER_BLOCK * 2];
+  float y[FILTER_BLOCK * 2];
+  float faded[FILTER_BLOCK * 2];
+  s16 in[FILTER_BLOCK * 2];
+  while (_len > 0) {
+    int len = _len < FILTER_BLOCK ? _len : FILTER_BLOCK;
+    blip_stereo_read_samples(_ctx->channelBlipBuffer[_channelNum], in, len);
+    memcpy(x, filter->history, sizeof(filter->history));
+    for (int i = 0; i < len * 2; i++) {
+      x[FILTER_HISTORY + i] = in[i];
+    }
+    // Round up to whole vectors; the extra outputs are never used
+    int count = (len * 2 + FILTER_STEP - 1) & ~(FILTER_STEP - 1);
+    for (int i = FILTER_HISTORY + len * 2; i < FILTER_HISTORY + count; i++) {
+      x[i] = 0;
+    }
+    filter_convolve(filter->kernel, x, y, count);
+    if (filter->fadeLeft > 0) {
+      int fadeLength = filter->fadeLeft < len ? filter->fadeLeft : len;
+      filter_convolve(filter->fadeKernel, x, faded, (fadeLength * 2 + FILTER_STEP - 1) & ~(FILTER_STEP - 1));
+      for (int i = 0; i < fadeLength; i++) {
+        const float weight = (float) (filter->fadeLeft - i) / FILTER_FADE;
+        y[i * 2] += (faded[i * 2] - y[i * 2]) * weight;
+        y[i * 2 + 1] += (faded[i * 2 + 1] - y[i * 2 + 1]) * weight;
+      }
+      filter->fadeLeft -= fadeLength;
+    }
+    for (int i = 0; i < len; i++) {
+      int left = _buf[i].left + (int) y[i * 2];
+      int right = _buf[i].right + (int) y[i * 2 + 1];
+      _buf[i].left = left < INT16_MIN ? INT16_MIN : (left > INT16_MAX ? INT16_MAX : left);
+      _buf[i].right = right < INT16_MIN ? INT16_MIN : (right > INT16_MAX ? INT16_MAX : right);
     }
+    memcpy(filter->history, &x[len * 2], sizeof(filter->history));
+    _buf += len;
+    _len -= len;
   }
-  return (s16) out;
 }
 
-static void readsong(int pos, int ch, u8 *dest) {
-  dest[0] = song[pos].track[ch];
-  dest[1] = song[pos].transp[ch];
+static void readsong(ChipContext *_ctx, int pos, int ch, u8 *dest) {
+  dest[0] = _ctx->song[pos].track[ch];
+  dest[1] = _ctx->song[pos].transp[ch];
 }
 
-static void readtrack(int num, int pos, struct PatternLine *tl) {
-  tl->note = track[num].line[pos].note;
-  tl->instr = track[num].line[pos].instr;
-  tl->cmd[0] = track[num].line[pos].cmd[0];
-  tl->cmd[1] = track[num].line[pos].cmd[1];
-  tl->param[0] = track[num].line[pos].param[0];
-  tl->param[1] = track[num].line[pos].param[1];
+static void readtrack(ChipContext *_ctx, int num, int pos, struct PatternLine *tl) {
+  tl->note = _ctx->track[num].line[pos].note;
+  tl->instr = _ctx->track[num].line[pos].instr;
+  tl->cmd[0] = _ctx->track[num].line[pos].cmd[0];
+  tl->cmd[1] = _ctx->track[num].line[pos].cmd[1];
+  tl->param[0] = _ctx->track[num].line[pos].param[0];
+  tl->param[1] = _ctx->track[num].line[pos].param[1];
 }
 
-static void readinstr(int num, int pos, u8 *il) {
-  if (pos >= instrument[num].length) {
+static void readinstr(ChipContext *_ctx, int num, int pos, u8 *il) {
+  if (pos >= _ctx->instrument[num].length) {
     il[0] = 0;
     il[1] = 0;
   } else {
-    il[0] = instrument[num].line[pos].cmd;
-    il[1] = instrument[num].line[pos].param;
+    il[0] = _ctx->instrument[num].line[pos].cmd;
+    il[1] = _ctx->instrument[num].line[pos].param;
+  }
+}
+
+/**
+ * Makes every oscillator rebuild its level tables after a wave table change
+ */
+static void invalidateLevels(ChipContext *_ctx) {
+  for (size_t i = 0; i < NUM_CHANNELS; i++) {
+    _ctx->osc[i].levelsValid = false;
   }
 }
 
-static void silence() {
+static void silence(ChipContext *_ctx) {
   u8 i;
   for (i = 0; i < 4; i++) {
-    osc[i].volume = 0;
-    channel[i].volumeTable = 0;
-    channel[i].volumed = 0;
+    _ctx->osc[i].volume = 0;
+    _ctx->channel[i].volumeTable = 0;
+    _ctx->channel[i].volumed = 0;
   }
-  playsong = 0;
-  playtrack = 0;
+  _ctx->playsong = 0;
+  _ctx->playtrack = 0;
 }
 
-static void runcmd(u8 ch, u8 cmd, u8 param) {
+static void runcmd(ChipContext *_ctx, u8 ch, u8 cmd, u8 param) {
   switch (cmd) {
-    case 0:channel[ch].inum = 0;
+    case 0:_ctx->channel[ch].inum = 0;
       break;
     case 'd': // Duty
       if (param > 15) {
-        channel[ch].dutyTable = param >> 4;
+        _ctx->channel[ch].dutyTable = param >> 4;
         const u8 stretch = param & 0xf;
-        channel[ch].dutyStretch = stretch;
-        channel[ch].dutyStretchCounter = stretch;
-        channel[ch].dutyPtr = 0;
+        _ctx->channel[ch].dutyStretch = stretch;
+        _ctx->channel[ch].dutyStretchCounter = stretch;
+        _ctx->channel[ch].dutyPtr = 0;
       } else {
-        channel[ch].dutyTable = 0;
-        osc[ch].duty = param;
+        _ctx->channel[ch].dutyTable = 0;
+        _ctx->osc[ch].duty = param;
       }
       break;
     case 'f': // Fade
-      channel[ch].volumed = param;
+      _ctx->channel[ch].volumed = param;
       break;
     case 'h': // High filter
-      channel[ch].filterHigh = param;
-      filter_setFreqs(ch, channel[ch].filterHigh, channel[ch].filterLow);
+      _ctx->channel[ch].filterHigh = param;
+      filter_setFreqs(_ctx, ch, _ctx->channel[ch].filterLow, _ctx->channel[ch].filterHigh);
       break;
     case 'i': // Inertia
-      channel[ch].inertia = param << 1;
+      _ctx->channel[ch].inertia = param << 1;
       break;
     case 'j': // Jump
-      channel[ch].iptr = param;
+      _ctx->channel[ch].iptr = param;
       break;
     case 'l': // Low filter
-      channel[ch].filterLow = param;
-      filter_setFreqs(ch, channel[ch].filterHigh, channel[ch].filterLow);
+      _ctx->channel[ch].filterLow = param;
+      filter_setFreqs(_ctx, ch, _ctx->channel[ch].filterLow, _ctx->channel[ch].filterHigh);
       break;
     case 'o': // vibratO
-      if (channel[ch].vdepth != (param >> 4)) {
-        channel[ch].vpos = 0;
+      if (_ctx->channel[ch].vdepth != (param >> 4)) {
+        _ctx->channel[ch].vpos = 0;
       }
-      channel[ch].vdepth = param >> 4;
-      channel[ch].vrate = param & 15;
+      _ctx->channel[ch].vdepth = param >> 4;
+      _ctx->channel[ch].vrate = param & 15;
       break;
     case 'p': // Pan
       if (param > 15) {
-        channel[ch].panTable = param >> 4;
+        _ctx->channel[ch].panTable = param >> 4;
         const u8 stretch = param & 0xf;
-        channel[ch].panStretch = stretch;
-        channel[ch].panStretchCounter = stretch;
-        channel[ch].panPtr = 0;
+        _ctx->channel[ch].panStretch = stretch;
+        _ctx->channel[ch].panStretchCounter = stretch;
+        _ctx->channel[ch].panPtr = 0;
       } else {
-        channel[ch].panTable = 0;
-        osc[ch].pan = param;
+        _ctx->channel[ch].panTable = 0;
+        _ctx->osc[ch].pan = param;
       }
       break;
     case 's': // Slide
-      channel[ch].bendd = param;
+      _ctx->channel[ch].bendd = param;
       break;
     case 't': // wait xx Time units
-      channel[ch].iwait = param;
+      _ctx->channel[ch].iwait = param;
       break;
     case 'v': // Volume
       if (param > 15) {
         const u8 table = param >> 4;
-        channel[ch].volumeTable = table;
+        _ctx->channel[ch].volumeTable = table;
         const u8 stretch = param & 0xf;
-        channel[ch].volumeStretch = stretch;
-        channel[ch].volumeStretchCounter = stretch;
-        channel[ch].volumePtr = 0;
-        osc[ch].volume = volumeTable[table].column[0] << 4;
+        _ctx->channel[ch].volumeStretch = stretch;
+        _ctx->channel[ch].volumeStretchCounter = stretch;
+        _ctx->channel[ch].volumePtr = 0;
+        _ctx->osc[ch].volume = _ctx->volumeTable[table].column[0] << 4;
       } else {
-        channel[ch].volumeTable = 0;
-        osc[ch].volume = param << 4;
+        _ctx->channel[ch].volumeTable = 0;
+        _ctx->osc[ch].volume = param << 4;
       }
       break;
     case 'w': // Waveform
-      osc[ch].waveform = param;
+      _ctx->osc[ch].waveform = param;
       break;
     case '+': // Relative note
-      channel[ch].inote = param + channel[ch].tnote - 12 * 4;
+      _ctx->channel[ch].inote = param + _ctx->channel[ch].tnote - 12 * 4;
       break;
     case '=': // Absolute note
-      channel[ch].inote = param;
+      _ctx->channel[ch].inote = param;
       break;
   } /* switch */
 } /* runcmd */
 
-static void startplaytrack(int t) {
-  channel[0].tnum = t;
-  channel[1].tnum = 0;
-  channel[2].tnum = 0;
-  channel[3].tnum = 0;
-  trackpos = 0;
-  trackwait = 0;
-  playtrack = 1;
-  playsong = 0;
+static void startplaytrack(ChipContext *_ctx, int t) {
+  _ctx->channel[0].tnum = t;
+  _ctx->channel[1].tnum = 0;
+  _ctx->channel[2].tnum = 0;
+  _ctx->channel[3].tnum = 0;
+  _ctx->trackpos = 0;
+  _ctx->trackwait = 0;
+  _ctx->playtrack = 1;
+  _ctx->playsong = 0;
 }
 
-static void startplaysong(int p) {
-  songpos = p;
-  trackpos = 0;
-  trackwait = 0;
-  playtrack = 0;
-  playsong = 1;
+static void startplaysong(ChipContext *_ctx, int p) {
+  chip_loopReset(&_ctx->loopDetector);
+  _ctx->songpos = p;
+  _ctx->trackpos = 0;
+  _ctx->trackwait = 0;
+  _ctx->playtrack = 0;
+  _ctx->playsong = 1;
 }
 
-static void playroutine() { // called at 50 Hz
+static void playroutine(ChipContext *_ctx) { // called at 50 Hz
   u8 ch;
-  if (playtrack || playsong) {
-    if (trackwait) {
-      trackwait--;
+  if (_ctx->playtrack || _ctx->playsong) {
+    if (_ctx->trackwait) {
+      _ctx->trackwait--;
     } else {
-      trackwait = sTempo;
-      if (!trackpos) {
-        if (playsong) {
-          if (songpos >= songlen) {
-            songpos = 0;
-            trackpos = 0;
+      _ctx->trackwait = _ctx->tempo;
+      if (!_ctx->trackpos) {
+        if (_ctx->playsong) {
+          if (_ctx->songpos >= _ctx->songlen) {
+            _ctx->songpos = 0;
+            _ctx->trackpos = 0;
 
             // playsong = 0;
           }
+          chip_loopVisit(&_ctx->loopDetector, &_ctx->songpos, sizeof(_ctx->songpos));
           for (ch = 0; ch < 4; ch++) {
             u8 tmp[2];
 
-            readsong(songpos, ch, tmp);
-            channel[ch].tnum = tmp[0];
-            channel[ch].transp = tmp[1];
+            readsong(_ctx, _ctx->songpos, ch, tmp);
+            _ctx->channel[ch].tnum = tmp[0];
+            _ctx->channel[ch].transp = tmp[1];
           }
-          songpos++;
+          _ctx->songpos++;
         }
       }
-      if (playtrack || playsong) {
+      if (_ctx->playtrack || _ctx->playsong) {
         for (ch = 0; ch < 4; ch++) {
-          if (channel[ch].tnum) {
+          if (_ctx->channel[ch].tnum) {
             struct PatternLine tl;
             u8 instr = 0;
 
-            readtrack(channel[ch].tnum, trackpos, &tl);
+            readtrack(_ctx, _ctx->channel[ch].tnum, _ctx->trackpos, &tl);
             if (tl.note == 255) {
               // Note cut
-              channel[ch].volumeTable = 0;
-              osc[ch].volume = 0;
-              channel[ch].volumed = 0;
+              _ctx->channel[ch].volumeTable = 0;
+              _ctx->osc[ch].volume = 0;
+              _ctx->channel[ch].volumed = 0;
             } else if (tl.note) {
-              channel[ch].tnote = tl.note + channel[ch].transp;
-              instr = channel[ch].lastinstr;
+              _ctx->channel[ch].tnote = tl.note + _ctx->channel[ch].transp;
+              instr = _ctx->channel[ch].lastinstr;
               if (tl.instr) {
                 instr = tl.instr;
               }
               if (instr) {
-                channel[ch].lastinstr = instr;
-                channel[ch].inum = instr;
-                channel[ch].iptr = 0;
-                channel[ch].iwait = 0;
-                channel[ch].bend = 0;
-                channel[ch].bendd = 0;
-                channel[ch].volumed = 0;
-                channel[ch].vdepth = 0;
+                _ctx->channel[ch].lastinstr = instr;
+                _ctx->channel[ch].inum = instr;
+                _ctx->channel[ch].iptr = 0;
+                _ctx->channel[ch].iwait = 0;
+                _ctx->channel[ch].bend = 0;
+                _ctx->channel[ch].bendd = 0;
+                _ctx->channel[ch].volumed = 0;
+                _ctx->channel[ch].vdepth = 0;
               }
               if (tl.cmd[0]) {
-                runcmd(ch, tl.cmd[0], tl.param[0]);
+                runcmd(_ctx, ch, tl.cmd[0], tl.param[0]);
               }
               /*if(tl.cmd[1])
-                runcmd(ch, tl.cmd[1], tl.param[1]);*/
+                runcmd(_ctx, ch, tl.cmd[1], tl.param[1]);*/
             }
           }
         }
-        trackpos++;
-        trackpos &= 31;
+        _ctx->trackpos++;
+        _ctx->trackpos &= 31;
       }
     }
   }
   for (ch = 0; ch < NUM_CHANNELS; ch++) {
     s16 vol;
     u16 slur;
-    while (channel[ch].inum && !channel[ch].iwait) {
+    while (_ctx->channel[ch].inum && !_ctx->channel[ch].iwait) {
       u8 il[2];
 
-      readinstr(channel[ch].inum, channel[ch].iptr, il);
-      channel[ch].iptr++;
+      readinstr(_ctx, _ctx->channel[ch].inum, _ctx->channel[ch].iptr, il);
+      _ctx->channel[ch].iptr++;
 
-      runcmd(ch, il[0], il[1]);
+      runcmd(_ctx, ch, il[0], il[1]);
     }
-    if (channel[ch].iwait) {
-      channel[ch].iwait--;
+    if (_ctx->channel[ch].iwait) {
+      _ctx->channel[ch].iwait--;
     }
-    if (channel[ch].inertia) {
+    if (_ctx->channel[ch].inertia) {
       s16 diff;
 
-      slur = channel[ch].slur;
-      diff = waveStep[channel[ch].inote] - slur;
+      slur = _ctx->channel[ch].slur;
+      diff = tables_p1xlWaveStep[_ctx->channel[ch].inote] - slur;
       // diff >>= channel[ch].inertia;
       if (diff > 0) {
-        if (diff > channel[ch].inertia) {
-          diff = channel[ch].inertia;
+        if (diff > _ctx->channel[ch].inertia) {
+          diff = _ctx->channel[ch].inertia;
         }
       } else if (diff < 0) {
-        if (diff < -channel[ch].inertia) {
-          diff = -channel[ch].inertia;
+        if (diff < -_ctx->channel[ch].inertia) {
+          diff = -_ctx->channel[ch].inertia;
         }
       }
       slur += diff;
-      channel[ch].slur = slur;
+      _ctx->channel[ch].slur = slur;
     } else {
-      slur = waveStep[channel[ch].inote];
+      slur = tables_p1xlWaveStep[_ctx->channel[ch].inote];
     }
-    osc[ch].freq = slur + channel[ch].bend + ((channel[ch].vdepth * sinetable[channel[ch].vpos & 63]) >> 2);
-    channel[ch].bend += channel[ch].bendd << 3;
-    if (channel[ch].volumeTable == 0) {
-      vol = osc[ch].volume + channel[ch].volumed;
+    _ctx->osc[ch].freq = slur + _ctx->channel[ch].bend +
+                         ((_ctx->channel[ch].vdepth * sinetable[_ctx->channel[ch].vpos & 63]) >> 2);
+    _ctx->channel[ch].bend += _ctx->channel[ch].bendd << 3;
+    if (_ctx->channel[ch].volumeTable == 0) {
+      vol = _ctx->osc[ch].volume + _ctx->channel[ch].volumed;
       if (vol < 0) {
         vol = 0;
       }
       if (vol > 255) {
         vol = 255;
       }
-      osc[ch].volume = vol;
+      _ctx->osc[ch].volume = vol;
     } else {
-      if (channel[ch].volumeStretchCounter > 0) {
-        channel[ch].volumeStretchCounter--;
+      if (_ctx->channel[ch].volumeStretchCounter > 0) {
+        _ctx->channel[ch].volumeStretchCounter--;
       } else {
-        channel[ch].volumeStretchCounter = channel[ch].volumeStretch;
-        if (channel[ch].volumePtr < volumeTable[channel[ch].volumeTable].length - 1) {
-          channel[ch].volumePtr++;
-          osc[ch].volume = volumeTable[channel[ch].volumeTable].column[channel[ch].volumePtr] << 4;
+        _ctx->channel[ch].volumeStretchCounter = _ctx->channel[ch].volumeStretch;
+        if (_ctx->channel[ch].volumePtr < _ctx->volumeTable[_ctx->channel[ch].volumeTable].length - 1) {
+          _ctx->channel[ch].volumePtr++;
+          struct VolumeTable *table = &_ctx->volumeTable[_ctx->channel[ch].volumeTable];
+          _ctx->osc[ch].volume = table->column[_ctx->channel[ch].volumePtr] << 4;
         }
       }
     }
-    channel[ch].vpos += channel[ch].vrate;
+    _ctx->channel[ch].vpos += _ctx->channel[ch].vrate;
   }
 } /* playroutine */
 
@@ -492,58 +603,90 @@ static const char *getChipId() {
   return "P1XL";
 }
 
-static ChipError init() {
-  for (size_t i = 0; i < 2; i++) {
-    sBlipBuffer[i] = blip_new(SAMPLES_PER_PLAYROUTINE * 2);
-    blip_set_rates(sBlipBuffer[i], CLOCK_RATE, SAMPLE_RATE);
-    blip_clear(sBlipBuffer[i]);
+static ChipError shutdown(ChipContext *_ctx) {
+  blip_stereo_delete(_ctx->blipBuffer);
+  for (size_t i = 0; i < NUM_CHANNELS; i++) {
+    blip_stereo_delete(_ctx->channelBlipBuffer[i]);
+  }
+  free(_ctx->builtKernels);
+  free(_ctx);
+  return NO_ERR;
+}
+
+static ChipError init(ChipContext **_ctx, u32 _sampleRate) {
+  if (_sampleRate < CHIP_MIN_SAMPLE_RATE || _sampleRate > CHIP_MAX_SAMPLE_RATE) {
+    return ERR_NOT_SUPPORTED;
   }
-  trackwait = 0;
-  trackpos = 0;
-  playsong = 0;
-  playtrack = 0;
+  ChipContext *ctx = calloc(1, sizeof(ChipContext));
+  if (!ctx) {
+    return ERR_OUT_OF_MEMORY;
+  }
+  ctx->sampleRate = _sampleRate;
+  // Room for two playroutines' worth of samples
+  const int blipSize = _sampleRate / 60 * 2;
+  ctx->blipBuffer = blip_stereo_new(blipSize);
+  if (!ctx->blipBuffer) {
+    shutdown(ctx);
+    return ERR_OUT_OF_MEMORY;
+  }
+  blip_stereo_set_rates(ctx->blipBuffer, CLOCK_RATE, _sampleRate);
+  blip_stereo_clear(ctx->blipBuffer);
   for (size_t i = 0; i < NUM_CHANNELS; i++) {
-    osc[i].volume = 0;
-    osc[i].buzzseed = 1;
-    osc[i].pan = 8;
-    channel[i].inum = 0;
-    channel[i].filterLow = 0;
-    channel[i].filterHigh = 255;
+    ctx->channelBlipBuffer[i] = blip_stereo_new(blipSize);
+    if (!ctx->channelBlipBuffer[i]) {
+      shutdown(ctx);
+      return ERR_OUT_OF_MEMORY;
+    }
+    blip_stereo_set_rates(ctx->channelBlipBuffer[i], CLOCK_RATE, _sampleRate);
+    blip_stereo_clear(ctx->channelBlipBuffer[i]);
+  }
+  ChipError error = filter_init(ctx);
+  if (error != NO_ERR) {
+    shutdown(ctx);
+    return error;
+  }
+  ctx->songlen = 1;
+  ctx->tempo = 6;
+  ctx->trackwait = 0;
+  ctx->trackpos = 0;
+  ctx->playsong = 0;
+  ctx->playtrack = 0;
+  for (size_t i = 0; i < NUM_CHANNELS; i++) {
+    ctx->osc[i].volume = 0;
+    ctx->osc[i].buzzseed = 1;
+    ctx->osc[i].pan = 8;
+    ctx->channel[i].inum = 0;
+    ctx->channel[i].filterLow = 0;
+    ctx->channel[i].filterHigh = 255;
   }
   for (int i = 1; i < 256; i++) {
-    sprintf(instrument[i].name, "INSTR %02X", i);
-    instrument[i].length = 1;
-    instrument[i].line[0].cmd = '0';
-    instrument[i].line[0].param = 0;
+    sprintf(ctx->instrument[i].name, "INSTR %02X", i);
+    ctx->instrument[i].length = 1;
+    ctx->instrument[i].line[0].cmd = '0';
+    ctx->instrument[i].line[0].param = 0;
   }
   for (size_t i = 0; i < 16; i++) {
-    volumeTable[i].length = 1;
-    volumeTable[i].column[0] = 0;
+    ctx->volumeTable[i].length = 1;
+    ctx->volumeTable[i].column[0] = 0;
 
-    dutyTable[i].length = 1;
-    dutyTable[i].column[0] = 0;
+    ctx->dutyTable[i].length = 1;
+    ctx->dutyTable[i].column[0] = 0;
 
-    panTable[i].length = 1;
-    panTable[i].column[0] = 8;
+    ctx->panTable[i].length = 1;
+    ctx->panTable[i].column[0] = 8;
     for (size_t j = 0; j < 32; j++) {
-      waveTable[i][j] = 8;
+      ctx->waveTable[i][j] = 8;
     }
   }
+  *_ctx = ctx;
   return NO_ERR;
 } /* init */
 
-static ChipError shutdown() {
-  for (size_t j = 0; j < 2; j++) {
-    blip_delete(sBlipBuffer[j]);
-  }
-  return NO_ERR;
-}
-
-static ChipError newSong() {
+static ChipError newSong(ChipContext *_ctx) {
   return NO_ERR;
 }
 
-static ChipError loadSong(const char *_filename) {
+static ChipError loadSong(ChipContext *_ctx, const char *_filename) {
   FILE *f;
   char buf[1024];
   char str[1024];
@@ -551,13 +694,13 @@ static ChipError loadSong(const char *_filename) {
   int i1, i2, trk[4], transp[4], param[3], note, instr;
   int i;
 
-  snprintf(sFilename, sizeof(sFilename), "%s", _filename);
+  snprintf(_ctx->filename, sizeof(_ctx->filename), "%s", _filename);
 
   f = fopen(_filename, "r");
   if (!f) {
     return "Cannot load file.";
   }
-  songlen = 1;
+  _ctx->songlen = 1;
   while (!feof(f) && fgets(buf, sizeof(buf), f)) {
     if (9 == sscanf(buf, "song %x %x %x %x %x %x %x %x %x", &i1,
                     &trk[0], &transp[0],
@@ -565,55 +708,56 @@ static ChipError loadSong(const char *_filename) {
                     &trk[2], &transp[2],
                     &trk[3], &transp[3])) {
       for (i = 0; i < 4; i++) {
-        song[i1].track[i] = trk[i];
-        song[i1].transp[i] = transp[i];
+        _ctx->song[i1].track[i] = trk[i];
+        _ctx->song[i1].transp[i] = transp[i];
       }
-      if (songlen <= i1) {
-        songlen = i1 + 1;
+      if (_ctx->songlen <= i1) {
+        _ctx->songlen = i1 + 1;
       }
     } else if (8 == sscanf(buf, "pattern %x %x %x %x %x %x %x %x",
                            &i1, &i2,
                            &note, &instr,
                            &cmd[0], &param[0],
                            &cmd[1], &param[1])) {
-      track[i1].line[i2].note = note;
-      track[i1].line[i2].instr = instr;
+      _ctx->track[i1].line[i2].note = note;
+      _ctx->track[i1].line[i2].instr = instr;
       for (i = 0; i < 2; i++) {
-        track[i1].line[i2].cmd[i] = cmd[i];
-        track[i1].line[i2].param[i] = param[i];
+        _ctx->track[i1].line[i2].cmd[i] = cmd[i];
+        _ctx->track[i1].line[i2].param[i] = param[i];
       }
     } else if (2 == sscanf(buf, "instrumentName %x %255[^\n]s", &i1, str)) {
-      strncpy(instrument[i1].name, str, 255);
+      strncpy(_ctx->instrument[i1].name, str, 255);
     } else if (4 == sscanf(buf, "instrument %x %x %x %x", &i1, &i2, &cmd[0], &param[0])) {
-      instrument[i1].line[i2].cmd = cmd[0];
-      instrument[i1].line[i2].param = param[0];
-      if (instrument[i1].length <= i2) {
-        instrument[i1].length = i2 + 1;
+      _ctx->instrument[i1].line[i2].cmd = cmd[0];
+      _ctx->instrument[i1].line[i2].param = param[0];
+      if (_ctx->instrument[i1].length <= i2) {
+        _ctx->instrument[i1].length = i2 + 1;
       }
     } else if (3 == sscanf(buf, "volume %x %x %x", &i1, &i2, &cmd[0])) {
-      volumeTable[i1].column[i2] = cmd[0];
-      if (volumeTable[i1].length <= i2) {
-        volumeTable[i1].length = i2 + 1;
+      _ctx->volumeTable[i1].column[i2] = cmd[0];
+      if (_ctx->volumeTable[i1].length <= i2) {
+        _ctx->volumeTable[i1].length = i2 + 1;
       }
     } else if (3 == sscanf(buf, "duty %x %x %x", &i1, &i2, &cmd[0])) {
-      dutyTable[i1].column[i2] = cmd[0];
-      if (dutyTable[i1].length <= i2) {
-        dutyTable[i1].length = i2 + 1;
+      _ctx->dutyTable[i1].column[i2] = cmd[0];
+      if (_ctx->dutyTable[i1].length <= i2) {
+        _ctx->dutyTable[i1].length = i2 + 1;
       }
     } else if (3 == sscanf(buf, "pan %x %x %x", &i1, &i2, &cmd[0])) {
-      panTable[i1].column[i2] = cmd[0];
-      if (panTable[i1].length <= i2) {
-        panTable[i1].length = i2 + 1;
+      _ctx->panTable[i1].column[i2] = cmd[0];
+      if (_ctx->panTable[i1].length <= i2) {
+        _ctx->panTable[i1].length = i2 + 1;
       }
     } else if (3 == sscanf(buf, "wave %x %x %x", &i1, &i2, &cmd[0])) {
-      waveTable[i1][i2] = cmd[0];
+      _ctx->waveTable[i1][i2] = cmd[0];
     }
   }
   fclose(f);
+  invalidateLevels(_ctx);
   return NO_ERR;
 } /* loadSong */
 
-static ChipError saveSong(const char *filename) {
+static ChipError saveSong(ChipContext *_ctx, const char *filename) {
   FILE *f;
   int i, j;
 
@@ -624,17 +768,17 @@ static ChipError saveSong(const char *filename) {
   fprintf(f, "musicchip tune\n");
   fprintf(f, "version 1\n");
   fprintf(f, "\n");
-  for (i = 0; i < songlen; i++) {
+  for (i = 0; i < _ctx->songlen; i++) {
     fprintf(f, "song %02x %02x %02x %02x %02x %02x %02x %02x %02x\n", i,
-            song[i].track[0], song[i].transp[0],
-            song[i].track[1], song[i].transp[1],
-            song[i].track[2], song[i].transp[2],
-            song[i].track[3], song[i].transp[3]);
+            _ctx->song[i].track[0], _ctx->song[i].transp[0],
+            _ctx->song[i].track[1], _ctx->song[i].transp[1],
+            _ctx->song[i].track[2], _ctx->song[i].transp[2],
+            _ctx->song[i].track[3], _ctx->song[i].transp[3]);
   }
   fprintf(f, "\n");
   for (i = 1; i < 256; i++) {
     for (j = 0; j < PATTERN_LEN; j++) {
-      struct PatternLine *tl = &track[i].line[j];
+      struct PatternLine *tl = &_ctx->track[i].line[j];
       if (tl->note || tl->instr || tl->cmd[0] || tl->cmd[1]) {
         fprintf(f, "pattern %02x %02x %02x %02x %02x %02x %02x %02x\n", i, j,
                 tl->note, tl->instr,
@@ -645,35 +789,35 @@ static ChipError saveSong(const char *filename) {
   }
   fprintf(f, "\n");
   for (i = 1; i < 256; i++) {
-    if (instrument[i].length > 1) {
-      fprintf(f, "instrumentName %02x %s\n", i, instrument[i].name);
-      for (j = 0; j < instrument[i].length; j++) {
+    if (_ctx->instrument[i].length > 1) {
+      fprintf(f, "instrumentName %02x %s\n", i, _ctx->instrument[i].name);
+      for (j = 0; j < _ctx->instrument[i].length; j++) {
         fprintf(f, "instrument %02x %02x %02x %02x \n", i, j,
-                instrument[i].line[j].cmd, instrument[i].line[j].param);
+                _ctx->instrument[i].line[j].cmd, _ctx->instrument[i].line[j].param);
       }
     }
   }
   fprintf(f, "\n");
   for (i = 1; i < 16; i++) {
-    if (volumeTable[i].length > 1) {
-      for (j = 0; j < volumeTable[i].length; j++) {
-        fprintf(f, "volume %02x %02x %02x\n", i, j, volumeTable[i].column[j]);
+    if (_ctx->volumeTable[i].length > 1) {
+      for (j = 0; j < _ctx->volumeTable[i].length; j++) {
+        fprintf(f, "volume %02x %02x %02x\n", i, j, _ctx->volumeTable[i].column[j]);
       }
     }
   }
   fprintf(f, "\n");
   for (i = 1; i < 16; i++) {
-    if (dutyTable[i].length > 1) {
-      for (j = 0; j < dutyTable[i].length; j++) {
-        fprintf(f, "duty %02x %02x %02x\n", i, j, dutyTable[i].column[j]);
+    if (_ctx->dutyTable[i].length > 1) {
+      for (j = 0; j < _ctx->dutyTable[i].length; j++) {
+        fprintf(f, "duty %02x %02x %02x\n", i, j, _ctx->dutyTable[i].column[j]);
       }
     }
   }
   fprintf(f, "\n");
   for (i = 1; i < 16; i++) {
-    if (panTable[i].length > 1) {
-      for (j = 0; j < panTable[i].length; j++) {
-        fprintf(f, "pan %02x %02x %02x\n", i, j, panTable[i].column[j]);
+    if (_ctx->panTable[i].length > 1) {
+      for (j = 0; j < _ctx->panTable[i].length; j++) {
+        fprintf(f, "pan %02x %02x %02x\n", i, j, _ctx->panTable[i].column[j]);
       }
     }
   }
@@ -681,14 +825,14 @@ static ChipError saveSong(const char *filename) {
   for (i = 1; i < 16; i++) {
     bool used = false;
     for (j = 0; j < 32; j++) {
-      if (waveTable[i][j] != 8) {
+      if (_ctx->waveTable[i][j] != 8) {
         used = true;
         break;
       }
     }
     if (used) {
       for (j = 0; j < 32; j++) {
-        fprintf(f, "wave %02x %02x %02x\n", i, j, waveTable[i][j]);
+        fprintf(f, "wave %02x %02x %02x\n", i, j, _ctx->waveTable[i][j]);
       }
     }
   }
@@ -696,61 +840,61 @@ static ChipError saveSong(const char *filename) {
   return NO_ERR;
 } /* saveSong */
 
-static ChipError insertSongRow(u8 _channelNum, u8 _atSongRow) {
-  if (songlen < 256) {
-    memmove(&song[_atSongRow + 1],
-            &song[_atSongRow + 0],
-            sizeof(struct SongLine) * (songlen - _atSongRow));
-    songlen++;
-    memset(&song[_atSongRow], 0, sizeof(struct SongLine));
+static ChipError insertSongRow(ChipContext *_ctx, u8 _channelNum, u8 _atSongRow) {
+  if (_ctx->songlen < 256) {
+    memmove(&_ctx->song[_atSongRow + 1],
+            &_ctx->song[_atSongRow + 0],
+            sizeof(struct SongLine) * (_ctx->songlen - _atSongRow));
+    _ctx->songlen++;
+    memset(&_ctx->song[_atSongRow], 0, sizeof(struct SongLine));
     return NO_ERR;
   } else {
     return "Song is full.";
   }
 }
 
-static ChipError addSongRow() {
-  if (songlen < 256) {
-    memset(&song[songlen], 0, sizeof(struct SongLine));
-    songlen++;
+static ChipError addSongRow(ChipContext *_ctx) {
+  if (_ctx->songlen < 256) {
+    memset(&_ctx->song[_ctx->songlen], 0, sizeof(struct SongLine));
+    _ctx->songlen++;
     return NO_ERR;
   } else {
     return "Song is full.";
   }
 }
 
-static ChipError deleteSongRow(u8 _channelNum, u8 _songRow) {
-  if (songlen > 1) {
-    memmove(&song[_songRow + 0],
-            &song[_songRow + 1],
-            sizeof(struct SongLine) * (songlen - _songRow - 1));
-    songlen--;
+static ChipError deleteSongRow(ChipContext *_ctx, u8 _channelNum, u8 _songRow) {
+  if (_ctx->songlen > 1) {
+    memmove(&_ctx->song[_songRow + 0],
+            &_ctx->song[_songRow + 1],
+            sizeof(struct SongLine) * (_ctx->songlen - _songRow - 1));
+    _ctx->songlen--;
   }
   return NO_ERR;
 }
 
-static ChipError insertPatternRow(u8 _channelNum, u8 _patternNum, u8 _atPatternRow) {
-  memmove(&(track[_patternNum].line[_atPatternRow + 1]),
-          &(track[_patternNum].line[_atPatternRow + 0]),
+static ChipError insertPatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _atPatternRow) {
+  memmove(&(_ctx->track[_patternNum].line[_atPatternRow + 1]),
+          &(_ctx->track[_patternNum].line[_atPatternRow + 0]),
           sizeof(struct PatternLine) * (PATTERN_LEN - _atPatternRow));
-  memset(&(track[_patternNum].line[_atPatternRow]), 0, sizeof(struct PatternLine));
+  memset(&(_ctx->track[_patternNum].line[_atPatternRow]), 0, sizeof(struct PatternLine));
   return NO_ERR;
 }
 
-static ChipError addPatternRow(u8 _channelNum, u8 _patternNum) {
+static ChipError addPatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum) {
   return NO_ERR;
 }
 
-static ChipError deletePatternRow(u8 _channelNum, u8 _patternNum, u8 _patternRow) {
-  memmove(&(track[_patternNum].line[_patternRow + 0]),
-          &(track[_patternNum].line[_patternRow + 1]),
+static ChipError deletePatternRow(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow) {
+  memmove(&(_ctx->track[_patternNum].line[_patternRow + 0]),
+          &(_ctx->track[_patternNum].line[_patternRow + 1]),
           sizeof(struct PatternLine) * (PATTERN_LEN - _patternRow - 1));
-  memset(&(track[_patternNum].line[PATTERN_LEN - 1]), 0, sizeof(struct PatternLine));
+  memset(&(_ctx->track[_patternNum].line[PATTERN_LEN - 1]), 0, sizeof(struct PatternLine));
   return NO_ERR;
 }
 
-static ChipError insertInstrumentRow(u8 _instrument, u8 _atInstrumentRow) {
-  struct Instrument *in = &instrument[_instrument];
+static ChipError insertInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _atInstrumentRow) {
+  struct Instrument *in = &_ctx->instrument[_instrument];
   if (in->length < 256) {
     memmove(&in->line[_atInstrumentRow + 1],
             &in->line[_atInstrumentRow + 0],
@@ -764,8 +908,8 @@ static ChipError insertInstrumentRow(u8 _instrument, u8 _atInstrumentRow) {
   }
 }
 
-static ChipError addInstrumentRow(u8 _instrument) {
-  struct Instrument *in = &instrument[_instrument];
+static ChipError addInstrumentRow(ChipContext *_ctx, u8 _instrument) {
+  struct Instrument *in = &_ctx->instrument[_instrument];
   if (in->length < 256) {
     in->line[in->length].cmd = '0';
     in->line[in->length].param = 0;
@@ -776,8 +920,8 @@ static ChipError addInstrumentRow(u8 _instrument) {
   }
 }
 
-static ChipError deleteInstrumentRow(u8 _instrument, u8 _instrumentRow) {
-  struct Instrument *in = &instrument[_instrument];
+static ChipError deleteInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow) {
+  struct Instrument *in = &_ctx->instrument[_instrument];
   if (in->length > 1) {
     memmove(&in->line[_instrumentRow + 0],
             &in->line[_instrumentRow + 1],
@@ -787,11 +931,11 @@ static ChipError deleteInstrumentRow(u8 _instrument, u8 _instrumentRow) {
   return NO_ERR;
 }
 
-static ChipError insertTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
+static ChipError insertTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn) {
   switch (_tableKind) {
     case 0: // VOLUME
     {
-      struct VolumeTable *t = &volumeTable[_table];
+      struct VolumeTable *t = &_ctx->volumeTable[_table];
       if (t->length < 256) {
         memmove(&t->column[_atColumn + 1],
                 &t->column[_atColumn + 0],
@@ -806,7 +950,7 @@ static ChipError insertTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
 
     case 1: // DUTY
     {
-      struct DutyTable *t = &dutyTable[_table];
+      struct DutyTable *t = &_ctx->dutyTable[_table];
       if (t->length < 256) {
         memmove(&t->column[_atColumn + 1],
                 &t->column[_atColumn + 0],
@@ -821,7 +965,7 @@ static ChipError insertTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
 
     case 2: // PAN
     {
-      struct PanTable *t = &panTable[_table];
+      struct PanTable *t = &_ctx->panTable[_table];
       if (t->length < 256) {
         memmove(&t->column[_atColumn + 1],
                 &t->column[_atColumn + 0],
@@ -840,11 +984,11 @@ static ChipError insertTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
   return NO_ERR;
 } /* insertTableColumn */
 
-static ChipError addTableColumn(u8 _tableKind, u8 _table) {
+static ChipError addTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table) {
   switch (_tableKind) {
     case 0: // VOLUME
     {
-      struct VolumeTable *t = &volumeTable[_table];
+      struct VolumeTable *t = &_ctx->volumeTable[_table];
       if (t->length < 256) {
         t->column[t->length] = 0;
         t->length++;
@@ -856,7 +1000,7 @@ static ChipError addTableColumn(u8 _tableKind, u8 _table) {
 
     case 1: // DUTY
     {
-      struct DutyTable *t = &dutyTable[_table];
+      struct DutyTable *t = &_ctx->dutyTable[_table];
       if (t->length < 256) {
         t->column[t->length] = 0;
         t->length++;
@@ -868,7 +1012,7 @@ static ChipError addTableColumn(u8 _tableKind, u8 _table) {
 
     case 2: // PAN
     {
-      struct PanTable *t = &panTable[_table];
+      struct PanTable *t = &_ctx->panTable[_table];
       if (t->length < 256) {
         t->column[t->length] = 0;
         t->length++;
@@ -884,11 +1028,11 @@ static ChipError addTableColumn(u8 _tableKind, u8 _table) {
   return NO_ERR;
 } /* addTableColumn */
 
-static ChipError deleteTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
+static ChipError deleteTableColumn(ChipContext *_ctx, u8 _tableKind, u8 _table, u8 _atColumn) {
   switch (_tableKind) {
     case 0: // VOLUME
     {
-      struct VolumeTable *t = &volumeTable[_table];
+      struct VolumeTable *t = &_ctx->volumeTable[_table];
       if (t->length > 1) {
         memmove(&t->column[_atColumn + 0],
                 &t->column[_atColumn + 1],
@@ -900,7 +1044,7 @@ static ChipError deleteTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
 
     case 1: // DUTY
     {
-      struct DutyTable *t = &dutyTable[_table];
+      struct DutyTable *t = &_ctx->dutyTable[_table];
       if (t->length > 1) {
         memmove(&t->column[_atColumn + 0],
                 &t->column[_atColumn + 1],
@@ -912,7 +1056,7 @@ static ChipError deleteTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
 
     case 2: // PAN
     {
-      struct PanTable *t = &panTable[_table];
+      struct PanTable *t = &_ctx->panTable[_table];
       if (t->length > 1) {
         memmove(&t->column[_atColumn + 0],
                 &t->column[_atColumn + 1],
@@ -928,85 +1072,85 @@ static ChipError deleteTableColumn(u8 _tableKind, u8 _table, u8 _atColumn) {
   return NO_ERR;
 } /* deleteTableColumn */
 
-static u8 getNumMetaData() {
+static u8 getNumMetaData(ChipContext *_ctx) {
   return 0;
 }
 
-static ChipMetaDataEntry *getMetaData(u8 _index) {
+static ChipMetaDataEntry *getMetaData(ChipContext *_ctx, u8 _index) {
   return NULL;
 }
 
-static ChipError setMetaData(u8 _index, ChipMetaDataEntry *entry) {
+static ChipError setMetaData(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry) {
   return NO_ERR;
 }
 
-static u8 getNumSaveOptions() {
+static u8 getNumSaveOptions(ChipContext *_ctx) {
   return 0;
 }
 
-static ChipMetaDataEntry *getSaveOptions(u8 _index) {
+static ChipMetaDataEntry *getSaveOptions(ChipContext *_ctx, u8 _index) {
   return NULL;
 }
 
-static ChipError setSaveOptions(u8 _index, ChipMetaDataEntry *entry) {
+static ChipError setSaveOptions(ChipContext *_ctx, u8 _index, ChipMetaDataEntry *entry) {
   return NO_ERR;
 }
 
-static u16 getNumSongRows() {
-  return songlen;
+static u16 getNumSongRows(ChipContext *_ctx) {
+  return _ctx->songlen;
 }
 
-static u8 getNumSongDataColumns(u8 _channelNum) {
+static u8 getNumSongDataColumns(ChipContext *_ctx, u8 _channelNum) {
   return 5;
 }
 
-static ChipDataType getSongDataType(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static ChipDataType getSongDataType(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   if (_songDataColumn == 2) {
     return CDT_LABEL;
   }
   return CDT_HEX;
 }
 
-static u8 getSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static u8 getSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
-    case 0:return GETHI(song[_songRow].track[_channelNum]);
-    case 1:return GETLO(song[_songRow].track[_channelNum]);
+    case 0:return GETHI(_ctx->song[_songRow].track[_channelNum]);
+    case 1:return GETLO(_ctx->song[_songRow].track[_channelNum]);
     case 2:return ':';
-    case 3:return GETHI(song[_songRow].transp[_channelNum]);
-    case 4:return GETLO(song[_songRow].transp[_channelNum]);
+    case 3:return GETHI(_ctx->song[_songRow].transp[_channelNum]);
+    case 4:return GETLO(_ctx->song[_songRow].transp[_channelNum]);
   }
   return 0;
 }
 
-static u8 clearSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static u8 clearSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   switch (_songDataColumn) {
-    case 0:return SETHI(song[_songRow].track[_channelNum], 0);
-    case 1:return SETLO(song[_songRow].track[_channelNum], 0);
-    case 3:return SETHI(song[_songRow].transp[_channelNum], 0);
-    case 4:return SETLO(song[_songRow].transp[_channelNum], 0);
+    case 0:return SETHI(_ctx->song[_songRow].track[_channelNum], 0);
+    case 1:return SETLO(_ctx->song[_songRow].track[_channelNum], 0);
+    case 3:return SETHI(_ctx->song[_songRow].transp[_channelNum], 0);
+    case 4:return SETLO(_ctx->song[_songRow].transp[_channelNum], 0);
   }
   return 0;
 }
 
-static u8 setSongData(u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data) {
+static u8 setSongData(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn, u8 _data) {
   switch (_songDataColumn) {
-    case 0:return SETHI(song[_songRow].track[_channelNum], _data);
-    case 1:return SETLO(song[_songRow].track[_channelNum], _data);
-    case 3:return SETHI(song[_songRow].transp[_channelNum], _data);
-    case 4:return SETLO(song[_songRow].transp[_channelNum], _data);
+    case 0:return SETHI(_ctx->song[_songRow].track[_channelNum], _data);
+    case 1:return SETLO(_ctx->song[_songRow].track[_channelNum], _data);
+    case 3:return SETHI(_ctx->song[_songRow].transp[_channelNum], _data);
+    case 4:return SETLO(_ctx->song[_songRow].transp[_channelNum], _data);
   }
   return _data;
 }
 
-static void setSongPattern(u8 _songRow, u8 _channelNum, u8 _pattern) {
-  song[_songRow].track[_channelNum] = _pattern;
+static void setSongPattern(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _pattern) {
+  _ctx->song[_songRow].track[_channelNum] = _pattern;
 }
 
-static u8 getNumChannels() {
+static u8 getNumChannels(ChipContext *_ctx) {
   return 4;
 }
 
-static const char *getChannelName(u8 _patternNum, u8 _width) {
+static const char *getChannelName(ChipContext *_ctx, u8 _patternNum, u8 _width) {
   static char buf[256];
   if (_width == 0) {
     _width = 255;
@@ -1016,26 +1160,27 @@ static const char *getChannelName(u8 _patternNum, u8 _width) {
   return (const char *) buf;
 }
 
-static u16 getNumPatterns() {
+static u16 getNumPatterns(ChipContext *_ctx) {
   return 256;
 }
 
-static u8 getPatternNum(u8 _songRow, u8 _channelNum) {
-  return song[_songRow].track[_channelNum];
+static u8 getPatternNum(ChipContext *_ctx, u8 _songRow, u8 _channelNum) {
+  return _ctx->song[_songRow].track[_channelNum];
 }
 
-static u8 getPatternLen(u8 patternNum) {
+static u8 getPatternLen(ChipContext *_ctx, u8 patternNum) {
   return PATTERN_LEN;
 }
 
-static u8 getNumPatternDataColumns(u8 _channelNum, u8 _patternNum, u8 _patternRow) {
+static u8 getNumPatternDataColumns(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow) {
   if (_patternNum == 0) {
     return 14;
   }
   return 12;
 }
 
-static ChipDataType getPatternDataType(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static ChipDataType getPatternDataType(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow,
+                                       u8 _patternColumn) {
   if (_patternNum == 0) {
     return CDT_LABEL;
   }
@@ -1065,21 +1210,21 @@ static ChipDataType getPatternDataType(u8 _channelNum, u8 _patternNum, u8 _patte
   }
 }
 
-static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static u8 getPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
   if (_patternNum == 0) {
     return ' ';
   }
   switch (_patternColumn) {
     // Note
-    case 0:return track[_patternNum].line[_patternRow].note;
+    case 0:return _ctx->track[_patternNum].line[_patternRow].note;
 
       // Instrument
-    case 2:return GETHI(track[_patternNum].line[_patternRow].instr);
-    case 3:return GETLO(track[_patternNum].line[_patternRow].instr);
+    case 2:return GETHI(_ctx->track[_patternNum].line[_patternRow].instr);
+    case 3:return GETLO(_ctx->track[_patternNum].line[_patternRow].instr);
 
       // Command 1
     case 5: {
-      int cmd = track[_patternNum].line[_patternRow].cmd[0];
+      int cmd = _ctx->track[_patternNum].line[_patternRow].cmd[0];
       if (cmd == 0) {
         return '.';
       }
@@ -1088,19 +1233,19 @@ static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _pat
 
       // Param
     case 6:
-      if (track[_patternNum].line[_patternRow].cmd[0] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[0] == 0) {
         return '.';
       }
-      return GETHI(track[_patternNum].line[_patternRow].param[0]);
+      return GETHI(_ctx->track[_patternNum].line[_patternRow].param[0]);
     case 7:
-      if (track[_patternNum].line[_patternRow].cmd[0] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[0] == 0) {
         return '.';
       }
-      return GETLO(track[_patternNum].line[_patternRow].param[0]);
+      return GETLO(_ctx->track[_patternNum].line[_patternRow].param[0]);
 
       // Command 2
     case 9: {
-      int cmd = track[_patternNum].line[_patternRow].cmd[1];
+      int cmd = _ctx->track[_patternNum].line[_patternRow].cmd[1];
       if (cmd == 0) {
         return '.';
       }
@@ -1109,138 +1254,139 @@ static u8 getPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _pat
 
       // Param
     case 10:
-      if (track[_patternNum].line[_patternRow].cmd[1] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[1] == 0) {
         return '.';
       }
-      return GETHI(track[_patternNum].line[_patternRow].param[1]);
+      return GETHI(_ctx->track[_patternNum].line[_patternRow].param[1]);
     case 11:
-      if (track[_patternNum].line[_patternRow].cmd[1] == 0) {
+      if (_ctx->track[_patternNum].line[_patternRow].cmd[1] == 0) {
         return '.';
       }
-      return GETLO(track[_patternNum].line[_patternRow].param[1]);
+      return GETLO(_ctx->track[_patternNum].line[_patternRow].param[1]);
 
     default:return ' ';
   } /* switch */
 }   /* getPatternData */
 
-static u8 clearPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static u8 clearPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
   if (_patternNum == 0) {
     return ' ';
   }
   u8 ret;
   switch (_patternColumn) {
     // Note
-    case 0:SETHI(track[_patternNum].line[_patternRow].instr, 0);
-      SETLO(track[_patternNum].line[_patternRow].instr, 0);
-      return track[_patternNum].line[_patternRow].note = 0;
+    case 0:SETHI(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      SETLO(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      return _ctx->track[_patternNum].line[_patternRow].note = 0;
 
       // Instrument
-    case 2:ret = SETHI(track[_patternNum].line[_patternRow].instr, 0);
-      if (track[_patternNum].line[_patternRow].instr == 0) {
-        track[_patternNum].line[_patternRow].note = 0;
+    case 2:ret = SETHI(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      if (_ctx->track[_patternNum].line[_patternRow].instr == 0) {
+        _ctx->track[_patternNum].line[_patternRow].note = 0;
       }
       return ret;
-    case 3:ret = SETLO(track[_patternNum].line[_patternRow].instr, 0);
-      if (track[_patternNum].line[_patternRow].instr == 0) {
-        track[_patternNum].line[_patternRow].note = 0;
+    case 3:ret = SETLO(_ctx->track[_patternNum].line[_patternRow].instr, 0);
+      if (_ctx->track[_patternNum].line[_patternRow].instr == 0) {
+        _ctx->track[_patternNum].line[_patternRow].note = 0;
       }
       return ret;
 
       // Command 1
-    case 5:track[_patternNum].line[_patternRow].param[0] = 0;
-      return track[_patternNum].line[_patternRow].cmd[0] = 0;
+    case 5:_ctx->track[_patternNum].line[_patternRow].param[0] = 0;
+      return _ctx->track[_patternNum].line[_patternRow].cmd[0] = 0;
 
       // Param
-    case 6:return SETHI(track[_patternNum].line[_patternRow].param[0], 0);
-    case 7:return SETLO(track[_patternNum].line[_patternRow].param[0], 0);
+    case 6:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[0], 0);
+    case 7:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[0], 0);
 
       // Command 1
-    case 9:track[_patternNum].line[_patternRow].param[1] = 0;
-      return track[_patternNum].line[_patternRow].cmd[1] = 0;
+    case 9:_ctx->track[_patternNum].line[_patternRow].param[1] = 0;
+      return _ctx->track[_patternNum].line[_patternRow].cmd[1] = 0;
 
       // Param
-    case 10:return SETHI(track[_patternNum].line[_patternRow].param[1], 0);
-    case 11:return SETLO(track[_patternNum].line[_patternRow].param[1], 0);
+    case 10:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[1], 0);
+    case 11:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[1], 0);
 
     default:return ' ';
   } /* switch */
 }   /* getPatternData */
 
-static u8 setPatternData(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn, u8 _instrument,
+static u8 setPatternData(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn,
+                         u8 _instrument,
                          u8 _data) {
   if (_patternNum == 0) {
     return ' ';
   }
   switch (_patternColumn) {
     // Note
-    case 0:track[_patternNum].line[_patternRow].instr = _instrument;
+    case 0:_ctx->track[_patternNum].line[_patternRow].instr = _instrument;
       if (_data == 255) {
-        return track[_patternNum].line[_patternRow].note = 255;
+        return _ctx->track[_patternNum].line[_patternRow].note = 255;
       } else {
-        return track[_patternNum].line[_patternRow].note = _data + 1;
+        return _ctx->track[_patternNum].line[_patternRow].note = _data + 1;
       }
       // Instrument
-    case 2:return SETHI(track[_patternNum].line[_patternRow].instr, _data);
-    case 3:return SETLO(track[_patternNum].line[_patternRow].instr, _data);
+    case 2:return SETHI(_ctx->track[_patternNum].line[_patternRow].instr, _data);
+    case 3:return SETLO(_ctx->track[_patternNum].line[_patternRow].instr, _data);
 
       // Command 1
-    case 5:return track[_patternNum].line[_patternRow].cmd[0] = _data;
+    case 5:return _ctx->track[_patternNum].line[_patternRow].cmd[0] = _data;
 
       // Param
-    case 6:return SETHI(track[_patternNum].line[_patternRow].param[0], _data);
-    case 7:return SETLO(track[_patternNum].line[_patternRow].param[0], _data);
+    case 6:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[0], _data);
+    case 7:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[0], _data);
 
       // Command 1
-    case 9:return track[_patternNum].line[_patternRow].cmd[1] = _data;
+    case 9:return _ctx->track[_patternNum].line[_patternRow].cmd[1] = _data;
 
       // Param
-    case 10:return SETHI(track[_patternNum].line[_patternRow].param[1], _data);
-    case 11:return SETLO(track[_patternNum].line[_patternRow].param[1], _data);
+    case 10:return SETHI(_ctx->track[_patternNum].line[_patternRow].param[1], _data);
+    case 11:return SETLO(_ctx->track[_patternNum].line[_patternRow].param[1], _data);
 
     default:return ' ';
   }
 } /* setPatternData */
 
-static u8 getMinOctave() {
+static u8 getMinOctave(ChipContext *_ctx) {
   return 0;
 }
 
-static u8 getMaxOctave() {
+static u8 getMaxOctave(ChipContext *_ctx) {
   return 7;
 }
 
-static const char *getInstrumentName(u8 _instrument, u8 _stringWidth) {
+static const char *getInstrumentName(ChipContext *_ctx, u8 _instrument, u8 _stringWidth) {
   static char buf[256];
   if (_stringWidth == 0) {
     _stringWidth = 255;
   }
-  strncpy(buf, instrument[_instrument].name, _stringWidth);
+  strncpy(buf, _ctx->instrument[_instrument].name, _stringWidth);
   buf[255] = 0;
   return (const char *) buf;
 }
 
-static void setInstrumentName(u8 _instrument, char *_instrName) {
-  strncpy(instrument[_instrument].name, _instrName, 255);
-  instrument[_instrument].name[255] = 0;
+static void setInstrumentName(ChipContext *_ctx, u8 _instrument, char *_instrName) {
+  strncpy(_ctx->instrument[_instrument].name, _instrName, 255);
+  _ctx->instrument[_instrument].name[255] = 0;
 }
 
-static u8 instrumentNameLength(u8 _instrument) {
+static u8 instrumentNameLength(ChipContext *_ctx, u8 _instrument) {
   return false;
 }
 
-static u16 getNumInstruments() {
+static u16 getNumInstruments(ChipContext *_ctx) {
   return 256;
 }
 
-static u8 getInstrumentLen(u8 _instrument) {
-  return instrument[_instrument].length;
+static u8 getInstrumentLen(ChipContext *_ctx, u8 _instrument) {
+  return _ctx->instrument[_instrument].length;
 }
 
-static u8 getNumInstrumentParams(u8 _instrument) {
+static u8 getNumInstrumentParams(ChipContext *_ctx, u8 _instrument) {
   return 2;
 }
 
-static const char *getInstrumentParamName(u8 _instrument, u8 _instrumentParam, u8 _stringWidth) {
+static const char *getInstrumentParamName(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _stringWidth) {
   if (_instrumentParam == 0) {
     return "CMD";
   }
@@ -1250,9 +1396,9 @@ static const char *getInstrumentParamName(u8 _instrument, u8 _instrumentParam, u
   return "";
 }
 
-static u8 getNumInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow) {
+static u8 getNumInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow) {
   if (_instrumentParam == 0) {
-    u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+    u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
     if (cmd == '+' || cmd == '=') {
       return 2;
     }
@@ -1262,13 +1408,13 @@ static u8 getNumInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrume
   }
 }
 
-static ChipDataType getInstrumentDataType(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+static ChipDataType getInstrumentDataType(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
                                           u8 _instrumentColumn) {
   if (_instrumentParam == 0) {
     if (_instrumentColumn == 0) {
       return CDT_ASCII;
     }
-    u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+    u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
     if (cmd == '+' || cmd == '=') {
       return CDT_NOTE;
     }
@@ -1278,26 +1424,28 @@ static ChipDataType getInstrumentDataType(u8 _instrument, u8 _instrumentParam, u
   }
 }
 
-static u8 getInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
+static u8 getInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                            u8 _instrumentColumn) {
   if (_instrumentParam == 0) {
-    u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+    u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
     if (_instrumentColumn == 0) {
       return toupper(cmd);
     }
     if (cmd == '+' || cmd == '=') {
-      return instrument[_instrument].line[_instrumentRow].param;
+      return _ctx->instrument[_instrument].line[_instrumentRow].param;
     }
     if (_instrumentColumn == 1) {
-      return GETHI(instrument[_instrument].line[_instrumentRow].param);
+      return GETHI(_ctx->instrument[_instrument].line[_instrumentRow].param);
     }
-    return GETLO(instrument[_instrument].line[_instrumentRow].param);
+    return GETLO(_ctx->instrument[_instrument].line[_instrumentRow].param);
   } else {
     return '0';
   }
 }
 
-static u8 clearInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
-  u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+static u8 clearInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                              u8 _instrumentColumn) {
+  u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
   if (_instrumentColumn == 0) {
     return 0;
   }
@@ -1312,9 +1460,10 @@ static u8 clearInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumen
 
 static char *validcmds = "0dfhijlopstvw+=";
 
-static bool setInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn,
+static bool setInstrumentData(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                              u8 _instrumentColumn,
                               u8 _data) {
-  u8 cmd = instrument[_instrument].line[_instrumentRow].cmd;
+  u8 cmd = _ctx->instrument[_instrument].line[_instrumentRow].cmd;
   if (_instrumentColumn == 0) {
     u8 ascii = _data;
     /*
@@ -1323,159 +1472,165 @@ static bool setInstrumentData(u8 _instrument, u8 _instrumentParam, u8 _instrumen
     }
     */
     if (strchr(validcmds, ascii) != 0) {
-      instrument[_instrument].line[_instrumentRow].cmd = tolower(_data);
+      _ctx->instrument[_instrument].line[_instrumentRow].cmd = tolower(_data);
       return true;
     } else {
       return false;
     }
   } else {
     if (cmd == '+' || cmd == '=') {
-      instrument[_instrument].line[_instrumentRow].param = _data + 1;
+      _ctx->instrument[_instrument].line[_instrumentRow].param = _data + 1;
       return true;
     } else {
       if (_instrumentColumn == 1) {
-        SETHI(instrument[_instrument].line[_instrumentRow].param, _data);
+        SETHI(_ctx->instrument[_instrument].line[_instrumentRow].param, _data);
         return true;
       } else {
-        SETLO(instrument[_instrument].line[_instrumentRow].param, _data);
+        SETLO(_ctx->instrument[_instrument].line[_instrumentRow].param, _data);
         return true;
       }
     }
   }
 }
 
-static void swapInstrumentRow(u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2) {
-  struct InstrumentLine temp = instrument[_instrument].line[_instrumentRow1];
-  instrument[_instrument].line[_instrumentRow1] = instrument[_instrument].line[_instrumentRow2];
-  instrument[_instrument].line[_instrumentRow2] = temp;
+static void swapInstrumentRow(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow1, u8 _instrumentRow2) {
+  struct InstrumentLine temp = _ctx->instrument[_instrument].line[_instrumentRow1];
+  _ctx->instrument[_instrument].line[_instrumentRow1] = _ctx->instrument[_instrument].line[_instrumentRow2];
+  _ctx->instrument[_instrument].line[_instrumentRow2] = temp;
 }
 
 // Tables
-static bool useTables() {
+static bool useTables(ChipContext *_ctx) {
   return true;
 }
 
-static u8 getNumTableKinds() {
+static u8 getNumTableKinds(ChipContext *_ctx) {
   return 4;
 }
 
-const char *getTableKindName(u8 _tableKind) {
+const char *getTableKindName(ChipContext *_ctx, u8 _tableKind) {
   static const char *kinds[] = {
       "VOLUME", "DUTY", "PAN", "WAVE"
   };
   return kinds[_tableKind];
 }
 
-static ChipTableStyle getTableStyle(u8 _tableKind) {
+static ChipTableStyle getTableStyle(ChipContext *_ctx, u8 _tableKind) {
   if (_tableKind < 2) {
     return CTS_BOTTOM;
   }
   return CTS_CENTER;
 }
 
-static u16 getMinTable(u8 _tableKind) {
+static u16 getMinTable(ChipContext *_ctx, u8 _tableKind) {
   return 1;
 }
 
-static u16 getNumTables(u8 _tableKind) {
+static u16 getNumTables(ChipContext *_ctx, u8 _tableKind) {
   return 16;
 }
 
-static u8 getTableDataLen(u8 _tableKind, u16 _table) {
+static u8 getTableDataLen(ChipContext *_ctx, u8 _tableKind, u16 _table) {
   switch (_tableKind) {
     case 0: // VOLUME
-      return volumeTable[_table].length;
+      return _ctx->volumeTable[_table].length;
     case 1: // DUTY
-      return dutyTable[_table].length;
+      return _ctx->dutyTable[_table].length;
     case 2: // PAN
-      return panTable[_table].length;
+      return _ctx->panTable[_table].length;
     case 3: // WAVE
       return 32;
   }
   return 0;
 }
 
-static u8 getTableData(u8 _tableKind, u16 _table, u8 _tableColumn) {
+static u8 getTableData(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn) {
   switch (_tableKind) {
     case 0: // VOLUME
-      return volumeTable[_table].column[_tableColumn];
+      return _ctx->volumeTable[_table].column[_tableColumn];
     case 1: // DUTY
-      return dutyTable[_table].column[_tableColumn];
+      return _ctx->dutyTable[_table].column[_tableColumn];
     case 2: // PAN
-      return panTable[_table].column[_tableColumn];
+      return _ctx->panTable[_table].column[_tableColumn];
     case 3: // WAVE
-      return waveTable[_table][_tableColumn];
+      return _ctx->waveTable[_table][_tableColumn];
   }
   return 0;
 }
 
-static u8 setTableData(u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data) {
+static u8 setTableData(ChipContext *_ctx, u8 _tableKind, u16 _table, u8 _tableColumn, u8 _data) {
   switch (_tableKind) {
     case 0: // VOLUME
-      return volumeTable[_table].column[_tableColumn] = _data;
+      return _ctx->volumeTable[_table].column[_tableColumn] = _data;
     case 1: // DUTY
-      return dutyTable[_table].column[_tableColumn] = _data;
+      return _ctx->dutyTable[_table].column[_tableColumn] = _data;
     case 2: // PAN
-      return dutyTable[_table].column[_tableColumn] = _data;
+      return _ctx->dutyTable[_table].column[_tableColumn] = _data;
     case 3: // WAVE
-      return waveTable[_table][_tableColumn] = _data;
+      _ctx->waveTable[_table][_tableColumn] = _data;
+      invalidateLevels(_ctx);
+      return _data;
   }
   return 0;
 }
 
-static u8 getPlayerSongRow(u8 _channel) {
-  if (songpos == 0) {
+static u8 getPlayerSongRow(ChipContext *_ctx, u8 _channel) {
+  if (_ctx->songpos == 0) {
     return 0;
   }
-  return songpos - 1;
+  return _ctx->songpos - 1;
 }
 
-static u8 getPlayerPatternRow(u8 _channel) {
-  return trackpos;
+static u8 getPlayerPatternRow(ChipContext *_ctx, u8 _channel) {
+  return _ctx->trackpos;
 }
 
-static u8 getPlayerPattern(u8 _channelNum) {
+static u8 getPlayerPattern(ChipContext *_ctx, u8 _channelNum) {
   return 0; // TODO: Implement
 }
 
-static u8 getPlayerInstrumentRow(u8 _channelNum) {
+static u8 getPlayerInstrumentRow(ChipContext *_ctx, u8 _channelNum) {
   return 0; // TODO: Implement
 }
 
-static u8 getPlayerInstrument(u8 _channelNum) {
+static u8 getPlayerInstrument(ChipContext *_ctx, u8 _channelNum) {
   return 0; // TODO: Implement
 }
 
-static void plonk(u8 _note, u8 _channelNum, u8 _instrument, bool _isDown) {
+static void plonk(ChipContext *_ctx, u8 _note, u8 _channelNum, u8 _instrument, bool _isDown) {
   con_msgf("%d", _note);
   if (_note == 255) {
-    channel[_channelNum].volumeTable = 0;
-    channel[_channelNum].volumed = 0;
-    osc[_channelNum].volume = 0;
+    _ctx->channel[_channelNum].volumeTable = 0;
+    _ctx->channel[_channelNum].volumed = 0;
+    _ctx->osc[_channelNum].volume = 0;
   } else {
-    channel[_channelNum].tnote = _note + 1;
-    channel[_channelNum].inum = _instrument;
-    channel[_channelNum].iptr = 0;
-    channel[_channelNum].iwait = 0;
-    channel[_channelNum].bend = 0;
-    channel[_channelNum].bendd = 0;
-    channel[_channelNum].volumed = 0;
-    channel[_channelNum].vdepth = 0;
+    _ctx->channel[_channelNum].tnote = _note + 1;
+    _ctx->channel[_channelNum].inum = _instrument;
+    _ctx->channel[_channelNum].iptr = 0;
+    _ctx->channel[_channelNum].iwait = 0;
+    _ctx->channel[_channelNum].bend = 0;
+    _ctx->channel[_channelNum].bendd = 0;
+    _ctx->channel[_channelNum].volumed = 0;
+    _ctx->channel[_channelNum].vdepth = 0;
   }
 }
 
-static void playSongFrom(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
-  startplaysong(_songRow);
+static void playSongFrom(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {
+  startplaysong(_ctx, _songRow);
 }
 
-static void playPatternFrom(u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {}
+static void playPatternFrom(ChipContext *_ctx, u8 _songRow, u8 _songColumn, u8 _patternRow, u8 _patternColumn) {}
+
+static bool isPlaying(ChipContext *_ctx) {
+  return _ctx->playsong != 0;
+}
 
-static bool isPlaying() {
-  return playsong != 0;
+static u32 getLoopCount(ChipContext *_ctx) {
+  return _ctx->loopDetector.loopCount;
 }
 
-static void stop() {
-  silence();
+static void stop(ChipContext *_ctx) {
+  silence(_ctx);
 }
 
 static const u32 buzzfeed[] = {
@@ -1497,104 +1652,187 @@ static const u32 buzzfeed[] = {
     0x80001D8,  // F 28 bit
 };
 
-static void fillBlips() {
+static s8 stepValue(ChipContext *_ctx, struct oscillator *_osc, u8 _phase) {
+  s8 value = -1; // [-8,7]
+  if ((_osc->waveform & WF_TRI) != 0) {
+    if (_phase < 8) {
+      value = _phase & 7;
+    } else if (_phase < 24) {
+      value = 15 - _phase;
+    } else {
+      value = -8 + (_phase & 7);
+    }
+  }
+  if ((_osc->waveform & WF_SAW) != 0) {
+    value = -8 + (_phase >> 1);
+  }
+  if ((_osc->waveform & WF_PUL) != 0) {
+    value = ((_phase >> 1) > _osc->duty) ? 7 : -8;
+  }
+  if ((_osc->waveform & WF_NOI) != 0) {
+    value = (_phase & 15) - 8; // _phase is the noise output here
+  }
+  if ((_osc->waveform & WF_WAV) != 0) {
+    u8 wave = (_osc->waveform >> 4) & 0xf;
+    value = _ctx->waveTable[wave][_phase] - 8;
+  }
+  return value;
+}
+
+static void updateLevels(ChipContext *_ctx, struct oscillator *_osc) {
+  if (_osc->levelsValid && _osc->levelWaveform == _osc->waveform &&
+      _osc->levelDuty == _osc->duty && _osc->levelVolume == _osc->volume && _osc->levelPan == _osc->pan) {
+    return;
+  }
+  const s16 panLeft = (_osc->pan >= 8) ? 15 : _osc->pan * 2;
+  const s16 panRight = (_osc->pan <= 8) ? 15 : (16 - _osc->pan) * 2;
+  const s16 volumeLeft = (_osc->volume * panLeft) >> 4;
+  const s16 volumeRight = (_osc->volume * panRight) >> 4;
+  for (u8 phase = 0; phase < 32; phase++) {
+    const s8 value = stepValue(_ctx, _osc, phase);
+    _osc->levelLeft[phase] = value * volumeLeft;
+    _osc->levelRight[phase] = value * volumeRight;
+  }
+  for (u8 phase = 0; phase < 32; phase++) {
+    u8 skip = 1;
+    while (skip < 32 && _osc->levelLeft[(phase + skip) & 0x1f] == _osc->levelLeft[phase] &&
+           _osc->levelRight[(phase + skip) & 0x1f] == _osc->levelRight[phase]) {
+      skip++;
+    }
+    _osc->levelSkip[phase] = skip;
+  }
+  _osc->levelsValid = true;
+  _osc->levelWaveform = _osc->waveform;
+  _osc->levelDuty = _osc->duty;
+  _osc->levelVolume = _osc->volume;
+  _osc->levelPan = _osc->pan;
+}
+
+static inline void addLevel(blip_stereo_t *_buffer, struct oscillator *_osc, u8 _step, size_t _time) {
+  const s16 left = _osc->levelLeft[_step];
+  const s16 right = _osc->levelRight[_step];
+  if (_osc->lastLeft != left || _osc->lastRight != right) {
+    blip_stereo_add_delta(_buffer, _time, left - _osc->lastLeft, right - _osc->lastRight);
+    _osc->lastLeft = left;
+    _osc->lastRight = right;
+  }
+}
+
+static void fillBlips(ChipContext *_ctx) {
   u8 i;
-  playroutine();
+  playroutine(_ctx);
   for (i = 0; i < NUM_CHANNELS; i++) {
-    if (osc[i].freq > 0) {
-      size_t t = osc[i].lastTime;
-      for (; t < CLOCKS_PER_PLAYROUTINE; t += osc[i].freq) {
-        s8 value = -1; // [-8,7]
-        const u8 phase = osc[i].phase;
-        if ((osc[i].waveform & WF_TRI) != 0) {
-          if (phase < 8) {
-            value = phase & 7;
-          } else if (phase < 24) {
-            value = 15 - phase;
-          } else {
-            value = -8 + (phase & 7);
-          }
-        }
-        if ((osc[i].waveform & WF_SAW) != 0) {
-          value = -8 + (phase >> 1);
-        }
-        if ((osc[i].waveform & WF_PUL) != 0) {
-          value = ((phase >> 1) > osc[i].duty) ? 7 : -8;
-        }
-        if ((osc[i].waveform & WF_NOI) != 0) {
-          if (osc[i].buzzseed & 1) {
-            osc[i].buzzseed = (osc[i].buzzseed >> 1) ^ buzzfeed[osc[i].duty];
+    struct oscillator *osc = &_ctx->osc[i];
+    struct filter *filter = &_ctx->filter[i];
+    if (!filter->routed && filter->fadeLeft > 0) {
+      // First filter command on this channel: carry its current level over to its own buffer
+      blip_stereo_add_delta(_ctx->blipBuffer, 0, -osc->lastLeft, -osc->lastRight);
+      blip_stereo_add_delta(_ctx->channelBlipBuffer[i], 0, osc->lastLeft, osc->lastRight);
+      filter->routed = true;
+    }
+    blip_stereo_t *buffer = filter->routed ? _ctx->channelBlipBuffer[i] : _ctx->blipBuffer;
+    if (osc->freq > 0) {
+      updateLevels(_ctx, osc);
+      const s32 freq = osc->freq;
+      size_t t = osc->lastTime;
+      u8 phase = osc->phase;
+      if ((osc->waveform & WF_NOI) != 0) {
+        // A wave table still takes priority over noise, but the generator keeps running underneath
+        const bool fromWave = (osc->waveform & WF_WAV) != 0;
+        const u32 feed = buzzfeed[osc->duty];
+        u32 buzzseed = osc->buzzseed;
+        for (; t < CLOCKS_PER_PLAYROUTINE; t += freq) {
+          if (buzzseed & 1) {
+            buzzseed = (buzzseed >> 1) ^ feed;
           } else {
-            osc[i].buzzseed = osc[i].buzzseed >> 1;
+            buzzseed = buzzseed >> 1;
           }
-          if (osc[i].buzzseed == 0) {
-            osc[i].buzzseed = 1;
+          if (buzzseed == 0) {
+            buzzseed = 1;
           }
-          value = (osc[i].buzzseed & 15) - 8;
-        }
-        if ((osc[i].waveform & WF_WAV) != 0) {
-          u8 wave = (osc[i].waveform >> 4) & 0xf;
-          value = waveTable[wave][osc[i].phase] - 8;
-        }
-        const s16 panLeft = (osc[i].pan >= 8) ? 15 : osc[i].pan * 2;
-        const s16 panRight = (osc[i].pan <= 8) ? 15 : (16 - osc[i].pan) * 2;
-        const s16 left = value * (((osc[i].volume) * panLeft) >> 4);
-        const s16 right = value * (((osc[i].volume) * panRight) >> 4);
-        // acc.left += filter_sample(left, i, 0);    // rhs = [-8160,7905]
-        // acc.right += filter_sample(right, i, 1);  // rhs = [-8160,7905]
-        if (osc[i].lastLeft != left) {
-          const s16 delta = left - osc[i].lastLeft;
-          blip_add_delta(sBlipBuffer[0], t, delta);
-          osc[i].lastLeft = left;
+          addLevel(buffer, osc, fromWave ? phase : buzzseed & 15, t);
+          phase = (phase + 1) & 0x1f;
         }
-        if (osc[i].lastRight != right) {
-          const s16 delta = right - osc[i].lastRight;
-          blip_add_delta(sBlipBuffer[1], t, delta);
-          osc[i].lastRight = right;
-        }
-        if (osc[i].freq < 0) {
-          osc[i].freq = 0;
+        osc->buzzseed = buzzseed;
+      } else {
+        // Jump straight to the next step whose output differs, so a pulse costs two steps per cycle
+        const size_t end = CLOCKS_PER_PLAYROUTINE;
+        while (t < end) {
+          addLevel(buffer, osc, phase, t);
+          size_t steps = osc->levelSkip[phase];
+          if (t + steps * freq >= end) {
+            // No change left in this frame: land on the first step past its end
+            steps = (end - t + freq - 1) / freq;
+          }
+          t += steps * freq;
+          phase = (phase + steps) & 0x1f;
         }
-        osc[i].lastPhase = osc[i].phase;
-        osc[i].phase = (phase + 1) & 0x1f;
       }
-      osc[i].lastTime = t - CLOCKS_PER_PLAYROUTINE;
+      osc->phase = phase;
+      osc->lastTime = t - CLOCKS_PER_PLAYROUTINE;
+    }
+  }
+  blip_stereo_end_frame(_ctx->blipBuffer, CLOCKS_PER_PLAYROUTINE);
+  for (i = 0; i < NUM_CHANNELS; i++) {
+    if (_ctx->filter[i].routed) {
+      blip_stereo_end_frame(_ctx->channelBlipBuffer[i], CLOCKS_PER_PLAYROUTINE);
     }
   }
-  blip_end_frame(sBlipBuffer[0], CLOCKS_PER_PLAYROUTINE);
-  blip_end_frame(sBlipBuffer[1], CLOCKS_PER_PLAYROUTINE);
 } /* fillBlips */
 
-static void getSamples(ChipSample *_buf, int _len) {
-  while (blip_samples_avail(sBlipBuffer[0]) < _len) {
-    fillBlips();
-  }
-  for (size_t i = 0; i < 2; i++) {
-    blip_read_samples(sBlipBuffer[i], (short *) (((s16 *) _buf) + i), _len, true);
-  }
-  for (size_t i = 0; i < _len; i++) {
-    _buf[i] = chip_expandSample(_buf[i]);
+static void getSamples(ChipContext *_ctx, ChipSample *_buf, int _len) {
+  // The blip buffer only holds two playroutine frames, so large requests are read a frame at a time
+  while (_len > 0) {
+    int avail = blip_stereo_samples_avail(_ctx->blipBuffer);
+    if (avail == 0) {
+      fillBlips(_ctx);
+      continue;
+    }
+    int len = avail < _len ? avail : _len;
+    blip_stereo_read_samples(_ctx->blipBuffer, (short *) _buf, len);
+    for (u8 i = 0; i < NUM_CHANNELS; i++) {
+      if (_ctx->filter[i].routed) {
+        filter_mix(_ctx, i, _buf, len);
+      }
+    }
+    chip_expandSamples(&_ctx->expand, _buf, len);
+    _buf += len;
+    _len -= len;
   }
 }
 
-static const char *getInstrumentLabel(u8 _instrument, u8 _instrumentRow) {
+static u32 dryRunTick(ChipContext *_ctx) {
+  playroutine(_ctx);
+  // Carry the fraction of a sample so long runs add up to the rendered length
+  u32 samples = _ctx->sampleRate + _ctx->dryRunRemainder;
+  _ctx->dryRunRemainder = samples % 60;
+  return samples / 60;
+}
+
+static const char *getInstrumentLabel(ChipContext *_ctx, u8 _instrument, u8 _instrumentRow) {
   static char buf[3];
   snprintf(buf, 3, "%02X", _instrumentRow);
   return buf;
 }
 
-static const char *getInstrumentHelp(u8 _instrument, u8 _instrumentParam, u8 _instrumentRow, u8 _instrumentColumn) {
+static const char *getInstrumentHelp(ChipContext *_ctx, u8 _instrument, u8 _instrumentParam, u8 _instrumentRow,
+                                     u8 _instrumentColumn) {
   return ""; // TODO: Implement
 }
 
-static const char *getSongHelp(u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
+static const char *getSongHelp(ChipContext *_ctx, u8 _songRow, u8 _channelNum, u8 _songDataColumn) {
   return ""; // TODO: Implement
 }
 
-static const char *getPatternHelp(u8 _channelNum, u8 _patternNum, u8 _patternRow, u8 _patternColumn) {
+static const char *getPatternHelp(ChipContext *_ctx, u8 _channelNum, u8 _patternNum, u8 _patternRow,
+                                  u8 _patternColumn) {
   return ""; // TODO: Implement
 }
 
+static ChipError setFastPreview(ChipContext *_ctx, bool _fast) {
+  return ERR_NOT_SUPPORTED;
+}
+
 static void preferredWindowSize(u32 *_width, u32 *_height) {
   *_width = 1280;
   *_height = 632;
@@ -1696,9 +1934,12 @@ ChipInterface chip_p1xl = {
     playSongFrom,
     playPatternFrom,
     isPlaying,
+    getLoopCount,
     stop,
     silence,
     getSamples,
+    dryRunTick,
+    setFastPreview,
 
     // Misc
     preferredWindowSize
@@ -0,0 +1,456 @@
+// Headless renderer: plays songs through a chip engine without SDL and
+// optionally writes the result to .wav files. With -j, a list of songs is
+// rendered on a fixed-size pool of worker threads, one engine instance per song.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+#include <err.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "chip.h"
+#include "console.h"
+#include "wav.h"
+
+#define RENDER_BLOCK (4096)
+#define DEFAULT_MAX_SECONDS (600)
+#define DEFAULT_LOOPS (1)
+#define MAX_WORKERS (256)
+
+typedef struct {
+  const char *filename;
+  char *outputName;
+  ChipError error;
+  const char *errorSource;
+  uint64_t rendered;
+  double elapsed;
+  bool hitLimit;
+} RenderJob;
+
+static ChipInterface *sChip;
+static u32 sMaxSeconds = DEFAULT_MAX_SECONDS;
+static u32 sLoops = DEFAULT_LOOPS;
+static u32 sFadeSeconds = 0;
+static u32 sSampleRate = CHIP_DEFAULT_SAMPLE_RATE;
+// Only run the sequencers to report song lengths, without synthesizing or writing anything
+static bool sMeasureOnly = false;
+
+static RenderJob *sJobs;
+static int sNumJobs;
+static int sNextJob;
+static pthread_mutex_t sJobLock = PTHREAD_MUTEX_INITIALIZER;
+// Engines may fill shared lookup tables while initializing, so instances are created one at a time
+static pthread_mutex_t sInitLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Engines report through the console; without one we print to stderr
+ */
+void con_attrMsgf(u32 _attrib, char *_format, ...) {
+  va_list args;
+  va_start(args, _format);
+  flockfile(stderr);
+  vfprintf(stderr, _format, args);
+  fputc('\n', stderr);
+  funlockfile(stderr);
+  va_end(args);
+}
+
+static ChipInterface *findChip(const char *_chipName) {
+  for (int i = 0; chips[i] != NULL; i++) {
+    if (strcasecmp(chips[i]->getChipId(), _chipName) == 0) {
+      return chips[i];
+    }
+  }
+  return NULL;
+}
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *_name) {
+  fprintf(stderr, "Usage: %s [-l loops] [-f fade_seconds] [-t max_seconds] [-r sample_rate] <chip> <filename>\n"
+                  "          [output.wav]\n", _name);
+  fprintf(stderr, "       %s -j jobs [-o output_dir] [-i list_file] [-l loops] [-f fade_seconds] [-t max_seconds]\n"
+                  "          [-r sample_rate] <chip> [filename|directory ...]\n", _name);
+  fprintf(stderr, "       %s -m [-j jobs] [-i list_file] [-l loops] [-f fade_seconds] [-t max_seconds] <chip>\n"
+                  "          [filename|directory ...]\n"
+                  "          measures song lengths without rendering\n", _name);
+  exit(1);
+}
+
+static ChipError fail(RenderJob *_job, const char *_source, ChipError _error) {
+  _job->errorSource = _source;
+  _job->error = _error;
+  return _error;
+}
+
+/**
+ * Creates an engine instance and loads the job's song into it
+ */
+static ChipError openEngine(RenderJob *_job, ChipContext **_ctx) {
+  pthread_mutex_lock(&sInitLock);
+  ChipError error = sChip->init(_ctx, sSampleRate);
+  pthread_mutex_unlock(&sInitLock);
+  if (error != NO_ERR) {
+    return fail(_job, sChip->getChipId(), error);
+  }
+  error = sChip->loadSong(*_ctx, _job->filename);
+  if (error != NO_ERR) {
+    sChip->shutdown(*_ctx);
+    return fail(_job, _job->filename, error);
+  }
+  return NO_ERR;
+}
+
+/**
+ * Renders one song on a private engine instance
+ * @param _job Song to play; receives the amount rendered and any error
+ */
+static ChipError renderJob(RenderJob *_job) {
+  ChipContext *ctx;
+  ChipError error = openEngine(_job, &ctx);
+  if (error != NO_ERR) {
+    return error;
+  }
+  uint64_t maxSamples = (uint64_t) sMaxSeconds * sSampleRate;
+  u32 fadeLength = sFadeSeconds * sSampleRate;
+  // The sequencer dry run finds the exact sample the song stops or loops at, so the render can end on it
+  // instead of on a block boundary. It leaves the engine mid-song, so the render gets a fresh instance.
+  double start = now();
+  uint64_t fadeStart = chip_measureSong(sChip, ctx, sLoops, maxSamples);
+  uint64_t length = fadeStart;
+  if (sChip->isPlaying(ctx) && length < maxSamples) {
+    // Stopped by the loop count, so the song fades out from here
+    length = length + fadeLength < maxSamples ? length + fadeLength : maxSamples;
+  }
+  sChip->shutdown(ctx);
+  if (sMeasureOnly) {
+    _job->elapsed = now() - start;
+    _job->rendered = length;
+    _job->hitLimit = length >= maxSamples;
+    return NO_ERR;
+  }
+  if (_job->outputName && length > WAV_MAX_SAMPLES) {
+    return fail(_job, _job->outputName, ERR_WAV_TOO_LONG);
+  }
+  error = openEngine(_job, &ctx);
+  if (error != NO_ERR) {
+    return error;
+  }
+
+  WavWriter wav;
+  if (_job->outputName) {
+    error = wav_open(&wav, _job->outputName, sSampleRate);
+    if (error != NO_ERR) {
+      sChip->shutdown(ctx);
+      return fail(_job, _job->outputName, error);
+    }
+  }
+
+  ChipSample buf[RENDER_BLOCK];
+  uint64_t rendered = 0;
+  start = now();
+  sChip->playSongFrom(ctx, 0, 0, 0, 0);
+  while (rendered < length) {
+    int len = length - rendered < RENDER_BLOCK ? (int) (length - rendered) : RENDER_BLOCK;
+    if (rendered < fadeStart && fadeStart - rendered < len) {
+      // End the block where the fade begins
+      len = fadeStart - rendered;
+    }
+    sChip->getSamples(ctx, buf, len);
+    if (rendered >= fadeStart) {
+      chip_fadeOut(buf, len, rendered - fadeStart, fadeLength);
+    }
+    if (_job->outputName) {
+      error = wav_write(&wav, buf, len);
+      if (error != NO_ERR) {
+        break;
+      }
+    }
+    rendered += len;
+  }
+  _job->elapsed = now() - start;
+  _job->rendered = rendered;
+  _job->hitLimit = rendered >= maxSamples;
+  sChip->stop(ctx);
+  sChip->shutdown(ctx);
+
+  if (_job->outputName) {
+    ChipError closeError = wav_close(&wav);
+    if (error == NO_ERR) {
+      error = closeError;
+    }
+    if (error != NO_ERR) {
+      return fail(_job, _job->outputName, error);
+    }
+  }
+  return NO_ERR;
+}
+
+static void printJob(const RenderJob *_job) {
+  double seconds = (double) _job->rendered / sSampleRate;
+  if (sMeasureOnly) {
+    printf("%s: %.2fs long, measured in %.3fs%s\n", _job->filename, seconds, _job->elapsed,
+           _job->hitLimit ? ", stopped at time limit" : "");
+    return;
+  }
+  printf("%s: %.2fs of audio in %.3fs (%.1fx real time)%s\n", _job->filename, seconds, _job->elapsed,
+         _job->elapsed > 0 ? seconds / _job->elapsed : 0.0, _job->hitLimit ? ", stopped at time limit" : "");
+}
+
+static void *worker(void *_arg) {
+  for (;;) {
+    pthread_mutex_lock(&sJobLock);
+    int index = sNextJob < sNumJobs ? sNextJob++ : -1;
+    pthread_mutex_unlock(&sJobLock);
+    if (index < 0) {
+      return NULL;
+    }
+    RenderJob *job = &sJobs[index];
+    if (renderJob(job) != NO_ERR) {
+      warnx("%s: %s", job->errorSource, job->error);
+    } else {
+      printJob(job);
+    }
+  }
+}
+
+static void addJob(const char *_filename) {
+  static int capacity = 0;
+  if (sNumJobs == capacity) {
+    capacity = capacity ? capacity * 2 : 64;
+    sJobs = realloc(sJobs, capacity * sizeof(RenderJob));
+    if (!sJobs) {
+      err(1, "Cannot allocate job list");
+    }
+  }
+  RenderJob *job = &sJobs[sNumJobs++];
+  memset(job, 0, sizeof(RenderJob));
+  job->filename = strdup(_filename);
+}
+
+static bool hasSuffix(const char *_name, const char *_suffix) {
+  size_t len = strlen(_name);
+  size_t suffixLen = strlen(_suffix);
+  return len >= suffixLen && strcasecmp(_name + len - suffixLen, _suffix) == 0;
+}
+
+static int compareNames(const void *_a, const void *_b) {
+  return strcmp(*(char *const *) _a, *(char *const *) _b);
+}
+
+/**
+ * Queues every regular file in a directory, skipping hidden files and previous .wav output
+ */
+static void addDirectory(const char *_path) {
+  DIR *dir = opendir(_path);
+  if (!dir) {
+    err(1, "%s", _path);
+  }
+  char **names = NULL;
+  int count = 0;
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.' || hasSuffix(entry->d_name, ".wav")) {
+      continue;
+    }
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", _path, entry->d_name);
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    names = realloc(names, (count + 1) * sizeof(char *));
+    if (!names) {
+      err(1, "Cannot allocate file list");
+    }
+    names[count++] = strdup(path);
+  }
+  closedir(dir);
+
+  // Directory order is arbitrary; sort so runs are repeatable
+  qsort(names, count, sizeof(char *), compareNames);
+  for (int i = 0; i < count; i++) {
+    addJob(names[i]);
+    free(names[i]);
+  }
+  free(names);
+}
+
+static void addPath(const char *_path) {
+  struct stat st;
+  if (stat(_path, &st) == 0 && S_ISDIR(st.st_mode)) {
+    addDirectory(_path);
+  } else {
+    addJob(_path);
+  }
+}
+
+/**
+ * Queues the songs named in a text file, one per line; "-" reads from stdin
+ */
+static void addList(const char *_listName) {
+  FILE *f = strcmp(_listName, "-") == 0 ? stdin : fopen(_listName, "r");
+  if (!f) {
+    err(1, "%s", _listName);
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = 0;
+    if (line[0] != 0 && line[0] != '#') {
+      addPath(line);
+    }
+  }
+  if (f != stdin) {
+    fclose(f);
+  }
+}
+
+/**
+ * Builds the .wav name for a song: the song's base name with its extension replaced,
+ * placed in the output directory when given or next to the song otherwise
+ */
+static char *outputNameFor(const char *_filename, const char *_outputDir) {
+  const char *base = strrchr(_filename, '/');
+  base = base ? base + 1 : _filename;
+  const char *dot = strrchr(base, '.');
+  int baseLen = dot && dot != base ? (int) (dot - base) : (int) strlen(base);
+  char *name;
+  int result;
+  if (_outputDir) {
+    result = asprintf(&name, "%s/%.*s.wav", _outputDir, baseLen, base);
+  } else {
+    result = asprintf(&name, "%.*s.wav", (int) (base - _filename) + baseLen, _filename);
+  }
+  if (result < 0) {
+    err(1, "Cannot allocate output name");
+  }
+  return name;
+}
+
+static int renderBatch(int _numWorkers, const char *_outputDir) {
+  if (sNumJobs == 0) {
+    errx(1, "No songs to render");
+  }
+  for (int i = 0; i < sNumJobs; i++) {
+    sJobs[i].outputName = outputNameFor(sJobs[i].filename, _outputDir);
+  }
+  if (_numWorkers > sNumJobs) {
+    _numWorkers = sNumJobs;
+  }
+
+  pthread_t threads[MAX_WORKERS];
+  double start = now();
+  for (int i = 0; i < _numWorkers; i++) {
+    if (pthread_create(&threads[i], NULL, worker, NULL) != 0) {
+      errx(1, "Cannot start worker thread");
+    }
+  }
+  for (int i = 0; i < _numWorkers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  double elapsed = now() - start;
+
+  uint64_t rendered = 0;
+  double busy = 0;
+  int failed = 0;
+  for (int i = 0; i < sNumJobs; i++) {
+    if (sJobs[i].error != NO_ERR) {
+      failed++;
+    } else {
+      rendered += sJobs[i].rendered;
+      busy += sJobs[i].elapsed;
+    }
+  }
+  double seconds = (double) rendered / sSampleRate;
+  printf("%d songs, %d failed: %.2fs of audio in %.3fs on %d workers (%.1fx real time, %.1fx average per song)\n",
+         sNumJobs, failed, seconds, elapsed, _numWorkers, elapsed > 0 ? seconds / elapsed : 0.0,
+         busy > 0 ? seconds / busy : 0.0);
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+  int numWorkers = 0;
+  const char *outputDir = NULL;
+  const char *listName = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "l:f:t:r:j:o:i:m")) != -1) {
+    switch (opt) {
+      case 'l':
+        sLoops = atoi(optarg);
+        break;
+      case 'f':
+        sFadeSeconds = atoi(optarg);
+        break;
+      case 't':
+        sMaxSeconds = atoi(optarg);
+        break;
+      case 'r':
+        sSampleRate = atoi(optarg);
+        if (sSampleRate < CHIP_MIN_SAMPLE_RATE || sSampleRate > CHIP_MAX_SAMPLE_RATE) {
+          errx(1, "Sample rate must be %d-%d Hz", CHIP_MIN_SAMPLE_RATE, CHIP_MAX_SAMPLE_RATE);
+        }
+        break;
+      case 'j':
+        // 0 uses every online core
+        numWorkers = atoi(optarg);
+        if (numWorkers <= 0) {
+          numWorkers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+        }
+        if (numWorkers < 1) {
+          numWorkers = 1;
+        }
+        if (numWorkers > MAX_WORKERS) {
+          numWorkers = MAX_WORKERS;
+        }
+        break;
+      case 'o':
+        outputDir = optarg;
+        break;
+      case 'i':
+        listName = optarg;
+        break;
+      case 'm':
+        sMeasureOnly = true;
+        break;
+      default:
+        usage(argv[0]);
+    }
+  }
+  bool batch = numWorkers > 0;
+  if (argc - optind < 1 || (!batch && (argc - optind < 2 || argc - optind > 3 || outputDir || listName))) {
+    usage(argv[0]);
+  }
+  const char *chipName = argv[optind];
+  sChip = findChip(chipName);
+  if (!sChip) {
+    errx(1, "Cannot find chip: %s", chipName);
+  }
+
+  if (batch) {
+    if (listName) {
+      addList(listName);
+    }
+    for (int i = optind + 1; i < argc; i++) {
+      addPath(argv[i]);
+    }
+    return renderBatch(numWorkers, outputDir);
+  }
+
+  RenderJob job = {0};
+  job.filename = argv[optind + 1];
+  job.outputName = argc - optind == 3 ? argv[optind + 2] : NULL;
+  if (renderJob(&job) != NO_ERR) {
+    errx(1, "%s: %s", job.errorSource, job.error);
+  }
+  printJob(&job);
+  return 0;
+}
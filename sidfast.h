@@ -0,0 +1,441 @@
+#pragma once
+/*#
+    # sidfast.h
+
+    Approximate MOS 6581 (SID) stepped once per output sample instead of once
+    per chip clock. Oscillators, envelopes and filter follow m6581.h closely
+    enough for previewing a song while editing it, at a fraction of the cost;
+    waveforms are not band-limited and sync/noise are only accurate to a sample.
+    Use m6581.h for anything that gets exported.
+
+    Do this:
+    ~~~C
+    #define CHIPS_IMPL
+    ~~~
+    before you include this file in *one* C or C++ file to create the
+    implementation.
+
+    Optionally provide the following macros with your own implementation
+    ~~~C
+    CHIPS_ASSERT(c)
+    ~~~
+
+    Define M6581_CUTOFF_TABLE as for m6581.h to share its precomputed cutoff
+    curve; otherwise the curve is computed with tablegen.h.
+
+    Registers are numbered as in m6581.h.
+#*/
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// setup parameters for sidfast_init()
+typedef struct {
+  int tick_hz;        // clock frequency of the emulated chip in Hz
+  int sound_hz;       // sound sample frequency
+  float magnitude;    // output sample magnitude (0=silence to 1=max volume)
+} sidfast_desc_t;
+
+// envelope generator state
+typedef enum {
+  SIDFAST_ENV_FROZEN,
+  SIDFAST_ENV_ATTACK,
+  SIDFAST_ENV_DECAY,
+  SIDFAST_ENV_RELEASE
+} sidfast_env_state_t;
+
+// voice state
+typedef struct {
+  // wave generator state
+  uint16_t freq;
+  uint16_t pulse_width;
+  uint8_t ctrl;
+  bool sync;
+  uint32_t noise_shift;           // 23 bit
+  uint32_t wav_accum;             // 24 bit
+  uint32_t wav_output;            // 12 bit
+
+  // envelope generator state
+  sidfast_env_state_t env_state;
+  uint8_t env_attack;
+  uint8_t env_decay;
+  uint8_t env_sustain_level;
+  uint8_t env_release;
+  uint32_t env_cur_level;
+  uint32_t env_rate;
+  uint32_t env_counter;           // 16.16 fixed, in chip clocks
+  uint32_t env_exp_counter;
+} sidfast_voice_t;
+
+// filter state
+typedef struct {
+  uint16_t cutoff;
+  uint8_t resonance;
+  uint8_t voices;
+  uint8_t mode;
+  uint8_t volume;
+  float g;
+  float k;
+  float ic1eq;
+  float ic2eq;
+} sidfast_filter_t;
+
+// sidfast instance state
+typedef struct {
+  int sound_hz;
+  uint32_t clocks_per_sample;     // 16.16 fixed
+  sidfast_voice_t voice[3];
+  sidfast_filter_t filter;
+  float sample_mag;
+} sidfast_t;
+
+// initialize a new sidfast_t instance
+void sidfast_init(sidfast_t *sid, const sidfast_desc_t *desc);
+
+// reset a sidfast_t instance
+void sidfast_reset(sidfast_t *sid);
+
+// write a register, taking effect from the next sample
+void sidfast_write(sidfast_t *sid, uint8_t reg, uint8_t data);
+
+// generate num_samples samples
+void sidfast_run(sidfast_t *sid, float *samples, int num_samples);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#define _USE_MATH_DEFINES
+#endif
+
+#include <math.h>   /* tanf */
+
+#ifndef M6581_CUTOFF_TABLE
+#include "tablegen.h"
+#endif
+
+#ifndef CHIPS_ASSERT
+
+#include <assert.h>
+
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define SIDFAST_FIXEDPOINT_SCALE (16)
+#define SIDFAST_BIT(val, bitnr) ((val>>bitnr)&1)
+
+/* clocks between envelope steps for each rate setting */
+static const uint32_t _sidfast_rate_period[16] = {
+    9, 32, 63, 95, 149, 220, 267, 313, 392, 977, 1954, 3126, 3907, 11720, 19532, 31251
+};
+
+/* decay and release slow down as the level falls, approximating an exponential */
+static uint32_t _sidfast_exp_divisor(uint32_t level) {
+  if (level < 6) {
+    return 30;
+  } else if (level < 14) {
+    return 16;
+  } else if (level < 26) {
+    return 8;
+  } else if (level < 54) {
+    return 4;
+  } else if (level < 93) {
+    return 2;
+  }
+  return 1;
+}
+
+static void _sidfast_init_voice(sidfast_voice_t *v) {
+  memset(v, 0, sizeof(*v));
+  v->noise_shift = 0x007FFFFC;
+  v->env_state = SIDFAST_ENV_FROZEN;
+}
+
+static void _sidfast_set_filter_cutoff(sidfast_t *sid) {
+  sidfast_filter_t *f = &sid->filter;
+  /* same cutoff curve as m6581.h, from the same table when there is one */
+#ifdef M6581_CUTOFF_TABLE
+  float cf = M6581_CUTOFF_TABLE[f->cutoff];
+#else
+  float cf = tablegen_m6581Cutoff(f->cutoff);
+#endif
+  float max_cutoff = sid->sound_hz * 0.45f;
+  if (max_cutoff > 16000.0f) {
+    max_cutoff = 16000.0f;
+  }
+  if (cf > max_cutoff) {
+    cf = max_cutoff;
+  }
+  f->g = tanf(((float) M_PI) * cf / (float) sid->sound_hz);
+}
+
+static void _sidfast_set_resonance(sidfast_filter_t *f) {
+  f->k = 1.0f / (0.707f + 1.9f * ((float) f->resonance) / 15.0f);
+}
+
+static void _sidfast_init_filter(sidfast_t *sid) {
+  memset(&sid->filter, 0, sizeof(sid->filter));
+  _sidfast_set_filter_cutoff(sid);
+  _sidfast_set_resonance(&sid->filter);
+}
+
+void sidfast_init(sidfast_t *sid, const sidfast_desc_t *desc) {
+  CHIPS_ASSERT(sid && desc);
+  CHIPS_ASSERT(desc->tick_hz > 0);
+  CHIPS_ASSERT(desc->sound_hz > 0);
+  memset(sid, 0, sizeof(*sid));
+  sid->sound_hz = desc->sound_hz;
+  sid->clocks_per_sample = (uint32_t) (((uint64_t) desc->tick_hz << SIDFAST_FIXEDPOINT_SCALE) / desc->sound_hz);
+  sid->sample_mag = desc->magnitude;
+  sidfast_reset(sid);
+}
+
+void sidfast_reset(sidfast_t *sid) {
+  CHIPS_ASSERT(sid);
+  for (int i = 0; i < 3; i++) {
+    _sidfast_init_voice(&sid->voice[i]);
+  }
+  _sidfast_init_filter(sid);
+}
+
+/*--- VOICE IMPLEMENTATION ---------------------------------------------------*/
+static void _sidfast_set_ctrl(sidfast_voice_t *v, uint8_t data) {
+  if ((data & 0x08) && !(v->ctrl & 0x08)) {
+    /* test bit on: hold the oscillator */
+    v->wav_accum = 0;
+  }
+  if ((data & 0x01) && !(v->ctrl & 0x01)) {
+    /* gate bit on: start attack */
+    v->env_state = SIDFAST_ENV_ATTACK;
+    v->env_rate = v->env_attack;
+  } else if (!(data & 0x01) && (v->ctrl & 0x01)) {
+    /* gate bit off: start release */
+    v->env_state = SIDFAST_ENV_RELEASE;
+    v->env_rate = v->env_release;
+  }
+  v->ctrl = data;
+}
+
+static inline void _sidfast_clock_noise(sidfast_voice_t *v) {
+  uint32_t s = v->noise_shift;
+  v->noise_shift = ((s << 1) | (((s >> 22) ^ (s >> 17)) & 1)) & 0x007FFFFF;
+}
+
+static inline uint32_t _sidfast_triangle(sidfast_voice_t *v, sidfast_voice_t *v_sync) {
+  uint32_t msb = ((v->ctrl & 0x04) ? v->wav_accum ^ v_sync->wav_accum : v->wav_accum) & 0x00800000;
+  return ((msb ? ~v->wav_accum : v->wav_accum) >> 11) & 0x0FFF;
+}
+
+static inline uint32_t _sidfast_pulse(sidfast_voice_t *v) {
+  return ((v->ctrl & 0x08) || (v->wav_accum >> 12) >= v->pulse_width) ? 0x0FFF : 0x0000;
+}
+
+static inline uint32_t _sidfast_noise(sidfast_voice_t *v) {
+  uint32_t s = v->noise_shift;
+  return (SIDFAST_BIT(s, 22) << 11) |
+         (SIDFAST_BIT(s, 20) << 10) |
+         (SIDFAST_BIT(s, 16) << 9) |
+         (SIDFAST_BIT(s, 13) << 8) |
+         (SIDFAST_BIT(s, 11) << 7) |
+         (SIDFAST_BIT(s, 7) << 6) |
+         (SIDFAST_BIT(s, 4) << 5) |
+         (SIDFAST_BIT(s, 2) << 4);
+}
+
+static inline void _sidfast_voice_osc(sidfast_t *sid, sidfast_voice_t *v) {
+  if (v->ctrl & 0x08) {
+    v->sync = false;
+    return;
+  }
+  uint32_t prev_accum = v->wav_accum;
+  uint32_t next = prev_accum + (uint32_t) (((uint64_t) v->freq * sid->clocks_per_sample) >> SIDFAST_FIXEDPOINT_SCALE);
+  /* noise is clocked on every rising edge of bit 19, several of which can pass in one sample */
+  uint32_t edges = ((next + 0x00080000) >> 20) - ((prev_accum + 0x00080000) >> 20);
+  for (uint32_t i = 0; i < edges; i++) {
+    _sidfast_clock_noise(v);
+  }
+  v->wav_accum = next & 0x00FFFFFF;
+  v->sync = (v->wav_accum & 0x00800000) && !(prev_accum & 0x00800000);
+}
+
+static inline void _sidfast_voice_wave(sidfast_voice_t *v, sidfast_voice_t *v_sync) {
+  uint32_t sm;
+  switch ((v->ctrl >> 4) & 0x0F) {
+    case 1: sm = _sidfast_triangle(v, v_sync);
+      break;
+    case 2: sm = v->wav_accum >> 12;
+      break;
+    case 3: sm = _sidfast_triangle(v, v_sync) & (v->wav_accum >> 12);
+      sm = (sm >> 1) & (sm << 1);
+      break;
+    case 4: sm = _sidfast_pulse(v);
+      break;
+    case 5: sm = _sidfast_triangle(v, v_sync) & _sidfast_pulse(v);
+      sm = (sm >> 1) & (sm << 1);
+      break;
+    case 6: sm = (v->wav_accum >> 12) & _sidfast_pulse(v);
+      sm = (sm >> 1) & (sm << 1);
+      break;
+    case 8: sm = _sidfast_noise(v);
+      break;
+    default: sm = 0;
+      break;
+  }
+  v->wav_output = sm & 0x0FFF;
+}
+
+static inline void _sidfast_voice_env(sidfast_t *sid, sidfast_voice_t *v) {
+  v->env_counter += sid->clocks_per_sample;
+  uint32_t period = _sidfast_rate_period[v->env_rate & 0x0F] << SIDFAST_FIXEDPOINT_SCALE;
+  while (v->env_counter >= period) {
+    v->env_counter -= period;
+    if (v->env_state != SIDFAST_ENV_ATTACK && ++v->env_exp_counter < _sidfast_exp_divisor(v->env_cur_level)) {
+      continue;
+    }
+    v->env_exp_counter = 0;
+    switch (v->env_state) {
+      case SIDFAST_ENV_ATTACK:
+        if (++v->env_cur_level >= 0xFF) {
+          v->env_cur_level = 0xFF;
+          v->env_state = SIDFAST_ENV_DECAY;
+          v->env_rate = v->env_decay;
+          return;
+        }
+        break;
+      case SIDFAST_ENV_DECAY:
+        if (v->env_cur_level > v->env_sustain_level) {
+          v->env_cur_level--;
+        }
+        break;
+      case SIDFAST_ENV_RELEASE:
+        if (v->env_cur_level > 0) {
+          v->env_cur_level--;
+        }
+        if (v->env_cur_level == 0) {
+          v->env_state = SIDFAST_ENV_FROZEN;
+        }
+        break;
+      case SIDFAST_ENV_FROZEN:
+        break;
+    }
+  }
+}
+
+/*--- FILTER IMPLEMENTATION ---------------------------------------------------*/
+/* trapezoidal state variable filter, stable for any cutoff below nyquist */
+static inline float _sidfast_filter_output(sidfast_filter_t *f, float vi) {
+  float a1 = 1.0f / (1.0f + f->g * (f->g + f->k));
+  float a2 = f->g * a1;
+  float a3 = f->g * a2;
+  float v3 = vi - f->ic2eq;
+  float v1 = a1 * f->ic1eq + a2 * v3;
+  float v2 = f->ic2eq + a2 * f->ic1eq + a3 * v3;
+  f->ic1eq = 2.0f * v1 - f->ic1eq;
+  f->ic2eq = 2.0f * v2 - f->ic2eq;
+  float vf = 0.0f;
+  if (f->mode & 0x01) {
+    vf += v2;
+  }
+  if (f->mode & 0x02) {
+    vf += v1;
+  }
+  if (f->mode & 0x04) {
+    vf += vi - f->k * v1 - v2;
+  }
+  /* m6581.h's filter inverts */
+  return -vf;
+}
+
+void sidfast_write(sidfast_t *sid, uint8_t reg, uint8_t data) {
+  CHIPS_ASSERT(sid);
+  if (reg < 21) {
+    sidfast_voice_t *v = &sid->voice[reg / 7];
+    switch (reg % 7) {
+      case 0: v->freq = (v->freq & 0xFF00) | data;
+        break;
+      case 1: v->freq = (data << 8) | (v->freq & 0x00FF);
+        break;
+      case 2: v->pulse_width = (v->pulse_width & 0x0F00) | data;
+        break;
+      case 3: v->pulse_width = ((data & 0x0F) << 8) | (v->pulse_width & 0x00FF);
+        break;
+      case 4: _sidfast_set_ctrl(v, data);
+        break;
+      case 5: v->env_attack = data >> 4;
+        v->env_decay = data & 0x0F;
+        if (v->env_state == SIDFAST_ENV_ATTACK) {
+          v->env_rate = v->env_attack;
+        } else if (v->env_state == SIDFAST_ENV_DECAY) {
+          v->env_rate = v->env_decay;
+        }
+        break;
+      case 6: v->env_sustain_level = (data >> 4) * 0x11;
+        v->env_release = data & 0x0F;
+        if (v->env_state == SIDFAST_ENV_RELEASE) {
+          v->env_rate = v->env_release;
+        }
+        break;
+    }
+    return;
+  }
+  sidfast_filter_t *f = &sid->filter;
+  switch (reg) {
+    case 21: f->cutoff = (f->cutoff & 0x7F8) | (data & 7);
+      _sidfast_set_filter_cutoff(sid);
+      break;
+    case 22: f->cutoff = (data << 3) | (f->cutoff & 7);
+      _sidfast_set_filter_cutoff(sid);
+      break;
+    case 23: f->voices = data & 7;
+      f->resonance = data >> 4;
+      _sidfast_set_resonance(f);
+      break;
+    case 24: f->volume = data & 0x0F;
+      f->mode = data >> 4;
+      break;
+    default: break;
+  }
+}
+
+void sidfast_run(sidfast_t *sid, float *samples, int num_samples) {
+  CHIPS_ASSERT(sid && samples);
+  /* same scale as m6581.h: 12 bit wave times 8 bit envelope times 4 bit volume */
+  const float scale = sid->sample_mag / (4096.0f * 16384.0f);
+  for (int n = 0; n < num_samples; n++) {
+    for (int i = 0; i < 3; i++) {
+      _sidfast_voice_osc(sid, &sid->voice[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+      sidfast_voice_t *v_sync = &sid->voice[(i + 2) % 3];
+      if (sid->voice[i].sync && (v_sync->ctrl & 0x02)) {
+        v_sync->wav_accum = 0;
+      }
+    }
+    float sum_filtered = 0.0f;
+    float sum = 0.0f;
+    for (int i = 0; i < 3; i++) {
+      sidfast_voice_t *v = &sid->voice[i];
+      _sidfast_voice_wave(v, &sid->voice[(i + 2) % 3]);
+      _sidfast_voice_env(sid, v);
+      float out = (float) (v->wav_output * v->env_cur_level);
+      if (sid->filter.voices & (1 << i)) {
+        sum_filtered += out;
+      } else if (i != 2 || !(sid->filter.mode & 0x08)) {
+        sum += out;
+      }
+    }
+    float mixed = sum + _sidfast_filter_output(&sid->filter, sum_filtered);
+    samples[n] = mixed * sid->filter.volume * scale;
+  }
+}
+
+#endif /* CHIPS_IMPL */
@@ -0,0 +1,70 @@
+#ifndef TABLEGEN_H
+#define TABLEGEN_H
+
+// The formulas behind the tables tools/gentables writes into tables.h. Code that has to build one of them at
+// run time calls the same function, so a generated table and a built one can't drift apart.
+#include <math.h>
+#include <stdint.h>
+
+// Sizes the engines are built with and tools/gentables writes tables for
+#define TABLEGEN_P1XL_FILTER_LENGTH 31 // Must be odd
+#define TABLEGEN_M6581_DECIMATE_FACTOR 4
+#define TABLEGEN_M6581_DECIMATE_TAPS 64
+
+/**
+ * Hann windowed sinc lowpass kernel for one of p1xl's 256 filter settings, in the float precision p1xl
+ * always built them in
+ * @param _length Number of taps, odd
+ */
+static inline void tablegen_p1xlFilterKernel(float *_kernel, int _length, int _setting, double _sampleRate) {
+  float filtFreq = 16.42 + pow(1.029410639, 90 + _setting);
+  if (_setting == 255) {
+    filtFreq = _sampleRate / 2;
+  }
+  int j = 0;
+  for (int i = -(_length - 1) / 2; i <= (_length - 1) / 2; i++) {
+    const float w = 0.5 - 0.5 * cos((2.0 * M_PI * ((float) j + 1.0)) / (float) _length);
+    const float b = 2.0 * filtFreq * ((float) i) / _sampleRate;
+    const float sinc_b = (b == 0) ? 1.0 : sin(M_PI * b) / (M_PI * b);
+    _kernel[j] = w * (2.0 * filtFreq / _sampleRate) * sinc_b;
+    j++;
+  }
+}
+
+/**
+ * m6581's filter cutoff curve for one of its 2048 cutoff register settings
+ */
+static inline float tablegen_m6581Cutoff(int _step) {
+  float x = _step / 8.0f;
+  float cf = -0.0156f * x * x + 48.473f * x - 45.074f;
+  return cf <= 0 ? 0 : cf;
+}
+
+/**
+ * Hann-windowed sinc lowpass at 0.4 of the output rate for m6581's decimation steps, 1.15 fixed with unity
+ * gain at DC
+ * @param _count Number of taps
+ * @param _factor Decimation steps per output sample
+ */
+static inline void tablegen_m6581DecimateTaps(int32_t *_taps, int _count, int _factor) {
+  const float cutoff = 0.4f / _factor;
+  const float center = (_count - 1) / 2.0f;
+  float taps[_count];
+  float sum = 0.0f;
+  for (int i = 0; i < _count; i++) {
+    float x = i - center;
+    float sinc = sinf(2.0f * ((float) M_PI) * cutoff * x) / (((float) M_PI) * x);
+    float window = 0.5f - 0.5f * cosf(2.0f * ((float) M_PI) * (i + 0.5f) / _count);
+    taps[i] = sinc * window;
+    sum += taps[i];
+  }
+  int32_t total = 0;
+  for (int i = 0; i < _count; i++) {
+    _taps[i] = (int32_t) lrintf(taps[i] * (1 << 15) / sum);
+    total += _taps[i];
+  }
+  // Put the rounding error in the middle
+  _taps[_count / 2] += (1 << 15) - total;
+}
+
+#endif // ifndef TABLEGEN_H
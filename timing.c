@@ -0,0 +1,63 @@
+#include "timing.h"
+#include <stdio.h>
+#include <time.h>
+
+void timing_init(TimingHistogram *_histogram, const char *_name) {
+  _histogram->name = _name;
+  for (int i = 0; i < TIMING_BINS; i++) {
+    atomic_init(&_histogram->bins[i], 0);
+  }
+  atomic_init(&_histogram->count, 0);
+  atomic_init(&_histogram->misses, 0);
+  atomic_init(&_histogram->worstPercent, 0);
+}
+
+double timing_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void timing_record(TimingHistogram *_histogram, double _elapsed, double _budget) {
+  // Also caps blocks that had no budget left at all
+  u32 percent = _elapsed * 100.0 < _budget * TIMING_MAX_PERCENT ? (u32) (_elapsed * 100.0 / _budget)
+                                                                : TIMING_MAX_PERCENT;
+  int bin;
+  if (percent < 100) {
+    bin = percent / 10;
+  } else if (percent < 200) {
+    bin = TIMING_BINS - 2;
+  } else {
+    bin = TIMING_BINS - 1;
+  }
+  atomic_fetch_add_explicit(&_histogram->bins[bin], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&_histogram->count, 1, memory_order_relaxed);
+  if (percent >= 100) {
+    atomic_fetch_add_explicit(&_histogram->misses, 1, memory_order_relaxed);
+  }
+  // Only the audio thread writes, so a plain load/store keeps the maximum
+  if (percent > atomic_load_explicit(&_histogram->worstPercent, memory_order_relaxed)) {
+    atomic_store_explicit(&_histogram->worstPercent, percent, memory_order_relaxed);
+  }
+}
+
+void timing_print(TimingHistogram *_histogram, const char *_engine, void (*_print)(char *_line)) {
+  char line[256];
+  snprintf(line, sizeof(line), "%s %s: %u BLOCKS, %u MISSED, WORST %u%%", _engine, _histogram->name,
+           atomic_load(&_histogram->count), atomic_load(&_histogram->misses), atomic_load(&_histogram->worstPercent));
+  _print(line);
+  for (int i = 0; i < TIMING_BINS; i++) {
+    u32 count = atomic_load(&_histogram->bins[i]);
+    if (count == 0) {
+      continue;
+    }
+    if (i < TIMING_BINS - 2) {
+      snprintf(line, sizeof(line), "  %3d-%3d%%: %u", i * 10, i * 10 + 10, count);
+    } else if (i == TIMING_BINS - 2) {
+      snprintf(line, sizeof(line), "  100-200%%: %u", count);
+    } else {
+      snprintf(line, sizeof(line), "     >200%%: %u", count);
+    }
+    _print(line);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdatomic.h>
+#include "types.h"
+
+// Ten bins of 10% of the budget, then 100-200% and everything slower
+#define TIMING_BINS (12)
+// Worst case recorded; a block that had no time to spare at all counts as this
+#define TIMING_MAX_PERCENT (9999)
+
+/**
+ * Histogram of how much of its real-time budget each audio block used. Meant to
+ * be written by a single audio thread and read from anywhere; no locks involved.
+ */
+typedef struct {
+  const char *name;
+  atomic_uint bins[TIMING_BINS];
+  atomic_uint count;
+  atomic_uint misses;
+  atomic_uint worstPercent;
+} TimingHistogram;
+
+void timing_init(TimingHistogram *_histogram, const char *_name);
+
+/**
+ * Monotonic time in seconds
+ */
+double timing_now();
+
+/**
+ * Records one block
+ * @param _elapsed Seconds spent producing the block
+ * @param _budget Seconds the block had before it was needed; taking longer counts as a miss, and so does
+ *        having no time at all
+ */
+void timing_record(TimingHistogram *_histogram, double _elapsed, double _budget);
+
+/**
+ * Writes a summary and the non-empty bins, one line per call to _print
+ * @param _engine Chip id shown in the summary line
+ */
+void timing_print(TimingHistogram *_histogram, const char *_engine, void (*_print)(char *_line));
+
+#endif // ifndef TIMING_H
@@ -0,0 +1,125 @@
+// Times each blip_buf synthesis implementation against the scalar one and checks they give identical samples.
+// Build with `make blipbench`, then run ./blipbench
+#include "../blip_buf.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#define CLOCK_RATE (44100.0 * 256.0)
+#define SAMPLE_RATE (44100.0)
+#define FRAME_CLOCKS (188160)
+#define FRAME_SAMPLES (735)
+#define FRAMES (400)
+#define DELTAS_PER_FRAME (2000)
+#define REPEATS (5)
+
+static const char *sNames[] = {"auto", "scalar", "sse2", "avx2", "neon"};
+
+static short sReference[2][FRAMES * FRAME_SAMPLES * 2];
+static short sOutput[2][FRAMES * FRAME_SAMPLES * 2];
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned nextRandom(unsigned *_seed) {
+  *_seed = *_seed * 1103515245u + 12345u;
+  return *_seed >> 8;
+}
+
+// Mostly chip sized steps, with the odd one too big for 16 bit so the fallbacks are covered as well
+static int randomDelta(unsigned *_seed) {
+  unsigned r = nextRandom(_seed);
+  if ((r & 255) == 0) {
+    return (int) (r % 200000) - 100000;
+  }
+  return (int) (r % 8192) - 4096;
+}
+
+/**
+ * Renders FRAMES frames of random deltas into _out and returns the seconds spent adding deltas
+ */
+static double run(bool _stereo, short *_out) {
+  blip_t *mono = blip_new(FRAME_SAMPLES * 2);
+  blip_stereo_t *stereo = blip_stereo_new(FRAME_SAMPLES * 2);
+  unsigned seed = 1;
+  double elapsed = 0;
+  blip_set_rates(mono, CLOCK_RATE, SAMPLE_RATE);
+  blip_stereo_set_rates(stereo, CLOCK_RATE, SAMPLE_RATE);
+  for (int frame = 0; frame < FRAMES; frame++) {
+    unsigned times[DELTAS_PER_FRAME];
+    int deltas[DELTAS_PER_FRAME][2];
+    for (int i = 0; i < DELTAS_PER_FRAME; i++) {
+      times[i] = nextRandom(&seed) % FRAME_CLOCKS;
+      deltas[i][0] = randomDelta(&seed);
+      deltas[i][1] = randomDelta(&seed);
+    }
+    double start = now();
+    if (_stereo) {
+      for (int i = 0; i < DELTAS_PER_FRAME; i++) {
+        blip_stereo_add_delta(stereo, times[i], deltas[i][0], deltas[i][1]);
+      }
+    } else {
+      for (int i = 0; i < DELTAS_PER_FRAME; i++) {
+        blip_add_delta(mono, times[i], deltas[i][0]);
+      }
+    }
+    elapsed += now() - start;
+    if (_stereo) {
+      blip_stereo_end_frame(stereo, FRAME_CLOCKS);
+      blip_stereo_read_samples(stereo, _out + frame * FRAME_SAMPLES * 2, FRAME_SAMPLES);
+    } else {
+      blip_end_frame(mono, FRAME_CLOCKS);
+      blip_read_samples(mono, _out + frame * FRAME_SAMPLES, FRAME_SAMPLES, false);
+    }
+  }
+  blip_delete(mono);
+  blip_stereo_delete(stereo);
+  return elapsed;
+}
+
+/**
+ * Best of REPEATS runs, in nanoseconds per delta
+ */
+static double bestRun(bool _stereo, short *_out) {
+  double best = 0;
+  for (int i = 0; i < REPEATS; i++) {
+    double elapsed = run(_stereo, _out);
+    if (i == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best * 1e9 / ((double) FRAMES * DELTAS_PER_FRAME);
+}
+
+int main() {
+  bool failed = false;
+  double scalar[2];
+  blip_set_impl(blip_impl_scalar);
+  for (int stereo = 0; stereo < 2; stereo++) {
+    scalar[stereo] = bestRun(stereo, sReference[stereo]);
+  }
+  printf("%-8s %14s %14s\n", "", "mono ns/delta", "stereo ns/delta");
+  printf("%-8s %14.2f %14.2f\n", sNames[blip_impl_scalar], scalar[0], scalar[1]);
+  for (int impl = blip_impl_scalar + 1; impl <= blip_impl_neon; impl++) {
+    if (!blip_set_impl(impl)) {
+      printf("%-8s %14s %14s\n", sNames[impl], "-", "-");
+      continue;
+    }
+    double ns[2];
+    bool match = true;
+    for (int stereo = 0; stereo < 2; stereo++) {
+      ns[stereo] = bestRun(stereo, sOutput[stereo]);
+      match = match && memcmp(sOutput[stereo], sReference[stereo], sizeof(sOutput[stereo])) == 0;
+    }
+    printf("%-8s %8.2f %4.1fx %8.2f %4.1fx  %s\n", sNames[impl], ns[0], scalar[0] / ns[0], ns[1], scalar[1] / ns[1],
+           match ? "identical" : "MISMATCH");
+    failed = failed || !match;
+  }
+  blip_set_impl(blip_impl_auto);
+  printf("auto selects %s\n", sNames[blip_get_impl()]);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+// Writes tables.h: the pitch, filter and font tables the engines and console would otherwise build at startup.
+// Run by the Makefile as `tools/gentables <sample rate> <clock rate> > tables.h`
+#include "../font.h"
+#include "../tablegen.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// lft's phase accumulator runs at the original hardware's 16 kHz whatever the output rate
+#define LFT_PHASE_RATE 16000.0
+#define LFT_NOTES 84
+#define M6581_CUTOFF_STEPS 2048
+
+static void header(double _sampleRate, double _clockRate) {
+  printf("// Generated by tools/gentables, do not edit; change the rates in the Makefile instead\n");
+  printf("#ifndef TABLES_H\n#define TABLES_H\n\n");
+  printf("#include \"types.h\"\n\n");
+  printf("#define TABLES_SAMPLE_RATE %.1f\n", _sampleRate);
+  printf("#define TABLES_CLOCK_RATE %.1f\n", _clockRate);
+}
+
+static void printU16s(const char *_declaration, const unsigned *_values, int _count) {
+  printf("\n%s = {", _declaration);
+  for (int i = 0; i < _count; i++) {
+    printf("%s0x%04x,", i % 12 == 0 ? "\n    " : " ", _values[i]);
+  }
+  printf("\n};\n");
+}
+
+/**
+ * p1xl oscillator periods for C0..B7 in clocks per 1/64 of a wave (tools/freq.php counted 1/32 at half the clock)
+ */
+static void p1xlWaveStep(double _clockRate) {
+  const double c7 = 1046.5;
+  const double q = pow(2.0, 1.0 / 12.0);
+  unsigned periods[8 * 12];
+  int n = 0;
+  for (int octave = 7; octave >= 0; octave--) {
+    for (int note = 0; note < 12; note++) {
+      double freq = c7 * pow(q, note) * pow(2, -octave);
+      periods[n++] = (unsigned) round(_clockRate / (freq * 64.0));
+    }
+  }
+  printU16s("static const u16 tables_p1xlWaveStep[8 * 12]", periods, 8 * 12);
+}
+
+/**
+ * lft phase increments for C1..B7 at LFT_PHASE_RATE, A4 = 440 Hz
+ */
+static void lftFreqTable() {
+  unsigned steps[LFT_NOTES];
+  for (int n = 0; n < LFT_NOTES; n++) {
+    steps[n] = (unsigned) floor(440.0 * pow(2.0, (n - 45) / 12.0) * 65536.0 / LFT_PHASE_RATE);
+  }
+  printU16s("static const u16 tables_lftFreq[84]", steps, LFT_NOTES);
+}
+
+/**
+ * Hann windowed sinc lowpass kernels for p1xl's 256 filter settings, in the float precision p1xl used to build them
+ */
+static void p1xlFilterKernels(double _sampleRate) {
+  printf("\nstatic const float tables_p1xlFilterKernels[256][%d] = {\n", TABLEGEN_P1XL_FILTER_LENGTH);
+  for (int f = 0; f < 256; f++) {
+    float kernel[TABLEGEN_P1XL_FILTER_LENGTH];
+    tablegen_p1xlFilterKernel(kernel, TABLEGEN_P1XL_FILTER_LENGTH, f, _sampleRate);
+    printf("    {");
+    for (int j = 0; j < TABLEGEN_P1XL_FILTER_LENGTH; j++) {
+      printf("%s%.8ef,", j == 0 ? "" : j % 6 == 0 ? "\n     " : " ", kernel[j]);
+    }
+    printf("},\n");
+  }
+  printf("};\n");
+}
+
+/**
+ * m6581.h's cutoff curve, used through M6581_CUTOFF_TABLE
+ */
+static void m6581CutoffFreq() {
+  printf("\nstatic const float tables_m6581CutoffFreq[%d] = {", M6581_CUTOFF_STEPS);
+  for (int i = 0; i < M6581_CUTOFF_STEPS; i++) {
+    printf("%s%.8ef,", i % 8 == 0 ? "\n    " : " ", tablegen_m6581Cutoff(i));
+  }
+  printf("\n};\n");
+}
+
+/**
+ * m6581.h's decimation filter, used through M6581_DECIMATE_TABLE
+ */
+static void m6581DecimateTaps() {
+  int32_t taps[TABLEGEN_M6581_DECIMATE_TAPS];
+  tablegen_m6581DecimateTaps(taps, TABLEGEN_M6581_DECIMATE_TAPS, TABLEGEN_M6581_DECIMATE_FACTOR);
+  printf("\nstatic const int32_t tables_m6581DecimateTaps[%d] = {", TABLEGEN_M6581_DECIMATE_TAPS);
+  for (int i = 0; i < TABLEGEN_M6581_DECIMATE_TAPS; i++) {
+    printf("%s%d,", i % 8 == 0 ? "\n    " : " ", taps[i]);
+  }
+  printf("\n};\n");
+}
+
+/**
+ * font.h expanded to the console's 128x128 alpha texture, 16x16 characters of 8x8 pixels
+ */
+static void fontTexture() {
+  static unsigned char texture[128 * 128];
+  for (int x = 0; x < 16; x++) {
+    for (int y = 0; y < 16; y++) {
+      for (int yy = 0; yy < 8; yy++) {
+        unsigned char row = font_data[((y * 16 + x) * 8) + yy];
+        for (int xx = 0; xx < 8; xx++) {
+          texture[((y * 8 + yy) * 128) + (x * 8 + xx)] = ((row >> (7 - xx)) & 1) * 255;
+        }
+      }
+    }
+  }
+  printf("\nstatic const u8 tables_fontTexture[128 * 128] = {");
+  for (int i = 0; i < 128 * 128; i++) {
+    printf("%s%d,", i % 32 == 0 ? "\n    " : " ", texture[i]);
+  }
+  printf("\n};\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s <sample rate> <clock rate>\n", argv[0]);
+    return 1;
+  }
+  double sampleRate = atof(argv[1]);
+  double clockRate = atof(argv[2]);
+  if (sampleRate <= 0 || clockRate <= 0) {
+    fprintf(stderr, "%s: rates must be positive\n", argv[0]);
+    return 1;
+  }
+  header(sampleRate, clockRate);
+  p1xlWaveStep(clockRate);
+  lftFreqTable();
+  p1xlFilterKernels(sampleRate);
+  m6581CutoffFreq();
+  m6581DecimateTaps();
+  fontTexture();
+  printf("\n#endif // ifndef TABLES_H\n");
+  return 0;
+}
@@ -0,0 +1,276 @@
+// Plays the same register program through m6581's per-clock filter and its multirate_filter mode, then compares
+// their spectra in 1/3-octave bands. Exits nonzero if any band up to CHECK_MAX_HZ differs by more than
+// CHECK_TOLERANCE_DB, or if the decimator lets through more than ALIAS_LIMIT_DB of aliasing on a bright tone.
+// Build with `make sidcheck`, then run ./sidcheck
+#define CHIPS_IMPL
+#include "../m6581.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#define TICK_HZ (985248)
+#define SAMPLE_RATE (44100)
+#define SECONDS (40)
+#define NUM_SAMPLES (SECONDS * SAMPLE_RATE)
+// Register program: a new note, waveform and filter setting every segment, the cutoff swept within it
+#define SEGMENT_SAMPLES (SAMPLE_RATE / 4)
+#define SWEEP_SAMPLES (SAMPLE_RATE / 200)
+// Welch spectrum: Hann windows overlapping by half
+#define FFT_SIZE (4096)
+#define NUM_BANDS (29)
+#define CHECK_MAX_HZ (16000.0)
+#define CHECK_TOLERANCE_DB (0.5)
+// Bands this far below the loudest one are left out of the check
+#define CHECK_FLOOR_DB (60.0)
+#define REPEATS (3)
+// Alias check: an unfiltered sawtooth at about 2.6 kHz, whose harmonics run far past the output Nyquist
+#define ALIAS_FREQ (44903)
+#define ALIAS_SECONDS (10)
+#define ALIAS_FFT_SIZE (16384)
+// Bins this close to a harmonic count as the tone
+#define ALIAS_HARMONIC_BINS (4)
+#define ALIAS_LIMIT_DB (-35.0)
+
+static int16_t sSamples[2][NUM_SAMPLES];
+static double sSpectrum[2][FFT_SIZE / 2 + 1];
+static double sAliasSpectrum[ALIAS_FFT_SIZE / 2 + 1];
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned nextRandom(unsigned *_seed) {
+  *_seed = *_seed * 1103515245u + 12345u;
+  return *_seed >> 8;
+}
+
+/**
+ * Starts a new segment: fresh notes, waveforms and envelopes on all voices and a fresh filter setting
+ */
+static void writeSegment(m6581_t *_sid, unsigned *_seed, int *_cutoff, int *_sweep) {
+  static const uint8_t waves[] = {0x10, 0x20, 0x40, 0x80, 0x30, 0x50};
+  for (int v = 0; v < 3; v++) {
+    uint8_t base = v * 7;
+    // Notes from about 30 Hz to 4 kHz
+    uint16_t freq = (uint16_t) (500.0 * pow(2.0, (nextRandom(_seed) % 84) / 12.0));
+    uint16_t pw = nextRandom(_seed) % 4096;
+    m6581_write(_sid, base + M6581_V1_CTRL, 0);
+    m6581_write(_sid, base + M6581_V1_FREQ_LO, freq & 0xFF);
+    m6581_write(_sid, base + M6581_V1_FREQ_HI, freq >> 8);
+    m6581_write(_sid, base + M6581_V1_PW_LO, pw & 0xFF);
+    m6581_write(_sid, base + M6581_V1_PW_HI, pw >> 8);
+    m6581_write(_sid, base + M6581_V1_ATKDEC, nextRandom(_seed) & 0x3F);
+    m6581_write(_sid, base + M6581_V1_SUSREL, 0xF0 | (nextRandom(_seed) % 16));
+    m6581_write(_sid, base + M6581_V1_CTRL, waves[nextRandom(_seed) % sizeof(waves)] | M6581_CTRL_GATE);
+  }
+  *_cutoff = nextRandom(_seed) % 2048;
+  *_sweep = (int) (nextRandom(_seed) % 33) - 16;
+  // Route a random set of voices through a random, non-empty filter mode at a random resonance
+  m6581_write(_sid, M6581_RES_FILT, (nextRandom(_seed) % 16) << 4 | (nextRandom(_seed) % 8));
+  m6581_write(_sid, M6581_MODE_VOL, (1 + nextRandom(_seed) % 7) << 4 | 0x0F);
+}
+
+/**
+ * Renders the register program into _out and returns the seconds spent in m6581_run
+ */
+static double render(bool _multirate, int16_t *_out) {
+  m6581_t sid;
+  m6581_init(&sid, &(m6581_desc_t) {
+      .tick_hz = TICK_HZ,
+      .sound_hz = SAMPLE_RATE,
+      .magnitude = 1.0f,
+      .multirate_filter = _multirate,
+  });
+  unsigned seed = 1;
+  int cutoff = 0;
+  int sweep = 0;
+  int pos = 0;
+  double elapsed = 0;
+  while (pos < NUM_SAMPLES) {
+    if (pos % SEGMENT_SAMPLES == 0) {
+      writeSegment(&sid, &seed, &cutoff, &sweep);
+    }
+    cutoff = cutoff + sweep < 0 ? 0 : (cutoff + sweep > 2047 ? 2047 : cutoff + sweep);
+    m6581_write(&sid, M6581_FC_LO, cutoff & 7);
+    m6581_write(&sid, M6581_FC_HI, cutoff >> 3);
+    int len = NUM_SAMPLES - pos < SWEEP_SAMPLES ? NUM_SAMPLES - pos : SWEEP_SAMPLES;
+    int done = 0;
+    double start = now();
+    while (done < len) {
+      int produced = 0;
+      m6581_run(&sid, TICK_HZ, _out + pos + done, len - done, &produced);
+      done += produced;
+    }
+    elapsed += now() - start;
+    pos += len;
+  }
+  return elapsed;
+}
+
+/**
+ * Renders ALIAS_SECONDS of the alias check tone into _out
+ * @return The tone's frequency in Hz, at the tick rate the decimator actually runs at
+ */
+static double renderTone(int16_t *_out) {
+  m6581_t sid;
+  m6581_init(&sid, &(m6581_desc_t) {
+      .tick_hz = TICK_HZ,
+      .sound_hz = SAMPLE_RATE,
+      .magnitude = 1.0f,
+  });
+  m6581_write(&sid, M6581_MODE_VOL, 0x0F);
+  m6581_write(&sid, M6581_V1_FREQ_LO, ALIAS_FREQ & 0xFF);
+  m6581_write(&sid, M6581_V1_FREQ_HI, ALIAS_FREQ >> 8);
+  m6581_write(&sid, M6581_V1_SUSREL, 0xF0);
+  m6581_write(&sid, M6581_V1_CTRL, M6581_CTRL_SAWTOOTH | M6581_CTRL_GATE);
+  for (int done = 0; done < ALIAS_SECONDS * SAMPLE_RATE;) {
+    int produced = 0;
+    m6581_run(&sid, TICK_HZ, _out + done, ALIAS_SECONDS * SAMPLE_RATE - done, &produced);
+    done += produced;
+  }
+  return ALIAS_FREQ * ((double) SAMPLE_RATE * sid.sample_period / M6581_FIXEDPOINT_SCALE) / (1 << 24);
+}
+
+/**
+ * In-place radix-2 FFT
+ */
+static void fft(double *_re, double *_im, int _n) {
+  for (int i = 1, j = 0; i < _n; i++) {
+    int bit = _n >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j |= bit;
+    if (i < j) {
+      double t = _re[i];
+      _re[i] = _re[j];
+      _re[j] = t;
+      t = _im[i];
+      _im[i] = _im[j];
+      _im[j] = t;
+    }
+  }
+  for (int len = 2; len <= _n; len <<= 1) {
+    double angle = -2.0 * M_PI / len;
+    for (int i = 0; i < _n; i += len) {
+      for (int k = 0; k < len / 2; k++) {
+        double wr = cos(angle * k);
+        double wi = sin(angle * k);
+        double *ar = &_re[i + k];
+        double *ai = &_im[i + k];
+        double *br = &_re[i + k + len / 2];
+        double *bi = &_im[i + k + len / 2];
+        double tr = *br * wr - *bi * wi;
+        double ti = *br * wi + *bi * wr;
+        *br = *ar - tr;
+        *bi = *ai - ti;
+        *ar += tr;
+        *ai += ti;
+      }
+    }
+  }
+}
+
+/**
+ * Averages the power spectra of half-overlapping Hann windowed blocks
+ */
+static void welch(const int16_t *_samples, int _len, double *_spectrum, int _size) {
+  static double re[ALIAS_FFT_SIZE > FFT_SIZE ? ALIAS_FFT_SIZE : FFT_SIZE];
+  static double im[ALIAS_FFT_SIZE > FFT_SIZE ? ALIAS_FFT_SIZE : FFT_SIZE];
+  int blocks = 0;
+  for (int start = 0; start + _size <= _len; start += _size / 2, blocks++) {
+    for (int i = 0; i < _size; i++) {
+      double window = 0.5 - 0.5 * cos(2.0 * M_PI * i / _size);
+      re[i] = _samples[start + i] / 32768.0 * window;
+      im[i] = 0;
+    }
+    fft(re, im, _size);
+    for (int i = 0; i <= _size / 2; i++) {
+      _spectrum[i] += re[i] * re[i] + im[i] * im[i];
+    }
+  }
+  for (int i = 0; i <= _size / 2; i++) {
+    _spectrum[i] /= blocks;
+  }
+}
+
+/**
+ * Power in dB of the bins between two frequencies
+ */
+static double bandPower(const double *_spectrum, double _low, double _high) {
+  double sum = 1e-30;
+  for (int i = 1; i <= FFT_SIZE / 2; i++) {
+    double hz = (double) i * SAMPLE_RATE / FFT_SIZE;
+    if (hz >= _low && hz < _high) {
+      sum += _spectrum[i];
+    }
+  }
+  return 10.0 * log10(sum);
+}
+
+int main() {
+  double best[2];
+  for (int mode = 0; mode < 2; mode++) {
+    for (int i = 0; i < REPEATS; i++) {
+      double elapsed = render(mode, sSamples[mode]);
+      if (i == 0 || elapsed < best[mode]) {
+        best[mode] = elapsed;
+      }
+    }
+    welch(sSamples[mode], NUM_SAMPLES, sSpectrum[mode], FFT_SIZE);
+  }
+  printf("per-clock %.1fx real time, multirate %.1fx real time\n", SECONDS / best[0], SECONDS / best[1]);
+
+  // 1/3-octave bands centred on 1 kHz, from 31.5 Hz up; lower ones fall between FFT bins
+  double centers[NUM_BANDS];
+  double power[2][NUM_BANDS];
+  double loudest = -1e30;
+  for (int band = 0; band < NUM_BANDS; band++) {
+    centers[band] = 1000.0 * pow(2.0, (band - 15) / 3.0);
+    for (int mode = 0; mode < 2; mode++) {
+      power[mode][band] = bandPower(sSpectrum[mode], centers[band] * pow(2.0, -1.0 / 6.0),
+                                    centers[band] * pow(2.0, 1.0 / 6.0));
+    }
+    if (centers[band] <= CHECK_MAX_HZ && power[0][band] > loudest) {
+      loudest = power[0][band];
+    }
+  }
+  bool failed = false;
+  double worst = 0;
+  printf("%8s %10s %10s %8s\n", "band Hz", "per-clock", "multirate", "diff dB");
+  for (int band = 0; band < NUM_BANDS; band++) {
+    double diff = power[1][band] - power[0][band];
+    bool checked = centers[band] <= CHECK_MAX_HZ && power[0][band] > loudest - CHECK_FLOOR_DB;
+    bool bad = checked && fabs(diff) > CHECK_TOLERANCE_DB;
+    if (checked && fabs(diff) > fabs(worst)) {
+      worst = diff;
+    }
+    printf("%8.0f %10.1f %10.1f %+8.2f%s\n", centers[band], power[0][band], power[1][band], diff,
+           bad ? "  FAIL" : (checked ? "" : "  (not checked)"));
+    failed = failed || bad;
+  }
+  printf("worst checked band %+.2f dB, tolerance %.1f dB: %s\n", worst, CHECK_TOLERANCE_DB, failed ? "FAIL" : "OK");
+
+  // Whatever isn't near a harmonic of the tone (or DC) has been folded down from above the output Nyquist
+  double toneHz = renderTone(sSamples[0]);
+  welch(sSamples[0], ALIAS_SECONDS * SAMPLE_RATE, sAliasSpectrum, ALIAS_FFT_SIZE);
+  double harmonics = 1e-30;
+  double aliases = 1e-30;
+  for (int i = ALIAS_HARMONIC_BINS + 1; i <= ALIAS_FFT_SIZE / 2; i++) {
+    double hz = (double) i * SAMPLE_RATE / ALIAS_FFT_SIZE;
+    double harmonic = round(hz / toneHz) * toneHz;
+    if (harmonic > 0 && fabs(hz - harmonic) <= ALIAS_HARMONIC_BINS * (double) SAMPLE_RATE / ALIAS_FFT_SIZE) {
+      harmonics += sAliasSpectrum[i];
+    } else {
+      aliases += sAliasSpectrum[i];
+    }
+  }
+  double aliasDb = 10.0 * log10(aliases / harmonics);
+  bool aliasFailed = aliasDb > ALIAS_LIMIT_DB;
+  printf("aliasing on a %.0f Hz sawtooth %.1f dB below the tone, limit %.1f dB: %s\n", toneHz, -aliasDb,
+         -ALIAS_LIMIT_DB, aliasFailed ? "FAIL" : "OK");
+  return failed || aliasFailed ? 1 : 0;
+}
@@ -1,11 +1,20 @@
 
 #include <strings.h>
+#include <err.h>
 #include "tracker.h"
 #include "console.h"
 #include "chip.h"
+#include "wav.h"
+#include "cmdqueue.h"
+#include "timing.h"
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define EXPORT_BLOCK (4096)
+#define EXPORT_LOOPS (1)
+#define EXPORT_FADE_SECONDS (0)
+// Songs whose loop the detector never sees are cut here rather than hanging the UI
+#define EXPORT_MAX_SECONDS (300)
 
 typedef struct {
   int x1;
@@ -540,6 +549,15 @@ u8 sOctave = 4;
 char *sFilename = "";
 const char *sChipName;
 ChipInterface *sChip;
+ChipContext *sChipContext;
+// Set from the command line: play through the engine's cheaper model, but export with the accurate one
+bool sFastPreview = false;
+// Rate the audio device was opened at; the engine renders and exports at the same rate
+u32 sSampleRate = CHIP_DEFAULT_SAMPLE_RATE;
+// Engine commands from the UI, applied by the audio thread between blocks
+CmdQueue sCommands;
+// How long rendering and the SDL callback take compared to the audio they produce
+TimingHistogram sRenderTiming;
 int sSongX = 0, sSongY = 0;
 int sSelectedChannel = 0;
 int sPatternX = 0, sPatternY = 0;
@@ -556,34 +574,72 @@ bool sbEditing = false;
 bool sbShowKeys = false;
 u8 sPlonkNote = 0;
 
+/**
+ * Takes the engine from the producer thread for an edit, which is always made in place. Play commands still
+ * waiting in the queue are applied first so they reach the engine in the order they were made.
+ */
+static void lockEngine() {
+  con_lockAudio();
+  cmdqueue_drain(&sCommands, sChip, sChipContext);
+}
+
+static void unlockEngine() {
+  con_unlockAudio();
+}
+
 void tracker_onChangeInstrumentName(TextEdit *_te, TrackerTextEditKey _exitKey) {
-  sChip->setInstrumentName(sSelectedInstrument,
+  lockEngine();
+  sChip->setInstrumentName(sChipContext, sSelectedInstrument,
                            sTEInstrumentName->lastString);
+  unlockEngine();
   if (_exitKey == TEK_UP) {
     tracker_instrumentMoveUp();
   }
 }
 
 void tracker_init() {
-  sChip->init();
-  con_error(sChip->loadSong(sFilename));
-  sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+  ChipError error = sChip->init(&sChipContext, sSampleRate);
+  if (error != NO_ERR) {
+    errx(1, "%s: %s", sChipName, error);
+  }
+  cmdqueue_init(&sCommands);
+  timing_init(&sRenderTiming, "RENDER VS RING DEADLINE");
+  if (sFastPreview) {
+    con_error(sChip->setFastPreview(sChipContext, true));
+  }
+  con_error(sChip->loadSong(sChipContext, sFilename));
+  sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
 
-  int count = sChip->getNumTableKinds();
+  int count = sChip->getNumTableKinds(sChipContext);
   sSelectedTable = malloc(sizeof(u16) * count);
   for (size_t i = 0; i < count; i++) {
-    sSelectedTable[i] = sChip->getMinTable(i);
+    sSelectedTable[i] = sChip->getMinTable(sChipContext, i);
   }
   sTextEditRoot_Editor = NULL;
 
   sTEInstrumentName = TextEdit_new(&sTextEditRoot_Editor, 20, 2, 40, 16, true, false, "",
                                    tracker_onChangeInstrumentName, NULL);
 
-  sOctave = sChip->getMaxOctave() / 2;
+  sOctave = sChip->getMaxOctave(sChipContext) / 2;
+}
+
+static void printTimingLine(char *_line) {
+  printf("%s\n", _line);
+}
+
+/**
+ * Writes the render histogram followed by the ring underruns, which are what a miss is heard as
+ */
+static void printTiming(void (*_print)(char *_line)) {
+  char line[64];
+  timing_print(&sRenderTiming, sChipName, _print);
+  snprintf(line, sizeof(line), "  RING UNDERRUNS: %u", con_audioUnderruns());
+  _print(line);
 }
 
 void tracker_destroy() {
-  sChip->shutdown();
+  printTiming(printTimingLine);
+  sChip->shutdown(sChipContext);
   free(sSelectedTable);
 }
 
@@ -591,6 +647,14 @@ void tracker_setFilename(char *filename) {
   sFilename = filename;
 }
 
+void tracker_setFastPreview(bool _fast) {
+  sFastPreview = _fast;
+}
+
+void tracker_setSampleRate(u32 _sampleRate) {
+  sSampleRate = _sampleRate;
+}
+
 void *tracker_setChipName(char *chipName) {
   int i = 0;
   do {
@@ -623,7 +687,7 @@ int tracker_drawPatternEditorCentered(int _x, int _y, int _height) {
   con_printXY(_x, _y, "PATTERN");
 
   static int patternOffset = 0;
-  int numChannels = sChip->getNumChannels();
+  int numChannels = sChip->getNumChannels(sChipContext);
   int width = 3;
   if (sPatternY < patternOffset) {
     patternOffset = sPatternY;
@@ -634,9 +698,9 @@ int tracker_drawPatternEditorCentered(int _x, int _y, int _height) {
 
   u8 maxPatternLen = 0;
   for (size_t i = 0; i < numChannels; i++) {
-    int patternNum = sChip->getPatternNum(sSongY, i);
+    int patternNum = sChip->getPatternNum(sChipContext, sSongY, i);
     if (patternNum >= 0) {
-      u8 patternLen = sChip->getPatternLen(patternNum);
+      u8 patternLen = sChip->getPatternLen(sChipContext, patternNum);
       if (patternLen > maxPatternLen) {
         maxPatternLen = patternLen;
       }
@@ -667,18 +731,18 @@ int tracker_drawPatternEditorCentered(int _x, int _y, int _height) {
     }
   }
   for (size_t i = 0; i < numChannels; i++) {
-    int patternNum = sChip->getPatternNum(sSongY, i);
-    int patternLen = sChip->getPatternLen(patternNum);
+    int patternNum = sChip->getPatternNum(sChipContext, sSongY, i);
+    int patternLen = sChip->getPatternLen(sChipContext, patternNum);
 
     // Compute pattern width
     int patternWidth = 0;
     for (int j = 0; j < heightOfRows; j++) {
       int row = sPatternY - halfHeightOfRows + j;
       if (row >= 0 && row < patternLen) {
-        int w = sChip->getNumPatternDataColumns(i, patternNum, row);
+        int w = sChip->getNumPatternDataColumns(sChipContext, i, patternNum, row);
         int tw = 0;
         for (size_t k = 0; k < w; k++) {
-          ChipDataType type = sChip->getPatternDataType(i, patternNum, row, k);
+          ChipDataType type = sChip->getPatternDataType(sChipContext, i, patternNum, row, k);
           switch (type) {
             case CDT_LABEL:
             case CDT_HEX:
@@ -697,7 +761,7 @@ int tracker_drawPatternEditorCentered(int _x, int _y, int _height) {
     con_setAttrib(0x07);
     con_printfXY(_x + i * (patternWidth + 1) + 3, _y + 1, "%02X", patternNum);
     con_setAttrib(0x08);
-    con_printXY(_x + i * (patternWidth + 1) + 6, _y + 1, sChip->getChannelName(i, patternWidth - 2));
+    con_printXY(_x + i * (patternWidth + 1) + 6, _y + 1, sChip->getChannelName(sChipContext, i, patternWidth - 2));
     for (int j = 0; j < heightOfRows; j++) {
       int row = sPatternY - halfHeightOfRows + j;
       if (row >= 0 && row < patternLen) {
@@ -711,7 +775,7 @@ int tracker_drawPatternEditorCentered(int _x, int _y, int _height) {
           con_setAttrib(0x07);
         }
         con_gotoXY(_x + i * (patternWidth + 1) + 3, _y + j + 2);
-        int w = sChip->getNumPatternDataColumns(i, patternNum, row);
+        int w = sChip->getNumPatternDataColumns(sChipContext, i, patternNum, row);
         for (size_t k = 0; k < w; k++) {
           if (sPatternY == row && sSelectedChannel == i) {
             con_setAttrib(0x4F);
@@ -723,8 +787,8 @@ int tracker_drawPatternEditorCentered(int _x, int _y, int _height) {
               }
             }
           }
-          ChipDataType type = sChip->getPatternDataType(i, patternNum, row, k);
-          u8 data = sChip->getPatternData(i, patternNum, row, k);
+          ChipDataType type = sChip->getPatternDataType(sChipContext, i, patternNum, row, k);
+          u8 data = sChip->getPatternData(sChipContext, i, patternNum, row, k);
           switch (type) {
             case CDT_LABEL: hit = addHit(rectRel(1), TRACKER_EDIT_ANY);
               con_putc(data);
@@ -769,7 +833,7 @@ int tracker_drawPatternEditor(int _x, int _y, int _height) {
   con_printXY(_x, _y, "PATTERN");
 
   static int patternOffset = 0;
-  int numChannels = sChip->getNumChannels();
+  int numChannels = sChip->getNumChannels(sChipContext);
   int width = 3;
   if (sPatternY < patternOffset) {
     patternOffset = sPatternY;
@@ -779,8 +843,8 @@ int tracker_drawPatternEditor(int _x, int _y, int _height) {
   }
   u8 maxPatternLen = 0;
   for (size_t i = 0; i < numChannels; i++) {
-    int patternNum = sChip->getPatternNum(sSongY, i);
-    int patternLen = sChip->getPatternLen(patternNum);
+    int patternNum = sChip->getPatternNum(sChipContext, sSongY, i);
+    int patternLen = sChip->getPatternLen(sChipContext, patternNum);
     maxPatternLen = (patternLen > maxPatternLen) ? patternLen : maxPatternLen;
   }
   u8 quarter = maxPatternLen >> 2;
@@ -807,16 +871,16 @@ int tracker_drawPatternEditor(int _x, int _y, int _height) {
     }
   }
   for (size_t i = 0; i < numChannels; i++) {
-    int patternNum = sChip->getPatternNum(sSongY, i);
-    int patternLen = sChip->getPatternLen(patternNum);
+    int patternNum = sChip->getPatternNum(sChipContext, sSongY, i);
+    int patternLen = sChip->getPatternLen(sChipContext, patternNum);
 
     // Compute pattern width
     int patternWidth = 0;
     for (size_t j = 0; j < patternLen; j++) {
-      int w = sChip->getNumPatternDataColumns(i, patternNum, j);
+      int w = sChip->getNumPatternDataColumns(sChipContext, i, patternNum, j);
       int tw = 0;
       for (size_t k = 0; k < w; k++) {
-        ChipDataType type = sChip->getPatternDataType(i, patternNum, j, k);
+        ChipDataType type = sChip->getPatternDataType(sChipContext, i, patternNum, j, k);
         switch (type) {
           case CDT_LABEL:
           case CDT_HEX:
@@ -834,7 +898,7 @@ int tracker_drawPatternEditor(int _x, int _y, int _height) {
     con_setAttrib(0x07);
     con_printfXY(_x + i * (patternWidth + 1) + 3, _y + 1, "%02X", patternNum);
     con_setAttrib(0x08);
-    con_printXY(_x + i * (patternWidth + 1) + 6, _y + 1, sChip->getChannelName(i, patternWidth - 2));
+    con_printXY(_x + i * (patternWidth + 1) + 6, _y + 1, sChip->getChannelName(sChipContext, i, patternWidth - 2));
     for (size_t j = 0; j < patternLen; j++) {
       if (sSelectedChannel == i && sPatternY == j) {
         con_setAttrib(0x70);
@@ -843,7 +907,7 @@ int tracker_drawPatternEditor(int _x, int _y, int _height) {
       }
       if (j >= patternOffset && j - patternOffset < _height - 1) {
         con_gotoXY(_x + i * (patternWidth + 1) + 3, _y + j + 2);
-        int w = sChip->getNumPatternDataColumns(i, patternNum, j);
+        int w = sChip->getNumPatternDataColumns(sChipContext, i, patternNum, j);
         for (size_t k = 0; k < w; k++) {
           if (sPatternY == j && sSelectedChannel == i) {
             con_setAttrib(0x70);
@@ -851,8 +915,8 @@ int tracker_drawPatternEditor(int _x, int _y, int _height) {
               con_setAttrib(0x170);
             }
           }
-          ChipDataType type = sChip->getPatternDataType(i, patternNum, j, k);
-          u8 data = sChip->getPatternData(i, patternNum, j, k);
+          ChipDataType type = sChip->getPatternDataType(sChipContext, i, patternNum, j, k);
+          u8 data = sChip->getPatternData(sChipContext, i, patternNum, j, k);
           switch (type) {
             case CDT_LABEL: hit = addHit(rectRel(1), TRACKER_EDIT_ANY);
               con_putc(data);
@@ -896,8 +960,8 @@ int tracker_drawInstrumentEditor(int _x, int _y, int _height) {
   if (sInstrumentY >= instOffset + _height) {
     instOffset = sInstrumentY - _height + 1;
   }
-  int instLen = sChip->getInstrumentLen(sSelectedInstrument);
-  int numParams = sChip->getNumInstrumentParams(sSelectedInstrument);
+  int instLen = sChip->getInstrumentLen(sChipContext, sSelectedInstrument);
+  int numParams = sChip->getNumInstrumentParams(sChipContext, sSelectedInstrument);
   // Draw line numbers
   for (size_t instRow = 0; instRow < instLen; instRow++) {
     if (instRow >= instOffset && instRow - instOffset < _height - 1) {
@@ -909,7 +973,7 @@ int tracker_drawInstrumentEditor(int _x, int _y, int _height) {
       }
       hit = addHit(rectRel(3), TRACKER_EDIT_ANY);
       hit->instrumentY = instRow;
-      con_printf(sChip->getInstrumentLabel(sSelectedInstrument, instRow));
+      con_printf(sChip->getInstrumentLabel(sChipContext, sSelectedInstrument, instRow));
       con_putc(':');
     }
   }
@@ -920,9 +984,9 @@ int tracker_drawInstrumentEditor(int _x, int _y, int _height) {
     int paramWidth = 0;
     for (size_t instRow = 0; instRow < instLen; instRow++) {
       int width = 0;
-      int numData = sChip->getNumInstrumentData(sSelectedInstrument, param, instRow);
+      int numData = sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, param, instRow);
       for (size_t dataColumn = 0; dataColumn < numData; dataColumn++) {
-        ChipDataType type = sChip->getInstrumentDataType(sSelectedInstrument, param, instRow, dataColumn);
+        ChipDataType type = sChip->getInstrumentDataType(sChipContext, sSelectedInstrument, param, instRow, dataColumn);
         switch (type) {
           case CDT_LABEL: width++;
             break;
@@ -941,7 +1005,7 @@ int tracker_drawInstrumentEditor(int _x, int _y, int _height) {
     // Draw params
     con_setAttrib(0x08);
     con_printXY(_x + 1 + instWidth, _y + 2,
-                sChip->getInstrumentParamName(sSelectedInstrument, param, paramWidth));
+                sChip->getInstrumentParamName(sChipContext, sSelectedInstrument, param, paramWidth));
     for (size_t instRow = 0; instRow < instLen; instRow++) {
       // Highlight param
       for (int i = 0; i < paramWidth; ++i) {
@@ -954,10 +1018,11 @@ int tracker_drawInstrumentEditor(int _x, int _y, int _height) {
 
       if (instRow >= instOffset && instRow - instOffset < _height - 2) {
         con_gotoXY(_x + 1 + instWidth, _y + 3 + instRow - instOffset);
-        int numData = sChip->getNumInstrumentData(sSelectedInstrument, param, instRow);
+        int numData = sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, param, instRow);
         for (size_t dataColumn = 0; dataColumn < numData; dataColumn++) {
-          ChipDataType type = sChip->getInstrumentDataType(sSelectedInstrument, param, instRow, dataColumn);
-          u8 data = sChip->getInstrumentData(sSelectedInstrument, param, instRow, dataColumn);
+          ChipDataType type = sChip->getInstrumentDataType(sChipContext, sSelectedInstrument, param, instRow,
+                                                           dataColumn);
+          u8 data = sChip->getInstrumentData(sChipContext, sSelectedInstrument, param, instRow, dataColumn);
           if (instRow == sInstrumentY) {
             if (dataColumn == sInstrumentX &&
                 param == sInstrumentParam &&
@@ -1032,18 +1097,18 @@ int tracker_drawInstrumentEditor(int _x, int _y, int _height) {
   if (!sTEInstrumentName->isActive) {
     TextEdit_width(sTEInstrumentName, instWidth - 2);
     TextEdit_set(sTEInstrumentName,
-                 sChip->getInstrumentName(sSelectedInstrument,
+                 sChip->getInstrumentName(sChipContext, sSelectedInstrument,
                                           sTEInstrumentName->maxWidth));
   }
   con_printfXY(_x, _y + 2, "%02X", sSelectedInstrument);
 
   // Highlight playing instrument
-  for (int i = 0; i < sChip->getNumChannels(); i++) {
-    if (sChip->getPlayerInstrument(i) == sSelectedInstrument) {
+  for (int i = 0; i < sChip->getNumChannels(sChipContext); i++) {
+    if (sChip->getPlayerInstrument(sChipContext, i) == sSelectedInstrument) {
       for (int j = 0; j < instWidth; j++) {
         u16 attrib = con_getAttribXY(_x + j, _y + 2);
         attrib = (attrib & 0xFF0) | 0xB;
-        con_setAttribXY(_x + j, _y + 3 + sChip->getPlayerInstrumentRow(i), attrib);
+        con_setAttribXY(_x + j, _y + 3 + sChip->getPlayerInstrumentRow(sChipContext, i), attrib);
       }
       break;
     }
@@ -1066,7 +1131,7 @@ int tracker_drawSongEditor(int _x, int _y, int _height) {
   }
   con_printXY(_x, _y, "SONG");
   static int songOffset = 0;
-  int songLength = sChip->getNumSongRows();
+  int songLength = sChip->getNumSongRows(sChipContext);
   int songWidth = 0;
   if (sSongY < songOffset) {
     songOffset = sSongY;
@@ -1074,7 +1139,7 @@ int tracker_drawSongEditor(int _x, int _y, int _height) {
   if (sSongY >= songOffset + _height) {
     songOffset = sSongY - _height + 1;
   }
-  int numChannels = sChip->getNumChannels();
+  int numChannels = sChip->getNumChannels(sChipContext);
   for (int songRow = 0; songRow < songLength; songRow++) {
     int width = 0;
     if (songRow >= songOffset && songRow - songOffset < _height) {
@@ -1092,7 +1157,7 @@ int tracker_drawSongEditor(int _x, int _y, int _height) {
 
       con_setAttrib(0x07);
       for (int channel = 0; channel < numChannels; channel++) {
-        int numCols = sChip->getNumSongDataColumns(channel);
+        int numCols = sChip->getNumSongDataColumns(sChipContext, channel);
         for (size_t dataColumn = 0; dataColumn < numCols; dataColumn++) {
           if (songRow == sSongY) {
             con_setAttrib(0x47);
@@ -1108,8 +1173,8 @@ int tracker_drawSongEditor(int _x, int _y, int _height) {
               }
             }
           }
-          ChipDataType type = sChip->getSongDataType(songRow, channel, dataColumn);
-          u8 data = sChip->getSongData(songRow, channel, dataColumn);
+          ChipDataType type = sChip->getSongDataType(sChipContext, songRow, channel, dataColumn);
+          u8 data = sChip->getSongData(sChipContext, songRow, channel, dataColumn);
           switch (type) {
             case CDT_HEX: hit = addHit(rectRel(1), TRACKER_EDIT_ANY);
               hit->trackerState = TRACKER_EDIT_SONG;
@@ -1173,8 +1238,8 @@ int tracker_drawMetaData(int _x, int _y, int _width) {
   con_setAttrib(0x07);
 
   size_t titleWidth = 0;
-  for (int i = 0; i < sChip->getNumMetaData(); ++i) {
-    ChipMetaDataEntry *metaData = sChip->getMetaData(i);
+  for (int i = 0; i < sChip->getNumMetaData(sChipContext); ++i) {
+    ChipMetaDataEntry *metaData = sChip->getMetaData(sChipContext, i);
     if (strlen(metaData->name) > titleWidth) {
       titleWidth = strlen(metaData->name);
     }
@@ -1187,8 +1252,8 @@ int tracker_drawMetaData(int _x, int _y, int _width) {
     con_setAttribXY(_x + i, _y + sMetaDataY + 1, 0x4F);
   }
 
-  for (int i = 0; i < sChip->getNumMetaData(); ++i) {
-    ChipMetaDataEntry *metaData = sChip->getMetaData(i);
+  for (int i = 0; i < sChip->getNumMetaData(sChipContext); ++i) {
+    ChipMetaDataEntry *metaData = sChip->getMetaData(sChipContext, i);
     if (sMetaDataY == i) {
       con_setAttrib(0x4F);
     } else {
@@ -1235,7 +1300,7 @@ int tracker_drawMetaData(int _x, int _y, int _width) {
       case CMDT_DECIMAL:break; // TODO: Implement
     }
   }
-  return sChip->getNumMetaData();
+  return sChip->getNumMetaData(sChipContext);
 }
 
 void tracker_drawKeys(int _x, int _y, int _height) {
@@ -1262,7 +1327,7 @@ void tracker_drawKeys(int _x, int _y, int _height) {
 }
 
 void tracker_drawTableBar(int _x, int _y, int _offset, int _val, bool _marked) {
-  if (sChip->getTableStyle(sSelectedTableKind) == CTS_BOTTOM) {
+  if (sChip->getTableStyle(sChipContext, sSelectedTableKind) == CTS_BOTTOM) {
     if (_marked) {
       con_setAttrib(0x0f);
     } else {
@@ -1339,13 +1404,13 @@ void tracker_drawTables(int _x, int _y) {
   // Titles
   con_printXY(_x, _y, "TABLES");
   con_gotoXY(_x, _y + 1);
-  for (size_t i = 0; i < sChip->getNumTableKinds(); i++) {
+  for (size_t i = 0; i < sChip->getNumTableKinds(sChipContext); i++) {
     if (sSelectedTableKind == i) {
       con_setAttrib(0x70);
     } else {
       con_setAttrib(0x07);
     }
-    const char *name = sChip->getTableKindName(i);
+    const char *name = sChip->getTableKindName(sChipContext, i);
     hit = addHit(rectRel(strlen(name) + 6), TRACKER_EDIT_ANY);
     hit->trackerState = TRACKER_EDIT_TABLE;
     hit->selectedTableKind = i;
@@ -1359,9 +1424,9 @@ void tracker_drawTables(int _x, int _y) {
   // Data
   int cols = con_columns() - _x;
 
-  int dataLen = sChip->getTableDataLen(sSelectedTableKind, sSelectedTable[sSelectedTableKind]);
+  int dataLen = sChip->getTableDataLen(sChipContext, sSelectedTableKind, sSelectedTable[sSelectedTableKind]);
   for (size_t i = 0; i < cols; i++) {
-    u8 data = sChip->getTableData(sSelectedTableKind,
+    u8 data = sChip->getTableData(sChipContext, sSelectedTableKind,
                                   sSelectedTable[sSelectedTableKind],
                                   i);
     tracker_drawTableBar(_x + 1, _y + 2, i,
@@ -1373,11 +1438,11 @@ void tracker_drawTables(int _x, int _y) {
 
 void tracker_drawScreen() {
   clearHits();
-  if (sChip->isPlaying()) {
+  if (sChip->isPlaying(sChipContext)) {
     // TODO: add follow flag
-    sSongY = sChip->getPlayerSongRow(sSelectedChannel);
-    sPatternY = sChip->getPlayerPatternRow(sSelectedChannel);
-    sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+    sSongY = sChip->getPlayerSongRow(sChipContext, sSelectedChannel);
+    sPatternY = sChip->getPlayerPatternRow(sChipContext, sSelectedChannel);
+    sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
   }
   con_cls();
   con_setAttrib(0x06);
@@ -1395,7 +1460,7 @@ void tracker_drawScreen() {
     if (width < con_columns()) {
       width += tracker_drawInstrumentEditor(width + 1, 1, con_rows() - 3) + 1;
       if (width < con_columns()) {
-        if (sChip->useTables()) {
+        if (sChip->useTables(sChipContext)) {
           if (con_rows() > 20) {
             tracker_drawTables(width + 1, 1);
             con_setAttrib(0x08);
@@ -1417,7 +1482,7 @@ void tracker_drawScreen() {
           if (sbShowKeys) {
             tracker_drawKeys(width + 1, 1, con_rows() - 3);
           } else {
-            if (sChip->getNumMetaData() > 0) {
+            if (sChip->getNumMetaData(sChipContext) > 0) {
               int teX = width + 1;
               int teWidth = con_columns() - teX;
               int split = tracker_drawMetaData(width + 1, 1, teWidth) + 2;
@@ -1443,15 +1508,16 @@ void tracker_drawScreen() {
   const char *statusBarText = "";
   switch (sTrackerState) {
     case TRACKER_EDIT_SONG: {
-      statusBarText = sChip->getSongHelp(sSongY, sSelectedChannel, sSongX);
+      statusBarText = sChip->getSongHelp(sChipContext, sSongY, sSelectedChannel, sSongX);
       break;
     }
     case TRACKER_EDIT_PATTERN: {
-      statusBarText = sChip->getPatternHelp(sSelectedChannel, sSelectedPattern, sPatternY, sPatternX);
+      statusBarText = sChip->getPatternHelp(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY, sPatternX);
       break;
     }
     case TRACKER_EDIT_INSTRUMENT: {
-      statusBarText = sChip->getInstrumentHelp(sSelectedInstrument, sInstrumentParam, sInstrumentY, sInstrumentX);
+      statusBarText = sChip->getInstrumentHelp(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY,
+                                               sInstrumentX);
       break;
     }
     default: statusBarText = "";
@@ -1480,42 +1546,47 @@ void tracker_drawScreen() {
 } /* tracker_drawScreen */
 
 void tracker_getSamples(ChipSample *_buf, int _len) {
-  sChip->getSamples(_buf, _len);
+  cmdqueue_drain(&sCommands, sChip, sChipContext);
+  sChip->getSamples(sChipContext, _buf, _len);
+}
+
+void tracker_recordRenderTime(double _elapsed, double _deadline) {
+  timing_record(&sRenderTiming, _elapsed, _deadline);
 }
 
 void tracker_songMoveLeft() {
   do {
     if (sSongX == 0) {
       if (sSelectedChannel == 0) {
-        sSelectedChannel = sChip->getNumChannels() - 1;
+        sSelectedChannel = sChip->getNumChannels(sChipContext) - 1;
       } else {
         sSelectedChannel--;
       }
-      sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
-      sSongX = sChip->getNumSongDataColumns(sSelectedChannel) - 1;
+      sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
+      sSongX = sChip->getNumSongDataColumns(sChipContext, sSelectedChannel) - 1;
     } else {
       sSongX--;
     }
-  } while (sChip->getSongDataType(sSongY, sSelectedChannel, sSongX) == CDT_LABEL);
+  } while (sChip->getSongDataType(sChipContext, sSongY, sSelectedChannel, sSongX) == CDT_LABEL);
 }
 
 void tracker_songMoveRight() {
   do {
     sSongX++;
-    if (sSongX == sChip->getNumSongDataColumns(sSelectedChannel)) {
+    if (sSongX == sChip->getNumSongDataColumns(sChipContext, sSelectedChannel)) {
       sSongX = 0;
       sSelectedChannel++;
-      if (sSelectedChannel == sChip->getNumChannels()) {
+      if (sSelectedChannel == sChip->getNumChannels(sChipContext)) {
         sSelectedChannel = 0;
       }
-      sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+      sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
     }
-  } while (sChip->getSongDataType(sSongY, sSelectedChannel, sSongX) == CDT_LABEL);
+  } while (sChip->getSongDataType(sChipContext, sSongY, sSelectedChannel, sSongX) == CDT_LABEL);
 }
 
 void tracker_songMoveDown() {
   sSongY++;
-  if (sSongY == sChip->getNumSongRows()) {
+  if (sSongY == sChip->getNumSongRows(sChipContext)) {
     sSongY = 0;
   }
 }
@@ -1524,45 +1595,47 @@ void tracker_patternMoveLeft() {
   do {
     if (sPatternX == 0) {
       if (sSelectedChannel == 0) {
-        sSelectedChannel = sChip->getNumChannels() - 1;
+        sSelectedChannel = sChip->getNumChannels(sChipContext) - 1;
       } else {
         sSelectedChannel--;
       }
-      sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
-      sPatternX = sChip->getNumPatternDataColumns(sSelectedChannel, sSelectedPattern, sPatternY) - 1;
+      sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
+      sPatternX = sChip->getNumPatternDataColumns(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY) - 1;
     } else {
       sPatternX--;
     }
-  } while (sChip->getPatternDataType(sSelectedChannel, sSelectedPattern, sPatternY, sPatternX) == CDT_LABEL);
+  } while (sChip->getPatternDataType(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY,
+                                     sPatternX) == CDT_LABEL);
 }
 
 void tracker_patternMoveRight() {
   do {
     sPatternX++;
-    if (sPatternX == sChip->getNumPatternDataColumns(sSelectedChannel, sSelectedPattern, sPatternY)) {
+    if (sPatternX == sChip->getNumPatternDataColumns(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY)) {
       sPatternX = 0;
       sSelectedChannel++;
-      if (sSelectedChannel == sChip->getNumChannels()) {
+      if (sSelectedChannel == sChip->getNumChannels(sChipContext)) {
         sSelectedChannel = 0;
       }
-      sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+      sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
     }
-  } while (sChip->getPatternDataType(sSelectedChannel, sSelectedPattern, sPatternY, sPatternX) == CDT_LABEL);
+  } while (sChip->getPatternDataType(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY,
+                                     sPatternX) == CDT_LABEL);
 }
 
 void tracker_instrumentMoveLeft() {
   do {
     if (sInstrumentX == 0) {
       if (sInstrumentParam == 0) {
-        sInstrumentParam = sChip->getNumInstrumentParams(sSelectedInstrument) - 1;
+        sInstrumentParam = sChip->getNumInstrumentParams(sChipContext, sSelectedInstrument) - 1;
       } else {
         sInstrumentParam--;
       }
-      sInstrumentX = sChip->getNumInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY) - 1;
+      sInstrumentX = sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY) - 1;
     } else {
       sInstrumentX--;
     }
-  } while (sChip->getInstrumentDataType(sSelectedInstrument,
+  } while (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument,
                                         sInstrumentParam,
                                         sInstrumentY,
                                         sInstrumentX) == CDT_LABEL);
@@ -1571,21 +1644,22 @@ void tracker_instrumentMoveLeft() {
 void tracker_instrumentMoveRight() {
   do {
     sInstrumentX++;
-    if (sInstrumentX == sChip->getNumInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY)) {
+    if (sInstrumentX == sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam,
+                                                    sInstrumentY)) {
       sInstrumentX = 0;
       sInstrumentParam++;
-      if (sInstrumentParam == sChip->getNumInstrumentParams(sSelectedInstrument)) {
+      if (sInstrumentParam == sChip->getNumInstrumentParams(sChipContext, sSelectedInstrument)) {
         sInstrumentParam = 0;
       }
     }
-  } while (sChip->getInstrumentDataType(sSelectedInstrument, sInstrumentParam, sInstrumentY,
+  } while (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY,
                                         sInstrumentX) == CDT_LABEL);
 }
 
 void tracker_instrumentMoveUp() {
-  int c = sChip->getInstrumentLen(sSelectedInstrument);
+  int c = sChip->getInstrumentLen(sChipContext, sSelectedInstrument);
   sInstrumentY = (sInstrumentY + c - 1) % c;
-  int numDataColumns = sChip->getNumInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY);
+  int numDataColumns = sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY);
   if (sInstrumentX >= numDataColumns) {
     sInstrumentX = numDataColumns - 1;
   }
@@ -1609,9 +1683,11 @@ bool tracker_asciiKey(int _key) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getSongDataType(sSongY, sSelectedChannel, sSongX) == CDT_ASCII) {
-        sChip->setSongData(sSongY, sSelectedChannel, sSongX, _key);
-        sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+      if (sChip->getSongDataType(sChipContext, sSongY, sSelectedChannel, sSongX) == CDT_ASCII) {
+        lockEngine();
+        sChip->setSongData(sChipContext, sSongY, sSelectedChannel, sSongX, _key);
+        unlockEngine();
+        sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
         tracker_songMoveRight();
         return true;
       }
@@ -1620,13 +1696,16 @@ bool tracker_asciiKey(int _key) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getPatternDataType(sSelectedChannel, sSelectedPattern, sPatternY, sPatternX) == CDT_ASCII) {
-        sChip->setPatternData(sSelectedChannel, sSelectedPattern, sPatternY, sPatternX, sSelectedInstrument,
-                              _key);
+      if (sChip->getPatternDataType(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY,
+                                    sPatternX) == CDT_ASCII) {
+        lockEngine();
+        sChip->setPatternData(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY, sPatternX,
+                              sSelectedInstrument, _key);
+        unlockEngine();
 
         // tracker_patternMoveRight();
         sPatternY++;
-        if (sPatternY == sChip->getPatternLen(sSelectedPattern)) {
+        if (sPatternY == sChip->getPatternLen(sChipContext, sSelectedPattern)) {
           sPatternY = 0;
         }
         return true;
@@ -1636,15 +1715,18 @@ bool tracker_asciiKey(int _key) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getInstrumentDataType(sSelectedInstrument,
+      if (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument,
                                        sInstrumentParam,
                                        sInstrumentY,
                                        sInstrumentX) == CDT_ASCII) {
-        if (sChip->setInstrumentData(sSelectedInstrument,
-                                     sInstrumentParam,
-                                     sInstrumentY,
-                                     sInstrumentX,
-                                     _key)) {
+        lockEngine();
+        bool changed = sChip->setInstrumentData(sChipContext, sSelectedInstrument,
+                                                sInstrumentParam,
+                                                sInstrumentY,
+                                                sInstrumentX,
+                                                _key);
+        unlockEngine();
+        if (changed) {
           // tracker_instrumentMoveRight();
           return true;
         }
@@ -1667,7 +1749,7 @@ bool tracker_pianoKey(int _key, bool _isRepeat, bool _isDown) {
     note = sOctave * 12 + _key - 1;
   }
   if (!_isRepeat) {
-    sChip->plonk(note, sSelectedChannel, sSelectedInstrument, _isDown);
+    con_error(cmdqueue_plonk(&sCommands, note, sSelectedChannel, sSelectedInstrument, _isDown));
     sPlonkNote = note;
     if (!_isDown) {
       return true;
@@ -1678,9 +1760,11 @@ bool tracker_pianoKey(int _key, bool _isRepeat, bool _isDown) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getSongDataType(sSongY, sSelectedChannel, sSongX) == CDT_NOTE) {
-        sChip->setSongData(sSongY, sSelectedChannel, sSongX, note);
-        sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+      if (sChip->getSongDataType(sChipContext, sSongY, sSelectedChannel, sSongX) == CDT_NOTE) {
+        lockEngine();
+        sChip->setSongData(sChipContext, sSongY, sSelectedChannel, sSongX, note);
+        unlockEngine();
+        sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
         return true;
       }
       break;
@@ -1688,11 +1772,14 @@ bool tracker_pianoKey(int _key, bool _isRepeat, bool _isDown) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getPatternDataType(sSelectedChannel, sSelectedPattern, sPatternY, sPatternX) == CDT_NOTE) {
-        sChip->setPatternData(sSelectedChannel, sSelectedPattern, sPatternY, sPatternX, sSelectedInstrument,
-                              note);
+      if (sChip->getPatternDataType(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY,
+                                    sPatternX) == CDT_NOTE) {
+        lockEngine();
+        sChip->setPatternData(sChipContext, sSelectedChannel, sSelectedPattern, sPatternY, sPatternX,
+                              sSelectedInstrument, note);
+        unlockEngine();
         sPatternY++;
-        if (sPatternY == sChip->getPatternLen(sSelectedPattern)) {
+        if (sPatternY == sChip->getPatternLen(sChipContext, sSelectedPattern)) {
           sPatternY = 0;
         }
         return true;
@@ -1702,11 +1789,13 @@ bool tracker_pianoKey(int _key, bool _isRepeat, bool _isDown) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getInstrumentDataType(sSelectedInstrument,
+      if (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument,
                                        sInstrumentParam,
                                        sInstrumentY,
                                        sInstrumentX) == CDT_NOTE) {
-        sChip->setInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY, sInstrumentX, note);
+        lockEngine();
+        sChip->setInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY, sInstrumentX, note);
+        unlockEngine();
 
         // tracker_instrumentMoveRight();
         return true;
@@ -1723,9 +1812,11 @@ bool tracker_hexKey(int _hex) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getSongDataType(sSongY, sSelectedChannel, sSongX) == CDT_HEX) {
-        sChip->setSongData(sSongY, sSelectedChannel, sSongX, _hex);
-        sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+      if (sChip->getSongDataType(sChipContext, sSongY, sSelectedChannel, sSongX) == CDT_HEX) {
+        lockEngine();
+        sChip->setSongData(sChipContext, sSongY, sSelectedChannel, sSongX, _hex);
+        unlockEngine();
+        sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
         // TODO: Make this an option
         // tracker_songMoveRight();
         tracker_songMoveDown();
@@ -1736,20 +1827,22 @@ bool tracker_hexKey(int _hex) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getPatternDataType(sSelectedChannel,
+      if (sChip->getPatternDataType(sChipContext, sSelectedChannel,
                                     sSelectedPattern,
                                     sPatternY,
                                     sPatternX) == CDT_HEX) {
-        sChip->setPatternData(sSelectedChannel,
+        lockEngine();
+        sChip->setPatternData(sChipContext, sSelectedChannel,
                               sSelectedPattern,
                               sPatternY,
                               sPatternX,
                               sSelectedInstrument,
                               _hex);
+        unlockEngine();
 
         // tracker_patternMoveRight();
         sPatternY++;
-        if (sPatternY == sChip->getPatternLen(sSelectedPattern)) {
+        if (sPatternY == sChip->getPatternLen(sChipContext, sSelectedPattern)) {
           sPatternY = 0;
         }
         return true;
@@ -1759,15 +1852,17 @@ bool tracker_hexKey(int _hex) {
       if (!sbEditing) {
         return false;
       }
-      if (sChip->getInstrumentDataType(sSelectedInstrument,
+      if (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument,
                                        sInstrumentParam,
                                        sInstrumentY,
                                        sInstrumentX) == CDT_HEX) {
-        sChip->setInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY, sInstrumentX, _hex);
-        if ((sInstrumentX < sChip->getNumInstrumentData(sSelectedInstrument,
+        lockEngine();
+        sChip->setInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY, sInstrumentX, _hex);
+        unlockEngine();
+        if ((sInstrumentX < sChip->getNumInstrumentData(sChipContext, sSelectedInstrument,
                                                         sInstrumentParam,
                                                         sInstrumentY) - 1) &&
-            (sChip->getInstrumentDataType(sSelectedInstrument,
+            (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument,
                                           sInstrumentParam,
                                           sInstrumentY,
                                           sInstrumentX + 1) == CDT_HEX)) {
@@ -1781,11 +1876,13 @@ bool tracker_hexKey(int _hex) {
       if (!sbEditing) {
         return false;
       }
-      sChip->setTableData(sSelectedTableKind,
+      lockEngine();
+      sChip->setTableData(sChipContext, sSelectedTableKind,
                           sSelectedTable[sSelectedTableKind],
                           sTableX,
                           _hex);
-      if (sTableX < sChip->getTableDataLen(sSelectedTableKind, sSelectedTable[sSelectedTableKind]) - 1) {
+      unlockEngine();
+      if (sTableX < sChip->getTableDataLen(sChipContext, sSelectedTableKind, sSelectedTable[sSelectedTableKind]) - 1) {
         sTableX++;
       } else {
         sTableX = 0;
@@ -1802,12 +1899,14 @@ void tracker_mouseDownAt(int _x, int _y) {
     int y = sTableRect.y2 - _y;
     if (sbEditing) {
       sTrackerState = TRACKER_EDIT_TABLE;
-      if (x < sChip->getTableDataLen(sSelectedTableKind, sSelectedTable[sSelectedTableKind])) {
+      if (x < sChip->getTableDataLen(sChipContext, sSelectedTableKind, sSelectedTable[sSelectedTableKind])) {
         sTableX = x;
-        sChip->setTableData(sSelectedTableKind,
+        lockEngine();
+        sChip->setTableData(sChipContext, sSelectedTableKind,
                             sSelectedTable[sSelectedTableKind],
                             x,
                             y);
+        unlockEngine();
       }
     }
     return;
@@ -1893,31 +1992,31 @@ ACTION(ACTION_MOVE_LEFT, TRACKER_EDIT_SONG) {
 }
 
 ACTION(ACTION_MOVE_DOWN, TRACKER_EDIT_SONG) {
-  sSongY = (sSongY + 1) % sChip->getNumSongRows();
-  sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+  sSongY = (sSongY + 1) % sChip->getNumSongRows(sChipContext);
+  sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
 }
 
 ACTION(ACTION_MOVE_UP, TRACKER_EDIT_SONG) {
-  int c = sChip->getNumSongRows();
+  int c = sChip->getNumSongRows(sChipContext);
   sSongY = (sSongY + c - 1) % c;
-  sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+  sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
 }
 
 ACTION(ACTION_NEXT_CHANNEL, TRACKER_EDIT_SONG) {
   sSelectedChannel++;
-  if (sSelectedChannel == sChip->getNumChannels()) {
+  if (sSelectedChannel == sChip->getNumChannels(sChipContext)) {
     sSelectedChannel = 0;
   }
-  sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+  sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
 }
 
 ACTION(ACTION_PREV_CHANNEL, TRACKER_EDIT_SONG) {
   if (sSelectedChannel == 0) {
-    sSelectedChannel = sChip->getNumChannels() - 1;
+    sSelectedChannel = sChip->getNumChannels(sChipContext) - 1;
   } else {
     sSelectedChannel--;
   }
-  sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+  sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
 }
 
 ACTION(ACTION_MOVE_RIGHT, TRACKER_EDIT_PATTERN) {
@@ -1929,11 +2028,11 @@ ACTION(ACTION_MOVE_LEFT, TRACKER_EDIT_PATTERN) {
 }
 
 ACTION(ACTION_MOVE_DOWN, TRACKER_EDIT_PATTERN) {
-  sPatternY = (sPatternY + 1) % sChip->getPatternLen(sSelectedPattern);
+  sPatternY = (sPatternY + 1) % sChip->getPatternLen(sChipContext, sSelectedPattern);
 }
 
 ACTION(ACTION_MOVE_UP, TRACKER_EDIT_PATTERN) {
-  int c = sChip->getPatternLen(sSelectedPattern);
+  int c = sChip->getPatternLen(sChipContext, sSelectedPattern);
   sPatternY = (sPatternY + c - 1) % c;
 }
 
@@ -1948,7 +2047,7 @@ ACTION(ACTION_NEXT_SECTION, TRACKER_EDIT_ANY) {
       break;
     }
     case TRACKER_EDIT_INSTRUMENT: {
-      if (sChip->useTables()) {
+      if (sChip->useTables(sChipContext)) {
         sTrackerState = TRACKER_EDIT_TABLE;
       } else {
         sTrackerState = TRACKER_EDIT_META_DATA;
@@ -1972,7 +2071,7 @@ ACTION(ACTION_PREV_SECTION, TRACKER_EDIT_ANY) {
     case TRACKER_EDIT_SONG:sTrackerState = TRACKER_EDIT_META_DATA;
       break;
     case TRACKER_EDIT_META_DATA:
-      if (sChip->useTables()) {
+      if (sChip->useTables(sChipContext)) {
         sTrackerState = TRACKER_EDIT_TABLE;
       } else {
         sTrackerState = TRACKER_EDIT_INSTRUMENT;
@@ -1990,36 +2089,36 @@ ACTION(ACTION_PREV_SECTION, TRACKER_EDIT_ANY) {
 
 ACTION(ACTION_NEXT_CHANNEL, TRACKER_EDIT_PATTERN) {
   sSelectedChannel++;
-  if (sSelectedChannel == sChip->getNumChannels()) {
+  if (sSelectedChannel == sChip->getNumChannels(sChipContext)) {
     sSelectedChannel = 0;
   }
-  sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+  sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
 }
 
 ACTION(ACTION_PREV_CHANNEL, TRACKER_EDIT_PATTERN) {
   if (sSelectedChannel == 0) {
-    sSelectedChannel = sChip->getNumChannels() - 1;
+    sSelectedChannel = sChip->getNumChannels(sChipContext) - 1;
   } else {
     sSelectedChannel--;
   }
-  sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+  sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
 }
 
 ACTION(ACTION_PLAY_STOP_SONG, TRACKER_EDIT_ANY) {
-  if (sChip->isPlaying()) {
-    sChip->stop();
+  if (sChip->isPlaying(sChipContext)) {
+    con_error(cmdqueue_stop(&sCommands));
   } else {
-    sChip->stop();
-    sChip->playSongFrom(sSongY, sSongX, sPatternY, sPatternX);
+    con_error(cmdqueue_stop(&sCommands));
+    con_error(cmdqueue_playSongFrom(&sCommands, sSongY, sSongX, sPatternY, sPatternX));
   }
 }
 
 ACTION(ACTION_PLAY_STOP_PATTERN, TRACKER_EDIT_ANY) {
-  if (sChip->isPlaying()) {
-    sChip->stop();
+  if (sChip->isPlaying(sChipContext)) {
+    con_error(cmdqueue_stop(&sCommands));
   } else {
-    sChip->stop();
-    sChip->playPatternFrom(sSongY, sSongX, sPatternY, sPatternX);
+    con_error(cmdqueue_stop(&sCommands));
+    con_error(cmdqueue_playPatternFrom(&sCommands, sSongY, sSongX, sPatternY, sPatternX));
   }
 }
 
@@ -2040,8 +2139,8 @@ ACTION(ACTION_MOVE_UP, TRACKER_EDIT_INSTRUMENT) {
 }
 
 ACTION(ACTION_MOVE_DOWN, TRACKER_EDIT_INSTRUMENT) {
-  sInstrumentY = (sInstrumentY + 1) % sChip->getInstrumentLen(sSelectedInstrument);
-  int numDataColumns = sChip->getNumInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY);
+  sInstrumentY = (sInstrumentY + 1) % sChip->getInstrumentLen(sChipContext, sSelectedInstrument);
+  int numDataColumns = sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY);
   if (sInstrumentX >= numDataColumns) {
     sInstrumentX = numDataColumns - 1;
   }
@@ -2051,15 +2150,16 @@ ACTION(ACTION_NEXT_INSTRUMENT_PARAM, TRACKER_EDIT_INSTRUMENT) {
   bool isLabel = true;
   do {
     sInstrumentParam++;
-    if (sInstrumentParam == sChip->getNumInstrumentParams(sSelectedInstrument)) {
+    if (sInstrumentParam == sChip->getNumInstrumentParams(sChipContext, sSelectedInstrument)) {
       sInstrumentParam = 0;
     }
-    int numDataColumns = sChip->getNumInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY);
+    int numDataColumns = sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY);
     if (sInstrumentX >= numDataColumns) {
       sInstrumentX = numDataColumns - 1;
     }
     for (int i = 0; i < numDataColumns; i++) {
-      if (sChip->getInstrumentDataType(sSelectedInstrument, sInstrumentParam, sInstrumentY, i) != CDT_LABEL) {
+      if (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY,
+                                       i) != CDT_LABEL) {
         isLabel = false;
         break;
       }
@@ -2071,16 +2171,17 @@ ACTION(ACTION_PREV_INSTRUMENT_PARAM, TRACKER_EDIT_INSTRUMENT) {
   bool isLabel = true;
   do {
     if (sInstrumentParam == 0) {
-      sInstrumentParam = sChip->getNumInstrumentParams(sSelectedInstrument) - 1;
+      sInstrumentParam = sChip->getNumInstrumentParams(sChipContext, sSelectedInstrument) - 1;
     } else {
       sInstrumentParam--;
     }
-    int numDataColumns = sChip->getNumInstrumentData(sSelectedInstrument, sInstrumentParam, sInstrumentY);
+    int numDataColumns = sChip->getNumInstrumentData(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY);
     if (sInstrumentX >= numDataColumns) {
       sInstrumentX = numDataColumns - 1;
     }
     for (int i = 0; i < numDataColumns; i++) {
-      if (sChip->getInstrumentDataType(sSelectedInstrument, sInstrumentParam, sInstrumentY, i) != CDT_LABEL) {
+      if (sChip->getInstrumentDataType(sChipContext, sSelectedInstrument, sInstrumentParam, sInstrumentY,
+                                       i) != CDT_LABEL) {
         isLabel = false;
         break;
       }
@@ -2088,105 +2189,107 @@ ACTION(ACTION_PREV_INSTRUMENT_PARAM, TRACKER_EDIT_INSTRUMENT) {
   } while (isLabel);
 }
 
-void writeLEu32(FILE *f, u32 val) {
-  fputc(GETBYTE(val, 0), f);
-  fputc(GETBYTE(val, 1), f);
-  fputc(GETBYTE(val, 2), f);
-  fputc(GETBYTE(val, 3), f);
-}
-
-void writeLEu16(FILE *f, u32 val) {
-  fputc(GETBYTE(val, 0), f);
-  fputc(GETBYTE(val, 1), f);
+static void flushAudio(ChipSample *_buf) {
+  for (size_t i = 0; i < (2 * sSampleRate); i += EXPORT_BLOCK) {
+    sChip->getSamples(sChipContext, _buf, EXPORT_BLOCK);
+  }
 }
 
 ACTION(ACTION_WAV_EXPORT, TRACKER_EDIT_ANY) {
-  // .wav export
-  // TODO: This currently does not handle endless songs!!
+  // .wav export; endless songs stop after EXPORT_LOOPS loops
+  static ChipSample buf[EXPORT_BLOCK];
   char filename[1024];
   snprintf(filename, sizeof(filename), "%s.wav", sFilename);
-  con_msgf("EXPORTING .WAV TO: %s...\n", filename);
   con_pauseAudio();
+  // With the producer stopped this thread can apply commands still waiting in the queue
+  cmdqueue_drain(&sCommands, sChip, sChipContext);
+  // Exports always use the accurate model
+  if (sFastPreview) {
+    sChip->setFastPreview(sChipContext, false);
+  }
+  // Only the sequencer runs here, so knowing the length up front costs a small part of the render
+  const uint64_t maxSamples = (uint64_t) EXPORT_MAX_SECONDS * sSampleRate;
+  const u32 fadeLength = EXPORT_FADE_SECONDS * sSampleRate;
+  uint64_t length = chip_measureSong(sChip, sChipContext, EXPORT_LOOPS, maxSamples);
+  const bool truncated = sChip->isPlaying(sChipContext) && sChip->getLoopCount(sChipContext) < EXPORT_LOOPS;
+  uint64_t fadeStart = length;
+  if (truncated) {
+    fadeStart = length > fadeLength ? length - fadeLength : 0;
+  } else if (sChip->isPlaying(sChipContext)) {
+    length += fadeLength;
+  }
+  sChip->silence(sChipContext);
+  u32 centiseconds = (u32) (length * 100 / sSampleRate);
+  con_msgf("EXPORTING %u.%02uS .WAV TO: %s...\n", centiseconds / 100, centiseconds % 100, filename);
   // Flush the audio channel
-  for (size_t i = 0; i < (2 * 44100); i++) {
-    ChipSample samp;
-    sChip->getSamples(&samp, 1);
-  }
-  // Measure song length;
-  u32 length = 0;
-  sChip->playSongFrom(0, 0, 0, 0);
-  while (sChip->isPlaying()) {
-    ChipSample samp;
-    sChip->getSamples(&samp, 1);
-    length += sizeof(ChipSample);
-  }
-/*
-  // 2 Second "silence" after song finishes
-  for(size_t i = 0; i < (2 * 44100); i++) {
-    ChipSample samp;
-    sChip->getSamples(&samp, 1);
-    length += sizeof(ChipSample);
-  }
-*/
-
-  // Write wave header
-  FILE *f;
-  f = fopen(filename, "w");
-  if (!f) {
+  flushAudio(buf);
+
+  // Render the song once, a block at a time; the header sizes are patched on close
+  WavWriter wav;
+  ChipError error = wav_open(&wav, filename, sSampleRate);
+  if (error != NO_ERR) {
     con_error("EXPORT ERROR!\n");
+    if (sFastPreview) {
+      sChip->setFastPreview(sChipContext, true);
+    }
+    con_resumeAudio();
     return;
   }
-  fprintf(f, "RIFF");
-  writeLEu32(f, 36 + length);
-  fprintf(f, "WAVE");
-  fprintf(f, "fmt ");
-  writeLEu32(f, 16);
-  writeLEu16(f, 1);             // PCM
-  writeLEu16(f, 2);             // Stereo
-  writeLEu32(f, 44100);         // Sample Rate
-  writeLEu32(f, 44100 * 2 * 2); // Byte rate
-  writeLEu16(f, 2 * 2);         // Block Align
-  writeLEu16(f, 16);            // Bits per sample
-  fprintf(f, "data");
-  writeLEu32(f, length);
-
-  // Write wav data
-  sChip->playSongFrom(0, 0, 0, 0);
-  for (size_t i = 0; i < length / 4; i++) {
-    ChipSample s;
-    sChip->getSamples(&s, 1);
-    writeLEu16(f, s.left);
-    writeLEu16(f, s.right);
+  uint64_t written = 0;
+  sChip->playSongFrom(sChipContext, 0, 0, 0, 0);
+  while (error == NO_ERR && written < length) {
+    int len = (int) MIN(EXPORT_BLOCK, length - written);
+    if (written < fadeStart && written + len > fadeStart) {
+      // Split the block where the fade starts
+      len = (int) (fadeStart - written);
+    }
+    sChip->getSamples(sChipContext, buf, len);
+    if (written >= fadeStart) {
+      chip_fadeOut(buf, len, (u32) (written - fadeStart), fadeLength);
+    }
+    error = wav_write(&wav, buf, len);
+    written += len;
+  }
+  ChipError closeError = wav_close(&wav);
+  if (error == NO_ERR) {
+    error = closeError;
   }
   // Finished
-  fclose(f);
-  sChip->silence();
-  // Flush the audio channel
-  for (size_t i = 0; i < (2 * 44100); i++) {
-    ChipSample samp;
-    sChip->getSamples(&samp, 1);
+  sChip->silence(sChipContext);
+  if (sFastPreview) {
+    sChip->setFastPreview(sChipContext, true);
   }
+  // Flush the audio channel
+  flushAudio(buf);
   con_resumeAudio();
+  if (error != NO_ERR) {
+    con_error(error);
+    return;
+  }
+  if (truncated) {
+    con_errorf("NO LOOP FOUND, EXPORT CUT AT %d SECONDS.\n", EXPORT_MAX_SECONDS);
+    return;
+  }
   con_msg("DONE.");
 }
 
 ACTION(ACTION_SAVE, TRACKER_EDIT_ANY) {
   con_msgf("SAVING TO %s...\n", sFilename);
-  sChip->saveSong(sFilename);
+  sChip->saveSong(sChipContext, sFilename);
   con_msg("DONE.");
 }
 
 ACTION(ACTION_PREV_INSTRUMENT, TRACKER_EDIT_ANY) {
   sSelectedInstrument--;
   if (sSelectedInstrument < 0) {
-    sSelectedInstrument = sChip->getNumInstruments() - 1;
+    sSelectedInstrument = sChip->getNumInstruments(sChipContext) - 1;
   }
   sInstrumentY = 0;
 }
 
 ACTION(ACTION_NEXT_INSTRUMENT, TRACKER_EDIT_ANY) {
   sSelectedInstrument++;
-  if (sSelectedInstrument == sChip->getNumInstruments()) {
+  if (sSelectedInstrument == sChip->getNumInstruments(sChipContext)) {
     sSelectedInstrument = 0;
   }
   sInstrumentY = 0;
@@ -2196,63 +2299,72 @@ ACTION(ACTION_INSERT, TRACKER_EDIT_ANY) {
   if (!sbEditing) {
     return;
   }
+  lockEngine();
   switch (sTrackerState) {
-    case TRACKER_EDIT_SONG: con_error(sChip->insertSongRow(sSelectedChannel, sSongY));
+    case TRACKER_EDIT_SONG: con_error(sChip->insertSongRow(sChipContext, sSelectedChannel, sSongY));
       break;
-    case TRACKER_EDIT_PATTERN: con_error(sChip->insertPatternRow(sSelectedChannel, sSelectedPattern, sPatternY));
+    case TRACKER_EDIT_PATTERN: con_error(sChip->insertPatternRow(sChipContext, sSelectedChannel, sSelectedPattern,
+                                                                 sPatternY));
       break;
-    case TRACKER_EDIT_INSTRUMENT: con_error(sChip->insertInstrumentRow(sSelectedInstrument, sInstrumentY));
+    case TRACKER_EDIT_INSTRUMENT: con_error(sChip->insertInstrumentRow(sChipContext, sSelectedInstrument,
+                                                                       sInstrumentY));
       break;
     case TRACKER_EDIT_TABLE:
-      con_error(sChip->insertTableColumn(sSelectedTableKind,
+      con_error(sChip->insertTableColumn(sChipContext, sSelectedTableKind,
                                          sSelectedTable[sSelectedTableKind],
                                          sTableX));
       break;
     default: break;
   }
+  unlockEngine();
 }
 
 ACTION(ACTION_ADD, TRACKER_EDIT_ANY) {
   if (!sbEditing) {
     return;
   }
+  lockEngine();
   switch (sTrackerState) {
-    case TRACKER_EDIT_SONG: con_error(sChip->addSongRow());
+    case TRACKER_EDIT_SONG: con_error(sChip->addSongRow(sChipContext));
       break;
-    case TRACKER_EDIT_PATTERN: con_error(sChip->addPatternRow(sSelectedChannel, sSelectedPattern));
+    case TRACKER_EDIT_PATTERN: con_error(sChip->addPatternRow(sChipContext, sSelectedChannel, sSelectedPattern));
       break;
-    case TRACKER_EDIT_INSTRUMENT: con_error(sChip->addInstrumentRow(sSelectedInstrument));
+    case TRACKER_EDIT_INSTRUMENT: con_error(sChip->addInstrumentRow(sChipContext, sSelectedInstrument));
       break;
     case TRACKER_EDIT_TABLE:
-      con_error(sChip->addTableColumn(sSelectedTableKind,
+      con_error(sChip->addTableColumn(sChipContext, sSelectedTableKind,
                                       sSelectedTable[sSelectedTableKind]));
       break;
     default: break;
   }
+  unlockEngine();
 }
 
 ACTION(ACTION_DELETE, TRACKER_EDIT_ANY) {
   if (!sbEditing) {
     return;
   }
+  lockEngine();
   switch (sTrackerState) {
-    case TRACKER_EDIT_SONG: con_error(sChip->deleteSongRow(sSelectedChannel, sSongY));
-      if (sSongY >= sChip->getNumSongRows()) {
-        sSongY = sChip->getNumSongRows() - 1;
+    case TRACKER_EDIT_SONG: con_error(sChip->deleteSongRow(sChipContext, sSelectedChannel, sSongY));
+      if (sSongY >= sChip->getNumSongRows(sChipContext)) {
+        sSongY = sChip->getNumSongRows(sChipContext) - 1;
       }
       break;
-    case TRACKER_EDIT_PATTERN: con_error(sChip->deletePatternRow(sSelectedChannel, sSelectedPattern, sPatternY));
+    case TRACKER_EDIT_PATTERN: con_error(sChip->deletePatternRow(sChipContext, sSelectedChannel, sSelectedPattern,
+                                                                 sPatternY));
       break;
-    case TRACKER_EDIT_INSTRUMENT: con_error(sChip->deleteInstrumentRow(sSelectedInstrument, sInstrumentY));
-      if (sInstrumentY >= sChip->getInstrumentLen(sSelectedInstrument)) {
-        sInstrumentY = sChip->getInstrumentLen(sSelectedInstrument) - 1;
+    case TRACKER_EDIT_INSTRUMENT: con_error(sChip->deleteInstrumentRow(sChipContext, sSelectedInstrument,
+                                                                       sInstrumentY));
+      if (sInstrumentY >= sChip->getInstrumentLen(sChipContext, sSelectedInstrument)) {
+        sInstrumentY = sChip->getInstrumentLen(sChipContext, sSelectedInstrument) - 1;
       }
       break;
     case TRACKER_EDIT_TABLE: {
-      con_error(sChip->deleteTableColumn(sSelectedTableKind,
+      con_error(sChip->deleteTableColumn(sChipContext, sSelectedTableKind,
                                          sSelectedTable[sSelectedTableKind],
                                          sTableX));
-      int len = sChip->getTableDataLen(sSelectedTableKind,
+      int len = sChip->getTableDataLen(sChipContext, sSelectedTableKind,
                                        sSelectedTable[sSelectedTableKind]);
       if (sTableX >= len) {
         sTableX = len - 1;
@@ -2264,55 +2376,62 @@ ACTION(ACTION_DELETE, TRACKER_EDIT_ANY) {
     }
     default: break;
   }
+  unlockEngine();
 }
 
 ACTION(ACTION_CLEAR, TRACKER_EDIT_ANY) {
   if (!sbEditing) {
     return;
   }
+  lockEngine();
   switch (sTrackerState) {
     case TRACKER_EDIT_SONG:
-      sChip->clearSongData(sSongY,
+      sChip->clearSongData(sChipContext, sSongY,
                            sSelectedChannel,
                            sSongX);
-      sSelectedPattern = sChip->getPatternNum(sSongY, sSelectedChannel);
+      sSelectedPattern = sChip->getPatternNum(sChipContext, sSongY, sSelectedChannel);
       break;
     case TRACKER_EDIT_PATTERN:
-      sChip->clearPatternData(sSelectedChannel,
+      sChip->clearPatternData(sChipContext, sSelectedChannel,
                               sSelectedPattern,
                               sPatternY,
                               sPatternX);
       sPatternY++;
-      if (sPatternY == sChip->getPatternLen(sSelectedPattern)) {
+      if (sPatternY == sChip->getPatternLen(sChipContext, sSelectedPattern)) {
         sPatternY = 0;
       }
       break;
     case TRACKER_EDIT_INSTRUMENT:
-      sChip->clearInstrumentData(sSelectedInstrument,
+      sChip->clearInstrumentData(sChipContext, sSelectedInstrument,
                                  sInstrumentParam,
                                  sInstrumentY,
                                  sInstrumentX);
       break;
     default: break;
   }
+  unlockEngine();
 }
 
 ACTION(ACTION_PREV_OCTAVE, TRACKER_EDIT_ANY) {
-  u8 min = sChip->getMinOctave();
+  u8 min = sChip->getMinOctave(sChipContext);
   if (sOctave > min) {
     sOctave--;
   }
 }
 
 ACTION(ACTION_NEXT_OCTAVE, TRACKER_EDIT_ANY) {
-  u8 max = sChip->getMaxOctave();
+  u8 max = sChip->getMaxOctave(sChipContext);
   if (sOctave < max) {
     sOctave++;
   }
 }
 
+ACTION(ACTION_SHOW_TIMING, TRACKER_EDIT_ANY) {
+  printTiming(con_msg);
+}
+
 ACTION(ACTION_TOGGLE_EDIT, TRACKER_EDIT_ANY) {
-  sChip->silence();
+  con_error(cmdqueue_silence(&sCommands));
   sPlonkNote = 0;
   sbEditing = !sbEditing;
 }
@@ -2321,10 +2440,12 @@ ACTION(ACTION_NEXT_PATTERN, TRACKER_EDIT_ANY) {
   if (!sbEditing) {
     return;
   }
-  u16 max = sChip->getNumPatterns();
+  u16 max = sChip->getNumPatterns(sChipContext);
   if (sSelectedPattern < max - 1) {
     sSelectedPattern++;
-    sChip->setSongPattern(sSongY, sSelectedChannel, sSelectedPattern);
+    lockEngine();
+    sChip->setSongPattern(sChipContext, sSongY, sSelectedChannel, sSelectedPattern);
+    unlockEngine();
   }
 }
 
@@ -2334,7 +2455,9 @@ ACTION(ACTION_PREV_PATTERN, TRACKER_EDIT_ANY) {
   }
   if (sSelectedPattern > 0) {
     sSelectedPattern--;
-    sChip->setSongPattern(sSongY, sSelectedChannel, sSelectedPattern);
+    lockEngine();
+    sChip->setSongPattern(sChipContext, sSongY, sSelectedChannel, sSelectedPattern);
+    unlockEngine();
   }
 }
 
@@ -2342,20 +2465,24 @@ ACTION(ACTION_SWAP_UP, TRACKER_EDIT_INSTRUMENT) {
   if (!sbEditing || sInstrumentY == 0) {
     return;
   }
-  sChip->swapInstrumentRow(sSelectedInstrument, sInstrumentY, sInstrumentY - 1);
+  lockEngine();
+  sChip->swapInstrumentRow(sChipContext, sSelectedInstrument, sInstrumentY, sInstrumentY - 1);
+  unlockEngine();
   sInstrumentY--;
 }
 
 ACTION(ACTION_SWAP_DOWN, TRACKER_EDIT_INSTRUMENT) {
-  if (!sbEditing || sInstrumentY == (sChip->getInstrumentLen(sSelectedInstrument) - 1)) {
+  if (!sbEditing || sInstrumentY == (sChip->getInstrumentLen(sChipContext, sSelectedInstrument) - 1)) {
     return;
   }
-  sChip->swapInstrumentRow(sSelectedInstrument, sInstrumentY, sInstrumentY + 1);
+  lockEngine();
+  sChip->swapInstrumentRow(sChipContext, sSelectedInstrument, sInstrumentY, sInstrumentY + 1);
+  unlockEngine();
   sInstrumentY++;
 }
 
 ACTION(ACTION_NEXT_TABLE_KIND, TRACKER_EDIT_TABLE) {
-  if (sSelectedTableKind < sChip->getNumTableKinds() - 1) {
+  if (sSelectedTableKind < sChip->getNumTableKinds(sChipContext) - 1) {
     sSelectedTableKind++;
   } else {
     sSelectedTableKind = 0;
@@ -2367,31 +2494,31 @@ ACTION(ACTION_PREV_TABLE_KIND, TRACKER_EDIT_TABLE) {
   if (sSelectedTableKind > 0) {
     sSelectedTableKind--;
   } else {
-    sSelectedTableKind = sChip->getNumTableKinds() - 1;
+    sSelectedTableKind = sChip->getNumTableKinds(sChipContext) - 1;
   }
   sTableX = 0;
 }
 
 ACTION(ACTION_NEXT_TABLE, TRACKER_EDIT_TABLE) {
-  if (sSelectedTable[sSelectedTableKind] > sChip->getMinTable(sSelectedTableKind)) {
+  if (sSelectedTable[sSelectedTableKind] > sChip->getMinTable(sChipContext, sSelectedTableKind)) {
     sSelectedTable[sSelectedTableKind]--;
   } else {
-    sSelectedTable[sSelectedTableKind] = sChip->getNumTables(sSelectedTableKind) - 1;
+    sSelectedTable[sSelectedTableKind] = sChip->getNumTables(sChipContext, sSelectedTableKind) - 1;
   }
   sTableX = 0;
 }
 
 ACTION(ACTION_PREV_TABLE, TRACKER_EDIT_TABLE) {
-  if (sSelectedTable[sSelectedTableKind] < sChip->getNumTables(sSelectedTableKind) - 1) {
+  if (sSelectedTable[sSelectedTableKind] < sChip->getNumTables(sChipContext, sSelectedTableKind) - 1) {
     sSelectedTable[sSelectedTableKind]++;
   } else {
-    sSelectedTable[sSelectedTableKind] = sChip->getMinTable(sSelectedTableKind);
+    sSelectedTable[sSelectedTableKind] = sChip->getMinTable(sChipContext, sSelectedTableKind);
   }
   sTableX = 0;
 }
 
 ACTION(ACTION_NEXT_TABLE_COLUMN, TRACKER_EDIT_TABLE) {
-  if (sTableX < sChip->getTableDataLen(sSelectedTableKind, sSelectedTable[sSelectedTableKind]) - 1) {
+  if (sTableX < sChip->getTableDataLen(sChipContext, sSelectedTableKind, sSelectedTable[sSelectedTableKind]) - 1) {
     sTableX++;
   } else {
     sTableX = 0;
@@ -2402,7 +2529,7 @@ ACTION(ACTION_PREV_TABLE_COLUMN, TRACKER_EDIT_TABLE) {
   if (sTableX > 0) {
     sTableX--;
   } else {
-    sTableX = sChip->getTableDataLen(sSelectedTableKind, sSelectedTable[sSelectedTableKind]) - 1;
+    sTableX = sChip->getTableDataLen(sChipContext, sSelectedTableKind, sSelectedTable[sSelectedTableKind]) - 1;
     if (sTableX < 0) {
       sTableX = 0;
     }
@@ -2414,7 +2541,8 @@ ACTION(ACTION_SHOW_KEYS, TRACKER_EDIT_ANY) {
 }
 
 ACTION(ACTION_MOVE_LEFT, TRACKER_EDIT_META_DATA) {
-  ChipMetaDataEntry *metaData = sChip->getMetaData(sMetaDataY);
+  lockEngine();
+  ChipMetaDataEntry *metaData = sChip->getMetaData(sChipContext, sMetaDataY);
   switch (metaData->type) {
     case CMDT_OPTIONS: {
       if (metaData->value > 0) {
@@ -2422,16 +2550,18 @@ ACTION(ACTION_MOVE_LEFT, TRACKER_EDIT_META_DATA) {
       } else {
         metaData->value = metaData->max;
       }
-      sChip->setMetaData(sMetaDataY, metaData);
+      sChip->setMetaData(sChipContext, sMetaDataY, metaData);
     }
     case CMDT_STRING:break; // TODO: Implement
     case CMDT_HEX:break; // TODO: Implement
     case CMDT_DECIMAL:break; // TODO: Implement
   }
+  unlockEngine();
 }
 
 ACTION(ACTION_MOVE_RIGHT, TRACKER_EDIT_META_DATA) {
-  ChipMetaDataEntry *metaData = sChip->getMetaData(sMetaDataY);
+  lockEngine();
+  ChipMetaDataEntry *metaData = sChip->getMetaData(sChipContext, sMetaDataY);
   switch (metaData->type) {
     case CMDT_OPTIONS: {
       if (metaData->value < metaData->max) {
@@ -2439,24 +2569,25 @@ ACTION(ACTION_MOVE_RIGHT, TRACKER_EDIT_META_DATA) {
       } else {
         metaData->value = 0;
       }
-      sChip->setMetaData(sMetaDataY, metaData);
+      sChip->setMetaData(sChipContext, sMetaDataY, metaData);
     }
     case CMDT_STRING:break; // TODO: Implement
     case CMDT_HEX:break; // TODO: Implement
     case CMDT_DECIMAL:break; // TODO: Implement
   }
+  unlockEngine();
 }
 
 ACTION(ACTION_MOVE_UP, TRACKER_EDIT_META_DATA) {
   if (sMetaDataY > 0) {
     sMetaDataY--;
   } else {
-    sMetaDataY = sChip->getNumMetaData() - 1;
+    sMetaDataY = sChip->getNumMetaData(sChipContext) - 1;
   }
 }
 
 ACTION(ACTION_MOVE_DOWN, TRACKER_EDIT_META_DATA) {
-  if (sMetaDataY < sChip->getNumMetaData() - 1) {
+  if (sMetaDataY < sChip->getNumMetaData(sChipContext) - 1) {
     sMetaDataY++;
   } else {
     sMetaDataY = 0;
@@ -2508,6 +2639,7 @@ void tracker_action(Action _action, TrackerState _state) {
   HANDLE_ACTION(ACTION_NEXT_TABLE_COLUMN, TRACKER_EDIT_TABLE);
   HANDLE_ACTION(ACTION_PREV_TABLE_COLUMN, TRACKER_EDIT_TABLE);
   HANDLE_ACTION(ACTION_SHOW_KEYS, TRACKER_EDIT_ANY);
+  HANDLE_ACTION(ACTION_SHOW_TIMING, TRACKER_EDIT_ANY);
   HANDLE_ACTION(ACTION_MOVE_LEFT, TRACKER_EDIT_META_DATA);
   HANDLE_ACTION(ACTION_MOVE_RIGHT, TRACKER_EDIT_META_DATA);
   HANDLE_ACTION(ACTION_MOVE_UP, TRACKER_EDIT_META_DATA);
@@ -34,12 +34,28 @@ void tracker_destroy();
 
 void tracker_setFilename(char *filename);
 
+/**
+ * Asks the engine for its cheaper preview model during playback; exports still use the accurate one
+ */
+void tracker_setFastPreview(bool _fast);
+
+/**
+ * Output rate the engine is initialized with and exports are written at; call before tracker_init
+ */
+void tracker_setSampleRate(u32 _sampleRate);
+
 void *tracker_setChipName(char *chipName);
 
 void tracker_drawScreen();
 
 void tracker_getSamples(ChipSample *_buf, int _len);
 
+/**
+ * Records how long the producer thread took to render a block
+ * @param _deadline Seconds of audio that were queued ahead of the block; rendering slower than that underruns
+ */
+void tracker_recordRenderTime(double _elapsed, double _deadline);
+
 bool tracker_textEditKey(TrackerTextEditKey _key);
 
 bool tracker_asciiKey(int _key);
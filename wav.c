@@ -0,0 +1,89 @@
+#include "wav.h"
+#include <string.h>
+
+#define WAV_HEADER_SIZE (44)
+#define WAV_SWAP_BLOCK (1024)
+
+static void putLEu32(u8 *_dst, u32 _val) {
+  _dst[0] = GETBYTE(_val, 0);
+  _dst[1] = GETBYTE(_val, 1);
+  _dst[2] = GETBYTE(_val, 2);
+  _dst[3] = GETBYTE(_val, 3);
+}
+
+static void putLEu16(u8 *_dst, u32 _val) {
+  _dst[0] = GETBYTE(_val, 0);
+  _dst[1] = GETBYTE(_val, 1);
+}
+
+static ChipError writeHeader(WavWriter *_wav) {
+  u8 header[WAV_HEADER_SIZE];
+  u32 length = _wav->numSamples * sizeof(ChipSample);
+  memcpy(header, "RIFF", 4);
+  putLEu32(header + 4, 36 + length);
+  memcpy(header + 8, "WAVE", 4);
+  memcpy(header + 12, "fmt ", 4);
+  putLEu32(header + 16, 16);
+  putLEu16(header + 20, 1);                           // PCM
+  putLEu16(header + 22, 2);                           // Stereo
+  putLEu32(header + 24, _wav->sampleRate);            // Sample Rate
+  putLEu32(header + 28, _wav->sampleRate * 2 * 2);    // Byte rate
+  putLEu16(header + 32, 2 * 2);                       // Block Align
+  putLEu16(header + 34, 16);                          // Bits per sample
+  memcpy(header + 36, "data", 4);
+  putLEu32(header + 40, length);
+  if (fseek(_wav->file, 0, SEEK_SET) != 0 || fwrite(header, WAV_HEADER_SIZE, 1, _wav->file) != 1) {
+    return ERR_FILE_WRITE;
+  }
+  return NO_ERR;
+}
+
+ChipError wav_open(WavWriter *_wav, const char *_filename, u32 _sampleRate) {
+  _wav->sampleRate = _sampleRate;
+  _wav->numSamples = 0;
+  _wav->file = fopen(_filename, "wb");
+  if (!_wav->file) {
+    return ERR_FILE_WRITE;
+  }
+  ChipError error = writeHeader(_wav);
+  if (error != NO_ERR) {
+    fclose(_wav->file);
+    _wav->file = NULL;
+  }
+  return error;
+}
+
+ChipError wav_write(WavWriter *_wav, const ChipSample *_buf, int _len) {
+  if (_len > WAV_MAX_SAMPLES - _wav->numSamples) {
+    return ERR_WAV_TOO_LONG;
+  }
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // Samples are stored little endian; swap a chunk at a time on big endian hosts
+  u8 swapped[WAV_SWAP_BLOCK * sizeof(ChipSample)];
+  for (int i = 0; i < _len; i += WAV_SWAP_BLOCK) {
+    int n = _len - i < WAV_SWAP_BLOCK ? _len - i : WAV_SWAP_BLOCK;
+    for (int j = 0; j < n; j++) {
+      putLEu16(swapped + j * 4, (u16) _buf[i + j].left);
+      putLEu16(swapped + j * 4 + 2, (u16) _buf[i + j].right);
+    }
+    if (fwrite(swapped, sizeof(ChipSample), n, _wav->file) != (size_t) n) {
+      return ERR_FILE_WRITE;
+    }
+  }
+#else
+  if (fwrite(_buf, sizeof(ChipSample), _len, _wav->file) != (size_t) _len) {
+    return ERR_FILE_WRITE;
+  }
+#endif
+  _wav->numSamples += _len;
+  return NO_ERR;
+}
+
+ChipError wav_close(WavWriter *_wav) {
+  ChipError error = writeHeader(_wav);
+  if (fclose(_wav->file) != 0 && error == NO_ERR) {
+    error = ERR_FILE_WRITE;
+  }
+  _wav->file = NULL;
+  return error;
+}
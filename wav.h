@@ -0,0 +1,38 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stdio.h>
+#include "types.h"
+#include "chip.h"
+
+// The RIFF and data chunk sizes are 32 bit byte counts, which caps a file at a little over 4 GiB
+#define WAV_MAX_SAMPLES ((0xffffffffu - 36) / sizeof(ChipSample))
+
+#define ERR_WAV_TOO_LONG ("Too long for a .wav file")
+
+typedef struct {
+  FILE *file;
+  u32 sampleRate;
+  u32 numSamples;
+} WavWriter;
+
+/**
+ * Creates a 16 bit stereo .wav file and writes a placeholder header
+ * @param _wav Writer to initialize
+ * @param _filename File to create
+ * @param _sampleRate Sample rate written into the header
+ */
+ChipError wav_open(WavWriter *_wav, const char *_filename, u32 _sampleRate);
+
+/**
+ * Appends a block of samples with a single write; ERR_WAV_TOO_LONG, without writing, when the file would
+ * outgrow WAV_MAX_SAMPLES
+ */
+ChipError wav_write(WavWriter *_wav, const ChipSample *_buf, int _len);
+
+/**
+ * Patches the RIFF and data chunk sizes and closes the file
+ */
+ChipError wav_close(WavWriter *_wav);
+
+#endif // ifndef WAV_H